@@ -0,0 +1,2 @@
+TEMPLATE = subdirs
+SUBDIRS = coverbench genrebench libgen mapstress resizebench scanbench tagbench walkbench
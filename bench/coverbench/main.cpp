@@ -0,0 +1,148 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtGui>
+
+#include <sys/resource.h>
+
+#include "imageutils.h"
+
+/**
+ * Cover ingestion benchmark: large embedded covers scaled down to the stored size,
+ * by decoding the full bitmap then scaling it, and by ImageUtils::readScaled().
+ * Reports ms per cover and the peak RSS. The peak only grows, so the decode-time
+ * scaling runs first. Use --mode to measure each in its own process.
+ */
+
+namespace {
+
+const QSize storedSize(300, 300);
+
+QByteArray makeCover(int seed, int side) {
+    QImage image(side, side, QImage::Format_RGB32);
+    const QColor from = QColor::fromHsv((seed * 37) % 360, 200, 220);
+    const QColor to = QColor::fromHsv((seed * 91) % 360, 160, 80);
+    for (int y = 0; y < side; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < side; ++x) {
+            const int t = (x + y) * 255 / (side * 2);
+            const int noise = ((x * 7 + y * 13 + seed) % 17) - 8;
+            auto blend = [t, noise](int a, int b) {
+                return qBound(0, (a * (255 - t) + b * t) / 255 + noise, 255);
+            };
+            line[x] = qRgb(blend(from.red(), to.red()), blend(from.green(), to.green()),
+                           blend(from.blue(), to.blue()));
+        }
+    }
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPG", 90);
+    return bytes;
+}
+
+QVector<QByteArray> loadCovers(const QString &directory) {
+    QVector<QByteArray> covers;
+    QDirIterator it(directory, {"*.jpg", "*.jpeg", "*.png"}, QDir::Files,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFile file(it.next());
+        if (file.open(QIODevice::ReadOnly)) covers << file.readAll();
+    }
+    return covers;
+}
+
+// CoverUtils before decode-time scaling
+QImage fullDecode(const QByteArray &data) {
+    QImage image;
+    image.loadFromData(data);
+    return image.scaled(storedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+QImage scaledDecode(const QByteArray &data) {
+    QBuffer buffer;
+    buffer.setData(data);
+    QImageReader reader(&buffer);
+    return ImageUtils::readScaled(reader, storedSize);
+}
+
+qint64 peakRss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss;
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    // no display needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"mode", "full, scaled or both.", "mode", "both"});
+    parser.addOption({"count", "Synthetic covers to generate.", "count", "20"});
+    parser.addOption({"size", "Side of the synthetic covers, in pixels.", "pixels", "3000"});
+    parser.addPositionalArgument("directory", "Real covers to use instead, optional.");
+    parser.process(app);
+
+    QVector<QByteArray> covers;
+    if (!parser.positionalArguments().isEmpty()) {
+        covers = loadCovers(parser.positionalArguments().first());
+    } else {
+        const int count = qMax(1, parser.value("count").toInt());
+        const int side = qMax(1, parser.value("size").toInt());
+        for (int i = 0; i < count; ++i)
+            covers << makeCover(i, side);
+    }
+    if (covers.isEmpty()) {
+        qWarning() << "No covers";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << covers.size() << " covers, peak RSS before decoding "
+        << peakRss() / (1024 * 1024) << " MB" << endl;
+
+    const QString mode = parser.value("mode");
+    auto run = [&](const char *name, QImage (*decode)(const QByteArray &)) {
+        qint64 checksum = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (const QByteArray &cover : qAsConst(covers))
+            checksum += decode(cover).width();
+        const qint64 nsecs = timer.nsecsElapsed();
+        out << QString("%1 %2 ms/cover, peak RSS %3 MB, checksum %4")
+                        .arg(QLatin1String(name), -7)
+                        .arg(double(nsecs) / 1000000 / covers.size(), 7, 'f', 2)
+                        .arg(peakRss() / (1024 * 1024))
+                        .arg(checksum)
+            << endl;
+    };
+    if (mode == "scaled" || mode == "both") run("scaled", scaledDecode);
+    if (mode == "full" || mode == "both") run("full", fullDecode);
+
+    return 0;
+}
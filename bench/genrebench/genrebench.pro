@@ -0,0 +1,21 @@
+CONFIG += c++17 console exceptions_off rtti_off optimize_full
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = genrebench
+
+QT = core
+
+DEFINES *= QT_USE_QSTRINGBUILDER QT_STRICT_ITERATORS QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+INCLUDEPATH += $$ROOT/src
+
+# the shipped genre-replacements.csv, at the same resource path as in the app
+RESOURCES += genrebench.qrc
+
+HEADERS += $$ROOT/src/genretagparser.h \
+    $$ROOT/src/stringmatcher.h
+SOURCES += main.cpp \
+    $$ROOT/src/genretagparser.cpp \
+    $$ROOT/src/stringmatcher.cpp
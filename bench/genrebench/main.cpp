@@ -0,0 +1,147 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtCore>
+
+#include "genretagparser.h"
+
+/**
+ * Checks the single pass genre parser behind Genre::namesFromTag() against the sequential
+ * QString::replace() loop it replaced, on the shipped genre-replacements.csv, then times both.
+ * Tags are built from the bad words and some real genres, in several cases and separators.
+ * Both sides split on the same separators: the old "[,/-;]" range was a bug, see user-032.
+ */
+
+namespace {
+
+typedef QVector<QPair<QString, QString>> Replacements;
+
+// Genre::cleanGenreName() before the parser
+Replacements loadReplacements(const QString &filename) {
+    Replacements map;
+    QFile f(filename);
+    if (f.open(QFile::ReadOnly)) {
+        QTextStream stream(&f);
+        QString line;
+        while (!stream.atEnd()) {
+            stream.readLineInto(&line);
+            QString badWord;
+            QString goodWord;
+            const auto fields = line.splitRef(',');
+            for (const QStringRef &field : fields) {
+                if (badWord.isNull())
+                    badWord = field.toString();
+                else
+                    goodWord = field.toString();
+            }
+            map.append(qMakePair(badWord, goodWord));
+        }
+    }
+    return map;
+}
+
+QStringList referenceNames(const QString &tag, const Replacements &replacements) {
+    static const QRegularExpression separators("([,/;]| & )");
+    QStringList names;
+    const auto parts = tag.splitRef(separators, QString::SkipEmptyParts);
+    for (const QStringRef &part : parts) {
+        const QStringRef trimmed = part.trimmed();
+        if (trimmed.isEmpty()) continue;
+        QString s = trimmed.toString();
+        for (const auto &i : replacements)
+            s.replace(i.first, i.second, Qt::CaseInsensitive);
+        s = s.simplified();
+        if (!s.isEmpty()) names << s;
+    }
+    return names;
+}
+
+QStringList makeTags(const Replacements &replacements) {
+    QStringList words = {"Pop",         "Rock",        "Jazz",      "Hip-Hop",
+                         "Electronic",  "Brother",     "Alt. Rock", "Alt Country",
+                         "Death Metal", "Heavy Metal", "Pop Music", "Misc Rock"};
+    for (const auto &i : replacements) {
+        if (!i.first.isEmpty()) words << i.first;
+    }
+    const QStringList separators = {" ", ", ", "/", "; ", " & ", ""};
+
+    QStringList tags;
+    for (const QString &word : qAsConst(words)) {
+        tags << word << word.toUpper() << word.left(1).toUpper() + word.mid(1);
+        for (const QString &other : qAsConst(words)) {
+            for (const QString &separator : separators)
+                tags << word + separator + other;
+        }
+    }
+    return tags;
+}
+
+template <typename F> qint64 bestOf(int runs, F function) {
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int i = 0; i < runs; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        best = qMin(best, timer.nsecsElapsed());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"runs", "Timed runs, the best one is reported.", "count", "5"});
+    parser.process(app);
+    const int runs = qMax(1, parser.value("runs").toInt());
+
+    const QString filename = ":/res/genre-replacements.csv";
+    const Replacements replacements = loadReplacements(filename);
+    const GenreTagParser tagParser(filename);
+    const QStringList tags = makeTags(replacements);
+
+    QTextStream out(stdout);
+    int mismatches = 0;
+    for (const QString &tag : tags) {
+        const QStringList expected = referenceNames(tag, replacements);
+        const QStringList actual = tagParser.parse(tag);
+        if (actual == expected) continue;
+        if (++mismatches <= 20)
+            out << tag << ": expected " << expected.join('|') << " got " << actual.join('|')
+                << endl;
+    }
+    out << tags.size() << " tags, " << mismatches << " mismatches" << endl;
+
+    const qint64 sequential = bestOf(runs, [&] {
+        for (const QString &tag : tags)
+            referenceNames(tag, replacements);
+    });
+    const qint64 single = bestOf(runs, [&] {
+        for (const QString &tag : tags)
+            tagParser.parse(tag);
+    });
+    out << "sequential replace: " << sequential / 1000 << " us, parser: " << single / 1000
+        << " us" << endl;
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,532 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "formats.h"
+
+namespace {
+
+const int sampleRate = 44100;
+
+void appendBE16(QByteArray &bytes, quint16 value) {
+    bytes.append(char(value >> 8));
+    bytes.append(char(value));
+}
+
+void appendBE32(QByteArray &bytes, quint32 value) {
+    appendBE16(bytes, value >> 16);
+    appendBE16(bytes, value);
+}
+
+void appendBE64(QByteArray &bytes, quint64 value) {
+    appendBE32(bytes, value >> 32);
+    appendBE32(bytes, value);
+}
+
+void appendLE32(QByteArray &bytes, quint32 value) {
+    for (int i = 0; i < 4; ++i)
+        bytes.append(char(value >> (i * 8)));
+}
+
+void appendLE64(QByteArray &bytes, quint64 value) {
+    appendLE32(bytes, value);
+    appendLE32(bytes, value >> 32);
+}
+
+QString number(int value) {
+    return value > 0 ? QString::number(value) : QString();
+}
+
+/*** MP3 ***/
+
+void appendSyncsafe(QByteArray &bytes, quint32 value) {
+    for (int shift = 21; shift >= 0; shift -= 7)
+        bytes.append(char((value >> shift) & 0x7f));
+}
+
+QByteArray id3Frame(const char *id, const QByteArray &data) {
+    QByteArray frame(id, 4);
+    appendSyncsafe(frame, data.size());
+    frame.append(2, '\0');
+    frame.append(data);
+    return frame;
+}
+
+QByteArray id3TextFrame(const char *id, const QString &text) {
+    if (text.isEmpty()) return QByteArray();
+    // UTF-8 encoding
+    return id3Frame(id, '\x03' + text.toUtf8());
+}
+
+QByteArray id3v2(const TrackMeta &meta) {
+    QByteArray frames;
+    frames += id3TextFrame("TIT2", meta.title);
+    frames += id3TextFrame("TPE1", meta.artist);
+    frames += id3TextFrame("TPE2", meta.albumArtist);
+    frames += id3TextFrame("TALB", meta.album);
+    frames += id3TextFrame("TCON", meta.genre);
+    frames += id3TextFrame("TDRC", number(meta.year));
+    if (meta.track > 0)
+        frames += id3TextFrame("TRCK", number(meta.track) + '/' + number(meta.trackCount));
+    if (meta.disk > 0)
+        frames += id3TextFrame("TPOS", number(meta.disk) + '/' + number(meta.diskCount));
+    if (meta.compilation) frames += id3TextFrame("TCMP", QStringLiteral("1"));
+    if (!meta.cover.isEmpty()) {
+        QByteArray data;
+        data += '\x03' + meta.coverMimeType + '\0';
+        // front cover, empty description
+        data += '\x03';
+        data += '\0';
+        data += meta.cover;
+        frames += id3Frame("APIC", data);
+    }
+    // padding, like most taggers leave
+    frames.append(1024, '\0');
+
+    QByteArray tag("ID3\x04\x00\x00", 6);
+    appendSyncsafe(tag, frames.size());
+    return tag + frames;
+}
+
+/*** FLAC ***/
+
+quint8 crc8(const QByteArray &bytes) {
+    quint8 crc = 0;
+    for (char c : bytes) {
+        crc ^= quint8(c);
+        for (int i = 0; i < 8; ++i)
+            crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+    }
+    return crc;
+}
+
+quint16 crc16(const QByteArray &bytes) {
+    quint16 crc = 0;
+    for (char c : bytes) {
+        crc ^= quint16(quint8(c)) << 8;
+        for (int i = 0; i < 8; ++i)
+            crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x8005) : quint16(crc << 1);
+    }
+    return crc;
+}
+
+// FLAC frame numbers use the same variable length coding as UTF-8
+void appendUtf8Number(QByteArray &bytes, quint32 value) {
+    if (value < 0x80) {
+        bytes.append(char(value));
+        return;
+    }
+    int extra = value < 0x800 ? 1 : value < 0x10000 ? 2 : value < 0x200000 ? 3 : 4;
+    const quint8 lead = quint8(0xff00 >> (extra + 1));
+    bytes.append(char(lead | (value >> (6 * extra))));
+    while (extra--)
+        bytes.append(char(0x80 | ((value >> (6 * extra)) & 0x3f)));
+}
+
+QByteArray flacMetadataBlock(int type, const QByteArray &data, bool last) {
+    QByteArray block;
+    block.append(char((last ? 0x80 : 0) | type));
+    block.append(char(data.size() >> 16));
+    appendBE16(block, data.size());
+    return block + data;
+}
+
+QByteArray vorbisComments(const TrackMeta &meta, const QByteArray &vendor) {
+    QVector<QByteArray> comments;
+    auto add = [&comments](const char *name, const QString &value) {
+        if (!value.isEmpty()) comments << QByteArray(name) + '=' + value.toUtf8();
+    };
+    if (!meta.untagged) {
+        add("TITLE", meta.title);
+        add("ARTIST", meta.artist);
+        add("ALBUMARTIST", meta.albumArtist);
+        add("ALBUM", meta.album);
+        add("GENRE", meta.genre);
+        add("DATE", number(meta.year));
+        add("TRACKNUMBER", number(meta.track));
+        add("TRACKTOTAL", number(meta.trackCount));
+        add("DISCNUMBER", number(meta.disk));
+        add("DISCTOTAL", number(meta.diskCount));
+        if (meta.compilation) add("COMPILATION", QStringLiteral("1"));
+        // CoverUtils reads the legacy base64 field
+        if (!meta.cover.isEmpty()) comments << "COVERART=" + meta.cover.toBase64();
+    }
+
+    QByteArray bytes;
+    appendLE32(bytes, vendor.size());
+    bytes += vendor;
+    appendLE32(bytes, comments.size());
+    for (const QByteArray &comment : qAsConst(comments)) {
+        appendLE32(bytes, comment.size());
+        bytes += comment;
+    }
+    return bytes;
+}
+
+QByteArray flacFrame(quint32 frameNumber, int blockSize) {
+    QByteArray frame("\xff\xf8", 2);
+    // 4096 samples blocks, otherwise the size follows the header. 44.1 kHz
+    frame.append(char(blockSize == 4096 ? 0xc9 : 0x79));
+    // two independent channels, 16 bits per sample
+    frame.append(char(0x18));
+    appendUtf8Number(frame, frameNumber);
+    if (blockSize != 4096) appendBE16(frame, blockSize - 1);
+    frame.append(char(crc8(frame)));
+    // two CONSTANT subframes of silence
+    for (int channel = 0; channel < 2; ++channel) {
+        frame.append('\0');
+        appendBE16(frame, 0);
+    }
+    appendBE16(frame, crc16(frame));
+    return frame;
+}
+
+/*** Ogg Vorbis ***/
+
+quint32 oggCrc(const QByteArray &bytes) {
+    static const QVector<quint32> table = [] {
+        QVector<quint32> t(256);
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 r = i << 24;
+            for (int j = 0; j < 8; ++j)
+                r = (r & 0x80000000) ? (r << 1) ^ 0x04c11db7 : r << 1;
+            t[i] = r;
+        }
+        return t;
+    }();
+    quint32 crc = 0;
+    for (char c : bytes)
+        crc = (crc << 8) ^ table[((crc >> 24) ^ quint8(c)) & 0xff];
+    return crc;
+}
+
+class OggStream {
+public:
+    explicit OggStream(quint32 serial) : serial(serial) {}
+
+    // Writes a packet on pages of its own, continuing on more pages when needed
+    void writePacket(const QByteArray &packet, qint64 granule, quint8 flags = 0) {
+        int offset = 0;
+        bool continued = false;
+        bool complete = false;
+        while (!complete) {
+            QByteArray lacing;
+            int pageSize = 0;
+            while (lacing.size() < 255) {
+                const int segment = qMin(255, packet.size() - offset - pageSize);
+                lacing.append(char(segment));
+                pageSize += segment;
+                if (segment < 255) {
+                    complete = true;
+                    break;
+                }
+            }
+            quint8 pageFlags = flags & 0x02;
+            if (continued) pageFlags |= 0x01;
+            if (complete) pageFlags |= flags & 0x04;
+            writePage(pageFlags, complete ? granule : -1, lacing, packet.mid(offset, pageSize));
+            // only the first page begins the stream
+            flags &= ~0x02;
+            offset += pageSize;
+            continued = true;
+        }
+    }
+
+    const QByteArray &data() const { return bytes; }
+
+private:
+    void writePage(quint8 flags, qint64 granule, const QByteArray &lacing,
+                   const QByteArray &payload) {
+        QByteArray page("OggS", 4);
+        page.append('\0');
+        page.append(char(flags));
+        appendLE64(page, granule);
+        appendLE32(page, serial);
+        appendLE32(page, sequence++);
+        const int crcOffset = page.size();
+        appendLE32(page, 0);
+        page.append(char(lacing.size()));
+        page += lacing;
+        page += payload;
+        const quint32 crc = oggCrc(page);
+        for (int i = 0; i < 4; ++i)
+            page[crcOffset + i] = char(crc >> (i * 8));
+        bytes += page;
+    }
+
+    const quint32 serial;
+    quint32 sequence = 0;
+    QByteArray bytes;
+};
+
+/*** MP4 ***/
+
+QByteArray atom(const char *type, const QByteArray &payload) {
+    QByteArray bytes;
+    appendBE32(bytes, 8 + payload.size());
+    bytes.append(type, 4);
+    return bytes + payload;
+}
+
+QByteArray fullAtom(const char *type, quint32 flags, const QByteArray &payload) {
+    QByteArray bytes;
+    // version 0
+    appendBE32(bytes, flags & 0xffffff);
+    return atom(type, bytes + payload);
+}
+
+QByteArray ilstItem(const char *name, quint32 type, const QByteArray &value) {
+    QByteArray data;
+    appendBE32(data, type);
+    // locale
+    appendBE32(data, 0);
+    return atom(name, atom("data", data + value));
+}
+
+QByteArray ilstText(const char *name, const QString &text) {
+    if (text.isEmpty()) return QByteArray();
+    return ilstItem(name, 1, text.toUtf8());
+}
+
+QByteArray ilstPair(const char *name, int number, int total, bool trailer) {
+    if (number <= 0) return QByteArray();
+    QByteArray value;
+    appendBE16(value, 0);
+    appendBE16(value, number);
+    appendBE16(value, total);
+    if (trailer) appendBE16(value, 0);
+    return ilstItem(name, 0, value);
+}
+
+QByteArray identityMatrix() {
+    QByteArray matrix;
+    const quint32 values[] = {0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000};
+    for (quint32 value : values)
+        appendBE32(matrix, value);
+    return matrix;
+}
+
+} // namespace
+
+QByteArray Formats::mp3(const TrackMeta &meta) {
+    QByteArray bytes;
+    if (!meta.untagged) bytes = id3v2(meta);
+
+    // MPEG-1 Layer III, 128 kbps, 44.1 kHz, mono: 1152 samples in 417 bytes
+    static const QByteArray header("\xff\xfb\x90\xc4", 4);
+    const int frameSize = 417;
+    const quint32 frameCount = quint32(qint64(meta.duration) * sampleRate / 1152);
+
+    // The first frame carries a Xing header with the frame count, so the duration
+    // does not depend on the (tiny) file size
+    QByteArray xing = header;
+    // mono side info
+    xing.append(17, '\0');
+    xing.append("Xing", 4);
+    // frames and bytes fields
+    appendBE32(xing, 0x03);
+    appendBE32(xing, frameCount);
+    appendBE32(xing, frameCount * frameSize);
+    xing.append(frameSize - xing.size(), '\0');
+    bytes += xing;
+
+    QByteArray frame = header;
+    frame.append(frameSize - frame.size(), '\0');
+    for (int i = 0; i < 8; ++i)
+        bytes += frame;
+    return bytes;
+}
+
+QByteArray Formats::flac(const TrackMeta &meta) {
+    const quint64 totalSamples = quint64(meta.duration) * sampleRate;
+
+    QByteArray streamInfo;
+    // min and max block size
+    appendBE16(streamInfo, 4096);
+    appendBE16(streamInfo, 4096);
+    // min and max frame size, unknown
+    streamInfo.append(6, '\0');
+    // sample rate, channels - 1, bits per sample - 1, total samples
+    appendBE64(streamInfo, quint64(sampleRate) << 44 | quint64(1) << 41 | quint64(15) << 36 |
+                                   totalSamples);
+    // MD5, unknown
+    streamInfo.append(16, '\0');
+
+    QByteArray bytes("fLaC", 4);
+    bytes += flacMetadataBlock(0, streamInfo, false);
+    bytes += flacMetadataBlock(4, vorbisComments(meta, "reference libFLAC 1.3.2 20170101"),
+                               false);
+    bytes += flacMetadataBlock(1, QByteArray(1024, '\0'), true);
+
+    quint32 frameNumber = 0;
+    for (quint64 sample = 0; sample < totalSamples; sample += 4096)
+        bytes += flacFrame(frameNumber++, int(qMin<quint64>(4096, totalSamples - sample)));
+    return bytes;
+}
+
+QByteArray Formats::ogg(const TrackMeta &meta) {
+    // the serial number only needs to be unique within the file
+    OggStream stream(quint32(qHash(meta.title) ^ quint32(meta.track)));
+
+    QByteArray identification("\x01vorbis", 7);
+    appendLE32(identification, 0);
+    identification.append(char(2));
+    appendLE32(identification, sampleRate);
+    // maximum, nominal and minimum bitrate
+    appendLE32(identification, 0);
+    appendLE32(identification, 128000);
+    appendLE32(identification, 0);
+    // 256 and 2048 samples blocks
+    identification.append(char(0xb8));
+    identification.append(char(0x01));
+    stream.writePacket(identification, 0, 0x02);
+
+    QByteArray comment("\x03vorbis", 7);
+    comment += vorbisComments(meta, "Xiph.Org libVorbis I 20150105");
+    comment.append(char(0x01));
+    stream.writePacket(comment, 0);
+
+    // Not decodable, TagLib does not look into the codebooks
+    QByteArray setup("\x05vorbis", 7);
+    setup.append(32, '\0');
+    setup.append(char(0x01));
+    stream.writePacket(setup, 0);
+
+    // The last granule position gives the duration
+    stream.writePacket(QByteArray(16, '\0'), qint64(meta.duration) * sampleRate, 0x04);
+    return stream.data();
+}
+
+QByteArray Formats::m4a(const TrackMeta &meta) {
+    const quint32 sampleCount = quint32(meta.duration) * sampleRate;
+
+    QByteArray ftyp("M4A ", 4);
+    appendBE32(ftyp, 0);
+    ftyp.append("M4A mp42isom", 12);
+
+    QByteArray mvhd;
+    // creation and modification time
+    appendBE32(mvhd, 0);
+    appendBE32(mvhd, 0);
+    appendBE32(mvhd, 1000);
+    appendBE32(mvhd, quint32(meta.duration) * 1000);
+    // rate and volume
+    appendBE32(mvhd, 0x10000);
+    appendBE16(mvhd, 0x100);
+    mvhd.append(10, '\0');
+    mvhd += identityMatrix();
+    mvhd.append(24, '\0');
+    // next track id
+    appendBE32(mvhd, 2);
+
+    QByteArray tkhd;
+    appendBE32(tkhd, 0);
+    appendBE32(tkhd, 0);
+    // track id
+    appendBE32(tkhd, 1);
+    appendBE32(tkhd, 0);
+    appendBE32(tkhd, quint32(meta.duration) * 1000);
+    tkhd.append(8, '\0');
+    // layer and alternate group
+    appendBE32(tkhd, 0);
+    appendBE16(tkhd, 0x100);
+    appendBE16(tkhd, 0);
+    tkhd += identityMatrix();
+    // width and height
+    appendBE32(tkhd, 0);
+    appendBE32(tkhd, 0);
+
+    QByteArray mdhd;
+    appendBE32(mdhd, 0);
+    appendBE32(mdhd, 0);
+    appendBE32(mdhd, sampleRate);
+    appendBE32(mdhd, sampleCount);
+    // "und" language
+    appendBE16(mdhd, 0x55c4);
+    appendBE16(mdhd, 0);
+
+    QByteArray soundHandler;
+    appendBE32(soundHandler, 0);
+    soundHandler.append("soun", 4);
+    soundHandler.append(12, '\0');
+    soundHandler.append('\0');
+
+    QByteArray mp4a;
+    // reserved and data reference index
+    mp4a.append(6, '\0');
+    appendBE16(mp4a, 1);
+    // version, revision and vendor
+    mp4a.append(8, '\0');
+    // channels and sample size
+    appendBE16(mp4a, 2);
+    appendBE16(mp4a, 16);
+    // compression id and packet size
+    appendBE32(mp4a, 0);
+    // 16.16 fixed point sample rate
+    appendBE32(mp4a, quint32(sampleRate) << 16);
+
+    QByteArray stsd;
+    appendBE32(stsd, 1);
+    stsd += atom("mp4a", mp4a);
+
+    QByteArray empty;
+    appendBE32(empty, 0);
+    QByteArray stsz;
+    appendBE32(stsz, 0);
+    appendBE32(stsz, 0);
+
+    QByteArray dref;
+    appendBE32(dref, 1);
+    dref += fullAtom("url ", 1, QByteArray());
+
+    const QByteArray stbl = atom("stbl", fullAtom("stsd", 0, stsd) + fullAtom("stts", 0, empty) +
+                                                 fullAtom("stsc", 0, empty) +
+                                                 fullAtom("stsz", 0, stsz) +
+                                                 fullAtom("stco", 0, empty));
+    const QByteArray minf = atom("minf", fullAtom("smhd", 0, QByteArray(4, '\0')) +
+                                                 atom("dinf", fullAtom("dref", 0, dref)) + stbl);
+    const QByteArray mdia = atom("mdia", fullAtom("mdhd", 0, mdhd) +
+                                                 fullAtom("hdlr", 0, soundHandler) + minf);
+    const QByteArray trak = atom("trak", fullAtom("tkhd", 7, tkhd) + mdia);
+
+    QByteArray moov = fullAtom("mvhd", 0, mvhd) + trak;
+    if (!meta.untagged) {
+        QByteArray ilst;
+        ilst += ilstText("\xa9nam", meta.title);
+        ilst += ilstText("\xa9" "ART", meta.artist);
+        ilst += ilstText("aART", meta.albumArtist);
+        ilst += ilstText("\xa9" "alb", meta.album);
+        ilst += ilstText("\xa9gen", meta.genre);
+        ilst += ilstText("\xa9" "day", number(meta.year));
+        ilst += ilstPair("trkn", meta.track, meta.trackCount, true);
+        ilst += ilstPair("disk", meta.disk, meta.diskCount, false);
+        if (meta.compilation) ilst += ilstItem("cpil", 21, QByteArray(1, '\x01'));
+        if (!meta.cover.isEmpty())
+            ilst += ilstItem("covr", meta.coverMimeType == "image/png" ? 14 : 13, meta.cover);
+
+        QByteArray metadataHandler;
+        appendBE32(metadataHandler, 0);
+        metadataHandler.append("mdirappl", 8);
+        metadataHandler.append(9, '\0');
+        moov += atom("udta", fullAtom("meta", 0, fullAtom("hdlr", 0, metadataHandler) +
+                                                          atom("ilst", ilst)));
+    }
+
+    return atom("ftyp", ftyp) + atom("moov", moov) + atom("mdat", QByteArray(64, '\0'));
+}
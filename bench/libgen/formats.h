@@ -0,0 +1,61 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef FORMATS_H
+#define FORMATS_H
+
+#include <QtCore>
+
+struct TrackMeta {
+    QString title;
+    QString artist;
+    QString albumArtist;
+    QString album;
+    QString genre;
+    int track = 0;
+    int trackCount = 0;
+    int disk = 0;
+    int diskCount = 0;
+    int year = 0;
+    bool compilation = false;
+    // seconds
+    int duration = 0;
+    // no tags at all, only the audio stream
+    bool untagged = false;
+    QByteArray cover;
+    QByteArray coverMimeType;
+};
+
+/**
+ * Minimal writers for the audio formats the scanner cares about.
+ * The files are small but well formed: TagLib reads their tags and properties
+ * (duration comes from the Xing header, STREAMINFO, last Ogg granule or mdhd)
+ * without any real audio payload.
+ */
+namespace Formats {
+
+QByteArray mp3(const TrackMeta &meta);
+QByteArray flac(const TrackMeta &meta);
+QByteArray ogg(const TrackMeta &meta);
+QByteArray m4a(const TrackMeta &meta);
+
+} // namespace Formats
+
+#endif // FORMATS_H
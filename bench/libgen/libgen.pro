@@ -0,0 +1,13 @@
+CONFIG += c++17 console exceptions_off rtti_off optimize_full
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = libgen
+
+QT = core gui
+
+DEFINES *= QT_USE_QSTRINGBUILDER QT_STRICT_ITERATORS QT_DEPRECATED_WARNINGS
+
+HEADERS += formats.h
+SOURCES += main.cpp \
+    formats.cpp
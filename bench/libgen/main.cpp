@@ -0,0 +1,309 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtCore>
+#include <QtGui>
+
+#include "formats.h"
+
+/**
+ * Generates a synthetic music library that looks like the ones users have:
+ * mixed formats, multi-disc albums, compilations, sloppy tags, embedded and
+ * folder covers of all sizes, and the usual non-audio clutter.
+ * The same seed always produces the same library.
+ */
+
+namespace {
+
+const char *syllables[] = {"ka", "lo", "mi", "ran", "tu", "vel", "so", "ne", "da", "rok",
+                           "li", "ma", "zor", "ben", "ta", "gri", "fu", "sha", "ol", "quin"};
+
+const char *words[] = {"Night",  "Summer", "Blue",   "Fire",    "Dream",  "Heart",  "Road",
+                       "Silver", "Echo",   "Rain",   "Golden",  "River",  "Ghost",  "Light",
+                       "Stone",  "Wild",   "Midnight", "Ocean", "Paper",  "Electric", "Garden",
+                       "Winter", "Shadow", "Velvet", "Broken",  "Sweet",  "Neon",   "Lonely"};
+
+// including the messy variants found in real collections
+const char *genres[] = {"Rock",       "rock",         "Pop",         "Jazz",
+                        "Electronic", "Electronica",  "Hip-Hop",     "Hip Hop/Rap",
+                        "Classical",  "Alt. Rock",    "Alternative", "Rock; Pop",
+                        "Metal",      "Heavy Metal",  "Folk",        "Indie Rock / Pop",
+                        "Soul",       "R&B",          "Blues",       "Punk Rock",
+                        "Ambient",    "Synthpop",     "Country",     "Reggae"};
+
+struct Format {
+    const char *suffix;
+    QByteArray (*write)(const TrackMeta &);
+    // cumulative percentage
+    int share;
+};
+
+const Format formats[] = {{"mp3", Formats::mp3, 55},
+                          {"flac", Formats::flac, 75},
+                          {"ogg", Formats::ogg, 90},
+                          {"m4a", Formats::m4a, 100}};
+
+const char *nonTrackNames[] = {"info.nfo", "album.sfk", "rip.accurip", "Thumbs.db", "README",
+                               "playlist.m3u", "desktop.ini"};
+
+class Generator {
+public:
+    Generator(const QString &root, quint32 seed, int fileCount)
+        : root(root), random(seed), fileCount(fileCount) {
+        const int artistCount = qMax(5, fileCount / 40);
+        for (int i = 0; i < artistCount; ++i)
+            artists << makeArtistName();
+    }
+
+    void run() {
+        int albumIndex = 0;
+        while (trackCount < fileCount)
+            generateAlbum(albumIndex++);
+        QTextStream(stdout) << QString("Generated %1 tracks in %2 albums, %3 other files, %4 MB")
+                                       .arg(trackCount)
+                                       .arg(albumIndex)
+                                       .arg(nonTrackCount)
+                                       .arg(byteCount / (1024 * 1024))
+                            << endl;
+    }
+
+private:
+    bool chance(int percent) { return int(random.bounded(100)) < percent; }
+    int between(int min, int max) { return min + int(random.bounded(max - min + 1)); }
+    template <typename T, int N> T pick(T (&array)[N]) { return array[random.bounded(N)]; }
+
+    QString makeWord() {
+        QString word;
+        const int count = between(1, 3);
+        for (int i = 0; i < count; ++i)
+            word += QLatin1String(pick(syllables));
+        word[0] = word.at(0).toUpper();
+        return word;
+    }
+
+    QString makeArtistName() {
+        QString name = makeWord();
+        if (chance(40)) name += ' ' + makeWord();
+        if (chance(20)) name.prepend("The ");
+        return name;
+    }
+
+    QString makeTitle() {
+        QString title = QLatin1String(pick(words));
+        const int count = between(0, 3);
+        for (int i = 0; i < count; ++i)
+            title += ' ' + (chance(50) ? QString(QLatin1String(pick(words))) : makeWord());
+        return title;
+    }
+
+    // The kind of inconsistencies the scanner has to normalize
+    QString messUp(const QString &name) {
+        switch (random.bounded(6)) {
+        case 0:
+            return "  " + name + ' ';
+        case 1:
+            return name.toUpper();
+        case 2:
+            if (name.startsWith("The ")) return name.mid(4) + ", The";
+            return "The " + name;
+        case 3:
+            return QString(name).replace(' ', '_');
+        default:
+            return name.toLower();
+        }
+    }
+
+    static QString safeFileName(QString name) {
+        return name.replace('/', '-').trimmed();
+    }
+
+    QByteArray makeCover(int seed, const QSize &size, const char *format) {
+        QImage image(size, QImage::Format_RGB32);
+        const QColor from = QColor::fromHsv((seed * 37) % 360, 200, 220);
+        const QColor to = QColor::fromHsv((seed * 91) % 360, 160, 80);
+        for (int y = 0; y < size.height(); ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < size.width(); ++x) {
+                const int t = (x + y) * 255 / (size.width() + size.height());
+                // some texture so that the JPEG encoder has something to chew on
+                const int noise = ((x * 7 + y * 13 + seed) % 17) - 8;
+                auto blend = [t, noise](int a, int b) {
+                    return qBound(0, (a * (255 - t) + b * t) / 255 + noise, 255);
+                };
+                line[x] = qRgb(blend(from.red(), to.red()), blend(from.green(), to.green()),
+                               blend(from.blue(), to.blue()));
+            }
+        }
+        QByteArray bytes;
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, format, 85);
+        return bytes;
+    }
+
+    QSize makeCoverSize() {
+        const int roll = random.bounded(100);
+        // too small for CoverUtils
+        if (roll < 10) return QSize(120, 120);
+        // not square enough
+        if (roll < 18) return QSize(600, 300);
+        if (roll < 33) return QSize(1200, 1200);
+        return QSize(600, 600);
+    }
+
+    bool writeFile(const QString &path, const QByteArray &data) {
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Cannot write" << path << file.errorString();
+            return false;
+        }
+        file.write(data);
+        byteCount += data.size();
+        return true;
+    }
+
+    void writeNonTrack(const QString &dir, const QString &name) {
+        QByteArray data;
+        const int size = between(64, 4096);
+        data.reserve(size);
+        for (int i = 0; i < size; ++i)
+            data.append(char(random.bounded(256)));
+        if (writeFile(dir + '/' + name, data)) nonTrackCount++;
+    }
+
+    void generateAlbum(int albumIndex) {
+        const bool compilation = chance(10);
+        const QString artist = artists.at(random.bounded(artists.size()));
+        const QString albumArtist = compilation ? QStringLiteral("Various Artists") : artist;
+        const QString album = makeTitle();
+        const int year = between(1960, 2020);
+        const QString genre = QLatin1String(pick(genres));
+        const bool messy = chance(10);
+
+        const int formatRoll = random.bounded(100);
+        const Format *format = formats;
+        while (formatRoll >= format->share)
+            ++format;
+
+        QString dir = root + '/';
+        if (compilation)
+            dir += "Compilations/" + safeFileName(album);
+        else
+            dir += safeFileName(artist) + '/' + QString::number(year) + " - " +
+                   safeFileName(album);
+
+        const int diskCount = chance(15) ? 2 : 1;
+
+        // embedded, in the album folder, or no cover at all
+        const int coverRoll = random.bounded(100);
+        QByteArray cover;
+        QByteArray coverMimeType;
+        if (coverRoll < 50) {
+            cover = makeCover(albumIndex, makeCoverSize(), "JPG");
+            coverMimeType = "image/jpeg";
+        } else if (coverRoll < 80) {
+            static const char *names[] = {"cover.jpg", "folder.jpg", "front.png", "Cover.JPG"};
+            const QString name = QLatin1String(pick(names));
+            QDir().mkpath(dir);
+            writeFile(dir + '/' + name,
+                      makeCover(albumIndex, makeCoverSize(),
+                                name.endsWith(".png") ? "PNG" : "JPG"));
+            nonTrackCount++;
+        }
+
+        for (int disk = 1; disk <= diskCount; ++disk) {
+            const QString diskDir = diskCount > 1 ? dir + "/CD" + QString::number(disk) : dir;
+            QDir().mkpath(diskDir);
+            const int albumTrackCount = between(8, 16);
+
+            for (int track = 1; track <= albumTrackCount && trackCount < fileCount; ++track) {
+                TrackMeta meta;
+                meta.title = makeTitle();
+                meta.artist = compilation ? artists.at(random.bounded(artists.size())) : artist;
+                if (messy && chance(50)) meta.artist = messUp(meta.artist);
+                meta.albumArtist = compilation || chance(30) ? albumArtist : QString();
+                meta.album = album;
+                meta.genre = genre;
+                meta.track = track;
+                meta.trackCount = albumTrackCount;
+                if (diskCount > 1) {
+                    meta.disk = disk;
+                    meta.diskCount = diskCount;
+                }
+                meta.year = year;
+                meta.compilation = compilation;
+                meta.duration = between(90, 420);
+                meta.untagged = chance(3);
+                meta.cover = cover;
+                meta.coverMimeType = coverMimeType;
+
+                QString fileName = QString("%1 - %2").arg(track, 2, 10, QChar('0')).arg(meta.title);
+                if (messy) fileName.replace(' ', '_');
+                const QString path = diskDir + '/' + safeFileName(fileName) + '.' +
+                                     QLatin1String(format->suffix);
+                if (writeFile(path, format->write(meta))) trackCount++;
+
+                if (chance(5)) writeNonTrack(diskDir, safeFileName(fileName) + ".lrc");
+            }
+
+            if (chance(30)) writeNonTrack(diskDir, QLatin1String(pick(nonTrackNames)));
+        }
+    }
+
+    const QString root;
+    QRandomGenerator random;
+    const int fileCount;
+    QStringList artists;
+    int trackCount = 0;
+    int nonTrackCount = 0;
+    qint64 byteCount = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("libgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates a synthetic music library for benchmarking.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directory", "Where the library is created.");
+    QCommandLineOption filesOption("files", "Number of audio files, 10000 by default.", "count",
+                                   "10000");
+    QCommandLineOption seedOption("seed", "Random seed, 1 by default.", "seed", "1");
+    parser.addOption(filesOption);
+    parser.addOption(seedOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1) parser.showHelp(1);
+
+    const QString root = QDir(args.first()).absolutePath();
+    if (QDir(root).exists() && !QDir(root).isEmpty()) {
+        qWarning() << root << "is not empty";
+        return 1;
+    }
+
+    Generator generator(root, parser.value(seedOption).toUInt(),
+                        parser.value(filesOption).toInt());
+    generator.run();
+    return 0;
+}
@@ -0,0 +1,137 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtCore>
+
+#include "model/identitymap.h"
+
+/**
+ * Concurrency stress test for IdentityMap: several threads insert, find, take and list
+ * values while another one keeps clearing the map, as a full scan does while the GUI reads.
+ * Every key has one value object for the whole run, so any value a lookup returns can be
+ * checked. Build it with a sanitizer to catch races and use after free.
+ */
+
+namespace {
+
+class Value : public QObject {
+public:
+    explicit Value(int key) : key(key) {}
+    const int key;
+};
+
+class Worker : public QThread {
+public:
+    Worker(IdentityMap<int, Value> &map, const QVector<Value *> &values, int seed,
+           const QAtomicInt &done, QAtomicInt &errors)
+        : map(map), values(values), seed(seed), done(done), errors(errors) {}
+
+    int operations = 0;
+
+protected:
+    void run() override {
+        QRandomGenerator random(seed);
+        const int keyCount = values.size();
+        while (!done.loadAcquire()) {
+            const int key = random.bounded(keyCount);
+            const int op = random.bounded(100);
+            if (op < 60) {
+                Value *value = nullptr;
+                if (map.find(key, &value) && value && value->key != key) errors.ref();
+            } else if (op < 85) {
+                // null for odd keys, like the negative caching of forId()
+                Value *value = key % 2 ? nullptr : values.at(key);
+                Value *stored = map.insert(key, value);
+                if (stored && stored->key != key) errors.ref();
+            } else if (op < 98) {
+                Value *value = map.take(key);
+                if (value && value->key != key) errors.ref();
+            } else {
+                for (Value *value : map.values()) {
+                    if (value->key % 2) errors.ref();
+                }
+            }
+            ++operations;
+        }
+    }
+
+private:
+    IdentityMap<int, Value> &map;
+    const QVector<Value *> &values;
+    const int seed;
+    const QAtomicInt &done;
+    QAtomicInt &errors;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"threads", "Reader and writer threads.", "count", "8"});
+    parser.addOption({"keys", "Distinct keys.", "count", "5000"});
+    parser.addOption({"seconds", "How long to run.", "seconds", "10"});
+    parser.process(app);
+    const int threadCount = qMax(1, parser.value("threads").toInt());
+    const int keyCount = qMax(2, parser.value("keys").toInt());
+    const int seconds = qMax(1, parser.value("seconds").toInt());
+
+    QVector<Value *> values;
+    values.reserve(keyCount);
+    for (int key = 0; key < keyCount; ++key)
+        values << new Value(key);
+
+    QAtomicInt done;
+    QAtomicInt errors;
+    int clears = 0;
+    {
+        IdentityMap<int, Value> map;
+        QVector<Worker *> workers;
+        for (int i = 0; i < threadCount; ++i) {
+            Worker *worker = new Worker(map, values, i + 1, done, errors);
+            workers << worker;
+            worker->start();
+        }
+
+        // the scanner thread's clearCache()
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < seconds * 1000) {
+            QThread::msleep(5);
+            map.clear();
+            ++clears;
+        }
+        done.storeRelease(1);
+
+        qint64 operations = 0;
+        for (Worker *worker : qAsConst(workers)) {
+            worker->wait();
+            operations += worker->operations;
+        }
+        qDeleteAll(workers);
+        QTextStream(stdout) << operations << " operations, " << clears << " clears, "
+                            << errors.loadAcquire() << " errors" << endl;
+    }
+    qDeleteAll(values);
+
+    return errors.loadAcquire() ? 1 : 0;
+}
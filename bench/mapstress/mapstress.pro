@@ -0,0 +1,16 @@
+CONFIG += c++17 console exceptions_off rtti_off
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = mapstress
+
+QT = core
+
+DEFINES *= QT_USE_QSTRINGBUILDER QT_STRICT_ITERATORS QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+INCLUDEPATH += $$ROOT/src
+
+# e.g. qmake CONFIG+=sanitizer CONFIG+=sanitize_thread, or sanitize_address
+HEADERS += $$ROOT/src/model/identitymap.h
+SOURCES += main.cpp
@@ -0,0 +1,133 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtGui>
+
+#include "imageutils.h"
+
+/**
+ * Thumbnail scaling benchmark: ImageUtils::scaled() against QImage::scaled() with
+ * Qt::SmoothTransformation, for each source and target size. Also reports how far apart
+ * the two results are, as the mean and maximum difference of a channel.
+ */
+
+namespace {
+
+QImage makeImage(int side, bool alpha) {
+    QImage image(side, side, alpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    for (int y = 0; y < side; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < side; ++x) {
+            const int t = (x + y) * 255 / (side * 2);
+            const int noise = (x * 7 + y * 13) % 17;
+            const int a = alpha ? 255 - (x * 255 / side) : 255;
+            line[x] = qPremultiply(qRgba(qBound(0, t + noise, 255), (x * 255 / side) ^ noise,
+                                         255 - t, a));
+        }
+    }
+    return image;
+}
+
+template <typename F> double bestOf(int runs, int iterations, F function) {
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < runs; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; ++i)
+            function();
+        best = qMin(best, double(timer.nsecsElapsed()) / 1000000 / iterations);
+    }
+    return best;
+}
+
+void difference(const QImage &a, const QImage &b, double *mean, int *max) {
+    qint64 sum = 0;
+    *max = 0;
+    const QImage first = a.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QImage second = b.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < first.height(); ++y) {
+        const uchar *p = first.constScanLine(y);
+        const uchar *q = second.constScanLine(y);
+        for (int x = 0; x < first.width() * 4; ++x) {
+            const int diff = qAbs(int(p[x]) - int(q[x]));
+            sum += diff;
+            *max = qMax(*max, diff);
+        }
+    }
+    *mean = double(sum) / (first.width() * first.height() * 4);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"sources", "Source sides, comma separated.", "pixels", "300,1000,3000"});
+    parser.addOption({"targets", "Target sides, comma separated.", "pixels", "32,150,300"});
+    parser.addOption({"runs", "Timed runs, the best one is reported.", "runs", "5"});
+    parser.addOption("alpha", "Scale images with an alpha channel.");
+    parser.process(app);
+
+    const int runs = qMax(1, parser.value("runs").toInt());
+    const bool alpha = parser.isSet("alpha");
+
+    QTextStream out(stdout);
+    out << QString("%1 %2 %3 %4 %5 %6")
+                    .arg("source", 6)
+                    .arg("target", 6)
+                    .arg("qt ms", 9)
+                    .arg("ours ms", 9)
+                    .arg("mean diff", 10)
+                    .arg("max diff", 9)
+        << endl;
+
+    for (const QString &source : parser.value("sources").split(',')) {
+        const QImage image = makeImage(qMax(1, source.toInt()), alpha);
+        for (const QString &target : parser.value("targets").split(',')) {
+            const QSize size(qMax(1, target.toInt()), qMax(1, target.toInt()));
+            // about the same amount of work per timed run
+            const int iterations = qBound(1, 20000000 / (image.width() * image.height()), 200);
+
+            QImage qt, ours;
+            const double qtMs = bestOf(runs, iterations, [&] {
+                qt = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            });
+            const double oursMs = bestOf(runs, iterations, [&] {
+                ours = ImageUtils::scaled(image, size);
+            });
+
+            double mean;
+            int max;
+            difference(qt, ours, &mean, &max);
+            out << QString("%1 %2 %3 %4 %5 %6")
+                            .arg(image.width(), 6)
+                            .arg(size.width(), 6)
+                            .arg(qtMs, 9, 'f', 3)
+                            .arg(oursMs, 9, 'f', 3)
+                            .arg(mean, 10, 'f', 2)
+                            .arg(max, 9)
+                << endl;
+        }
+    }
+
+    return 0;
+}
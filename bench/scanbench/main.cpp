@@ -0,0 +1,186 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtWidgets>
+
+#include <sys/resource.h>
+
+#include "collectionscannerthread.h"
+#include "constants.h"
+#include "database.h"
+
+/**
+ * Headless collection scan benchmark.
+ * Runs a full scan of a directory (usually made by libgen), touches a fraction of
+ * the files and runs an incremental scan, reporting the numbers we want to track
+ * across changes to the scanner.
+ */
+
+namespace {
+
+struct ScanResult {
+    QVariantMap stats;
+    qint64 elapsed = 0;
+};
+
+ScanResult scan(const QString &directory) {
+    CollectionScannerThread &thread = CollectionScannerThread::instance();
+    ScanResult result;
+    QElapsedTimer timer;
+    QEventLoop loop;
+
+    auto statsConnection = QObject::connect(&thread, &CollectionScannerThread::finished,
+                                            [&](const QVariantMap &stats) {
+                                                result.elapsed = timer.elapsed();
+                                                result.stats = stats;
+                                            });
+    // The scanner thread cleans up after emitting the stats, wait for it to be done
+    auto threadConnection =
+            QObject::connect(&thread, &QThread::finished, &loop, &QEventLoop::quit);
+
+    timer.start();
+    thread.setDirectory(directory);
+    thread.start();
+    loop.exec();
+    thread.wait();
+
+    QObject::disconnect(statsConnection);
+    QObject::disconnect(threadConnection);
+    return result;
+}
+
+int touchFiles(const QString &directory, int percent) {
+    static const QStringList suffixes = {"mp3", "flac", "ogg", "m4a"};
+    // in the future, so the files are newer than the last update recorded by the scan
+    const QDateTime time = QDateTime::currentDateTime().addSecs(5);
+    int count = 0;
+    int index = 0;
+    QDirIterator it(directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        if (!suffixes.contains(it.fileInfo().suffix())) continue;
+        if (index++ % 100 >= percent) continue;
+        QFile file(it.filePath());
+        if (file.open(QIODevice::ReadWrite) &&
+            file.setFileTime(time, QFileDevice::FileModificationTime))
+            count++;
+    }
+    return count;
+}
+
+qint64 peakRss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss;
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+}
+
+QJsonObject report(const QString &name, const ScanResult &result) {
+    QJsonObject json;
+    for (auto i = result.stats.constBegin(); i != result.stats.constEnd(); ++i) {
+        // skip path lists and the like
+        bool ok;
+        const double value = i.value().toDouble(&ok);
+        if (ok) json.insert(i.key(), value);
+    }
+    const int trackCount = result.stats.value("trackCount").toInt();
+    const double seconds = result.elapsed / 1000.;
+    json.insert("telemetry",
+                QJsonObject::fromVariantMap(result.stats.value("telemetry").toMap()));
+    json.insert("elapsedMs", result.elapsed);
+    if (seconds > 0) json.insert("filesPerSecond", trackCount / seconds);
+    json.insert("dbSize", QFileInfo(Database::getDbLocation()).size());
+    json.insert("peakRss", peakRss());
+
+    const QString summary("%1 scan: %2 tracks in %3 s, %4 files/s, db %5 KB, peak RSS %6 MB");
+    QTextStream(stdout) << summary.arg(name)
+                                   .arg(trackCount)
+                                   .arg(seconds, 0, 'f', 2)
+                                   .arg(json.value("filesPerSecond").toDouble(), 0, 'f', 1)
+                                   .arg(json.value("dbSize").toDouble() / 1024, 0, 'f', 0)
+                                   .arg(json.value("peakRss").toDouble() / (1024 * 1024), 0, 'f', 1)
+                        << endl;
+    return json;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    // Album and Artist need a GUI application for their images, but no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    // Keep our database and settings away from the ones of the real app
+    QCoreApplication::setApplicationName("scanbench");
+    QCoreApplication::setOrganizationName(Constants::ORG_NAME);
+    QCoreApplication::setOrganizationDomain(Constants::ORG_DOMAIN);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks full and incremental collection scans.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directory", "The music collection to scan.");
+    QCommandLineOption touchOption("touch",
+                                   "Percentage of files touched before the incremental scan, "
+                                   "10 by default.",
+                                   "percent", "10");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to file.", "file");
+    QCommandLineOption onlineOption("online", "Fetch artist and album info from the internet.");
+    parser.addOption(touchOption);
+    parser.addOption(jsonOption);
+    parser.addOption(onlineOption);
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    if (args.size() != 1) parser.showHelp(1);
+    const QString directory = QDir(args.first()).absolutePath();
+    if (!QFileInfo(directory).isDir()) {
+        qWarning() << directory << "is not a directory";
+        return 1;
+    }
+
+    // Always start from scratch, like a first run
+    QDir(Database::getDataLocation()).removeRecursively();
+    QSettings().clear();
+
+    CollectionScannerThread::instance().setOffline(!parser.isSet(onlineOption));
+
+    QJsonObject json;
+    json.insert("full", report("Full", scan(directory)));
+
+    const int touched = touchFiles(directory, parser.value(touchOption).toInt());
+    QTextStream(stdout) << "Touched " << touched << " files" << endl;
+    QJsonObject incremental = report("Incremental", scan(QString()));
+    incremental.insert("touchedFiles", touched);
+    json.insert("incremental", incremental);
+
+    if (parser.isSet(jsonOption)) {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Cannot write" << file.fileName() << file.errorString();
+            return 1;
+        }
+        file.write(QJsonDocument(json).toJson());
+    }
+
+    return 0;
+}
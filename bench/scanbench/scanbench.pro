@@ -0,0 +1,72 @@
+CONFIG += c++17 console exceptions_off rtti_off optimize_full object_parallel_to_source
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = scanbench
+
+APP_NAME = Musique
+APP_UNIX_NAME = musique
+DEFINES += APP_NAME="$$APP_NAME" APP_UNIX_NAME="$$APP_UNIX_NAME" APP_VERSION=bench
+
+# The scanner logs every file, that would be measured too
+DEFINES *= QT_NO_DEBUG_OUTPUT QT_USE_QSTRINGBUILDER QT_STRICT_ITERATORS QT_DEPRECATED_WARNINGS
+
+QT += network sql widgets
+
+ROOT = $$PWD/../..
+include($$ROOT/lib/http/http.pri)
+include($$ROOT/src/tags/tags.pri)
+
+INCLUDEPATH += $$ROOT/src
+LIBS += -ltag
+INCLUDEPATH += /usr/include/taglib
+
+HEADERS += $$ROOT/src/collectionscanner.h \
+    $$ROOT/src/collectionscannerthread.h \
+    $$ROOT/src/constants.h \
+    $$ROOT/src/coverutils.h \
+    $$ROOT/src/artworkstore.h \
+    $$ROOT/src/database.h \
+    $$ROOT/src/datautils.h \
+    $$ROOT/src/directorywalker.h \
+    $$ROOT/src/durationupdater.h \
+    $$ROOT/src/genretree.h \
+    $$ROOT/src/httputils.h \
+    $$ROOT/src/imageutils.h \
+    $$ROOT/src/imagedownloader.h \
+    $$ROOT/src/scantelemetry.h \
+    $$ROOT/src/genretagparser.h \
+    $$ROOT/src/stringmatcher.h \
+    $$ROOT/src/tagchecker.h \
+    $$ROOT/src/tileartwork.h \
+    $$ROOT/src/model/album.h \
+    $$ROOT/src/model/artist.h \
+    $$ROOT/src/model/genre.h \
+    $$ROOT/src/model/identitymap.h \
+    $$ROOT/src/model/item.h \
+    $$ROOT/src/model/track.h
+
+SOURCES += main.cpp \
+    stubs.cpp \
+    $$ROOT/src/collectionscanner.cpp \
+    $$ROOT/src/collectionscannerthread.cpp \
+    $$ROOT/src/constants.cpp \
+    $$ROOT/src/coverutils.cpp \
+    $$ROOT/src/artworkstore.cpp \
+    $$ROOT/src/database.cpp \
+    $$ROOT/src/datautils.cpp \
+    $$ROOT/src/directorywalker.cpp \
+    $$ROOT/src/durationupdater.cpp \
+    $$ROOT/src/genretree.cpp \
+    $$ROOT/src/httputils.cpp \
+    $$ROOT/src/imageutils.cpp \
+    $$ROOT/src/imagedownloader.cpp \
+    $$ROOT/src/scantelemetry.cpp \
+    $$ROOT/src/genretagparser.cpp \
+    $$ROOT/src/stringmatcher.cpp \
+    $$ROOT/src/tagchecker.cpp \
+    $$ROOT/src/tileartwork.cpp \
+    $$ROOT/src/model/album.cpp \
+    $$ROOT/src/model/artist.cpp \
+    $$ROOT/src/model/genre.cpp \
+    $$ROOT/src/model/track.cpp
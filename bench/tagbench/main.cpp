@@ -0,0 +1,141 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtCore>
+
+#include "datautils.h"
+
+/**
+ * Micro-benchmark of DataUtils::normalizeTag() against the original implementation,
+ * on tags repeated the way they are in a real collection scan.
+ */
+
+namespace {
+
+// DataUtils::normalizeTag() before the ASCII fast path and the memo cache
+QString referenceNormalizeTag(const QString &tag) {
+    QString s = tag.trimmed().toLower();
+    if (s.length() > 4 && s.startsWith(QLatin1String("the "))) s = s.remove(0, 4);
+    static const QLatin1String et("and");
+    s.replace(QLatin1String("&"), et);
+    s.replace(QLatin1String("'n'"), et);
+    const int l = s.length();
+    QString n;
+    n.reserve(l);
+    for (int i = 0; i < l; ++i) {
+        const QChar c = s.at(i);
+        if (c.isLetterOrNumber()) n.append(c);
+    }
+    return n;
+}
+
+QStringList makeNames(QRandomGenerator &random, int count) {
+    static const char *words[] = {"Night", "Summer", "Blue",  "Fire",  "Dream",    "Heart",
+                                  "Road",  "Silver", "Echo",  "Rain",  "Golden",   "River",
+                                  "Ghost", "Light",  "Stone", "Wild",  "Midnight", "Ocean"};
+    static const QString accented[] = {QString::fromUtf8("Björk"), QString::fromUtf8("Sigur Rós"),
+                                       QString::fromUtf8("Mötley"), QString::fromUtf8("Céline")};
+    QStringList names;
+    for (int i = 0; i < count; ++i) {
+        QString name;
+        const int wordCount = 1 + random.bounded(4);
+        for (int w = 0; w < wordCount; ++w) {
+            if (w > 0) name += random.bounded(10) == 0 ? QLatin1String(" & ") : QLatin1String(" ");
+            name += QLatin1String(words[random.bounded(int(sizeof(words) / sizeof(*words)))]);
+        }
+        const int roll = random.bounded(100);
+        if (roll < 15)
+            name.prepend("The ");
+        else if (roll < 20)
+            name += "'n' Roll";
+        else if (roll < 30)
+            name += ' ' + accented[random.bounded(4)];
+        if (random.bounded(20) == 0) name = "  " + name.toUpper() + ' ';
+        names << name;
+    }
+    return names;
+}
+
+template <typename F> qint64 bestOf(int runs, F function) {
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int i = 0; i < runs; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        best = qMin(best, timer.nsecsElapsed());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QRandomGenerator random(1);
+    const QStringList names = makeNames(random, 2000);
+
+    for (const QString &name : names) {
+        const QString expected = referenceNormalizeTag(name);
+        const QString actual = DataUtils::normalizeTag(name);
+        if (expected != actual) {
+            qWarning() << "Mismatch for" << name << expected << actual;
+            return 1;
+        }
+    }
+
+    // Every file asks for its artist and album a few times, popular names come up most
+    QStringList lookups;
+    const int lookupCount = 200000;
+    lookups.reserve(lookupCount);
+    for (int i = 0; i < lookupCount; ++i) {
+        const double r = random.generateDouble();
+        lookups << names.at(int(r * r * r * names.size()));
+    }
+
+    int checksum = 0;
+    auto run = [&](QString (*normalize)(const QString &)) {
+        return bestOf(5, [&] {
+            for (const QString &tag : qAsConst(lookups))
+                checksum += normalize(tag).length();
+        });
+    };
+
+    const qint64 reference = run(referenceNormalizeTag);
+    const qint64 fastPath = run(DataUtils::normalizeTag);
+    DataUtils::setNormalizeTagCacheEnabled(true);
+    const qint64 memoized = run(DataUtils::normalizeTag);
+    DataUtils::setNormalizeTagCacheEnabled(false);
+
+    QTextStream out(stdout);
+    auto report = [&](const char *name, qint64 nsecs) {
+        out << QString("%1 %2 ns/tag, %3x")
+                        .arg(QLatin1String(name), -10)
+                        .arg(double(nsecs) / lookupCount, 7, 'f', 1)
+                        .arg(double(reference) / nsecs, 0, 'f', 2)
+            << endl;
+    };
+    report("reference", reference);
+    report("ascii", fastPath);
+    report("memoized", memoized);
+    out << "checksum " << checksum << endl;
+
+    return 0;
+}
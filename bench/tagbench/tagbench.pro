@@ -0,0 +1,16 @@
+CONFIG += c++17 console exceptions_off rtti_off optimize_full
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = tagbench
+
+QT = core
+
+DEFINES *= QT_USE_QSTRINGBUILDER QT_STRICT_ITERATORS QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+INCLUDEPATH += $$ROOT/src
+
+HEADERS += $$ROOT/src/datautils.h
+SOURCES += main.cpp \
+    $$ROOT/src/datautils.cpp
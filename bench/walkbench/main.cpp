@@ -0,0 +1,127 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include <QtCore>
+
+#include "directorywalker.h"
+
+/**
+ * Benchmark of DirectoryWalker against the QDir walk the collection scanner used before,
+ * both listing every file with its size and modification time.
+ * Run it on a cold cache (echo 3 > /proc/sys/vm/drop_caches) to measure the disk too.
+ */
+
+namespace {
+
+struct Result {
+    int files = 0;
+    qint64 bytes = 0;
+};
+
+// CollectionScanner::scanDirectory() before the walker
+Result referenceWalk(const QString &root) {
+    Result result;
+    QStack<QDir> stack;
+    stack.push(QDir(root));
+    while (!stack.empty()) {
+        const QDir dir = stack.pop();
+        const QFileInfoList flist =
+                dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files | QDir::Readable);
+        for (const QFileInfo &fileInfo : flist) {
+            if (fileInfo.isFile()) {
+                ++result.files;
+                result.bytes += fileInfo.size();
+                fileInfo.lastModified();
+            } else if (fileInfo.isDir()) {
+                stack.push(QDir(fileInfo.absoluteFilePath()));
+            }
+        }
+    }
+    return result;
+}
+
+Result walkerWalk(const QString &root, int threadCount) {
+    DirectoryWalker walker;
+    walker.setThreadCount(threadCount);
+    const DirectoryWalker::Entries entries = walker.walk(root);
+    Result result;
+    for (const DirectoryWalker::Entry &entry : entries) {
+        ++result.files;
+        result.bytes += entry.size;
+    }
+    return result;
+}
+
+template <typename F> qint64 bestOf(int runs, F function) {
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int i = 0; i < runs; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        best = qMin(best, timer.nsecsElapsed());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"runs", "Runs per walk, the best one is reported.", "count", "5"});
+    parser.addPositionalArgument("directory", "The directory tree to walk.");
+    parser.process(app);
+    if (parser.positionalArguments().size() != 1) parser.showHelp(1);
+
+    const QString root = QDir(parser.positionalArguments().first()).absolutePath();
+    const int runs = qMax(1, parser.value("runs").toInt());
+    const int threadCount = qBound(2, QThread::idealThreadCount(), 4);
+
+    // the first walk also warms the cache for all of them
+    const Result expected = referenceWalk(root);
+    const Result actual = walkerWalk(root, threadCount);
+    if (expected.files != actual.files || expected.bytes != actual.bytes) {
+        qWarning() << "Mismatch: QDir found" << expected.files << "files," << expected.bytes
+                   << "bytes, the walker" << actual.files << "files," << actual.bytes << "bytes";
+        return 1;
+    }
+
+    const qint64 reference = bestOf(runs, [&] { referenceWalk(root); });
+    const qint64 oneThread = bestOf(runs, [&] { walkerWalk(root, 1); });
+    const qint64 threads = bestOf(runs, [&] { walkerWalk(root, threadCount); });
+
+    QTextStream out(stdout);
+    out << expected.files << " files" << endl;
+    auto report = [&](const QString &name, qint64 nsecs) {
+        out << QString("%1 %2 ms, %3 files/s, %4x")
+                        .arg(name, -12)
+                        .arg(double(nsecs) / 1000000, 8, 'f', 1)
+                        .arg(qint64(expected.files * 1e9 / nsecs))
+                        .arg(double(reference) / nsecs, 0, 'f', 2)
+            << endl;
+    };
+    report("qdir", reference);
+    report("walker x1", oneThread);
+    report(QString("walker x%1").arg(threadCount), threads);
+
+    return 0;
+}
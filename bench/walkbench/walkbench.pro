@@ -0,0 +1,17 @@
+CONFIG += c++17 console exceptions_off rtti_off optimize_full
+CONFIG -= app_bundle
+
+TEMPLATE = app
+TARGET = walkbench
+
+QT = core
+
+# The walker logs skipped directories
+DEFINES *= QT_NO_DEBUG_OUTPUT QT_USE_QSTRINGBUILDER QT_STRICT_ITERATORS QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+INCLUDEPATH += $$ROOT/src
+
+HEADERS += $$ROOT/src/directorywalker.h
+SOURCES += main.cpp \
+    $$ROOT/src/directorywalker.cpp
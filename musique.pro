@@ -49,11 +49,17 @@ HEADERS += src/mainwindow.h \
     src/finderwidget.h \
     src/collectionscannerview.h \
     src/collectionscanner.h \
+    src/directorywalker.h \
+    src/durationupdater.h \
+    src/scantelemetry.h \
+    src/genretagparser.h \
+    src/stringmatcher.h \
     src/database.h \
     src/model/track.h \
     src/model/item.h \
     src/model/album.h \
     src/model/artist.h \
+    src/model/identitymap.h \
     src/datautils.h \
     src/artistsqlmodel.h \
     src/mediaview.h \
@@ -93,10 +99,14 @@ HEADERS += src/mainwindow.h \
     src/diskcache.h \
     src/segmentedcontrol.h \
     src/coverutils.h \
+    src/artworkstore.h \
+    src/artworknormalizer.h \
+    src/integritychecker.h \
     src/lastfmlogindialog.h \
     src/lastfm.h \
     src/imagedownloader.h \
     src/iconutils.h \
+    src/imageutils.h \
     src/appwidget.h \
     src/httputils.h \
     src/tagchecker.h \
@@ -104,6 +114,8 @@ HEADERS += src/mainwindow.h \
     src/model/genre.h \
     src/genresmodel.h \
     src/genres.h \
+    src/genretree.h \
+    src/tileartwork.h \
     src/model/decade.h \
     src/seekslider.h \
     src/finderlistview.h \
@@ -120,6 +132,11 @@ SOURCES += src/main.cpp \
     src/finderwidget.cpp \
     src/collectionscannerview.cpp \
     src/collectionscanner.cpp \
+    src/directorywalker.cpp \
+    src/durationupdater.cpp \
+    src/scantelemetry.cpp \
+    src/genretagparser.cpp \
+    src/stringmatcher.cpp \
     src/database.cpp \
     src/model/track.cpp \
     src/model/album.cpp \
@@ -163,10 +180,14 @@ SOURCES += src/main.cpp \
     src/diskcache.cpp \
     src/segmentedcontrol.cpp \
     src/coverutils.cpp \
+    src/artworkstore.cpp \
+    src/artworknormalizer.cpp \
+    src/integritychecker.cpp \
     src/lastfmlogindialog.cpp \
     src/lastfm.cpp \
     src/imagedownloader.cpp \
     src/iconutils.cpp \
+    src/imageutils.cpp \
     src/appwidget.cpp \
     src/httputils.cpp \
     src/tagchecker.cpp \
@@ -174,6 +195,8 @@ SOURCES += src/main.cpp \
     src/model/genre.cpp \
     src/genresmodel.cpp \
     src/genres.cpp \
+    src/genretree.cpp \
+    src/tileartwork.cpp \
     src/model/decade.cpp \
     src/seekslider.cpp \
     src/finderlistview.cpp \
@@ -0,0 +1,85 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "artworknormalizer.h"
+
+#include <QtSql>
+
+#include "artworkstore.h"
+#include "database.h"
+
+namespace {
+
+// Images per transaction
+const int batchSize = 16;
+
+} // namespace
+
+ArtworkNormalizer::ArtworkNormalizer(QObject *parent) : QThread(parent) {
+    setObjectName("artwork");
+}
+
+ArtworkNormalizer::~ArtworkNormalizer() {
+    stop();
+}
+
+ArtworkNormalizer &ArtworkNormalizer::instance() {
+    static ArtworkNormalizer i;
+    return i;
+}
+
+void ArtworkNormalizer::stop() {
+    if (!isRunning()) return;
+    requestInterruption();
+    wait();
+}
+
+void ArtworkNormalizer::run() {
+    while (!isInterruptionRequested() && normalizeBatch()) {
+    }
+    Database::instance().closeConnection();
+}
+
+bool ArtworkNormalizer::normalizeBatch() {
+    const QStringList digests = ArtworkStore::pendingRenditions(batchSize);
+    if (digests.isEmpty()) return false;
+
+    // Images are decoded and encoded outside of the transaction, they're the slow part
+    QVector<QPair<QString, int>> done;
+    done.reserve(digests.size());
+    for (const QString &digest : digests) {
+        if (isInterruptionRequested()) break;
+        const int rungs = ArtworkStore::makeRenditions(digest);
+        if (rungs < 0) qDebug() << "Cannot read artwork" << digest;
+        // unreadable images are not retried, consumers get the original
+        done.append(qMakePair(digest, qMax(0, rungs)));
+    }
+
+    QSqlDatabase db = Database::instance().getConnection();
+    db.transaction();
+    for (const auto &entry : qAsConst(done))
+        ArtworkStore::setRenditions(entry.first, entry.second);
+    if (!db.commit()) {
+        qWarning() << "Commit failed!";
+        return false;
+    }
+    qDebug() << "Normalized" << done.size() << "artwork entries";
+    return true;
+}
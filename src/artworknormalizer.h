@@ -0,0 +1,48 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef ARTWORKNORMALIZER_H
+#define ARTWORKNORMALIZER_H
+
+#include <QtCore>
+
+/**
+ * Low priority pass after scans and downloads: writes the renditions of the
+ * ArtworkStore entries that have none yet. The queue is the artwork table itself.
+ */
+class ArtworkNormalizer : public QThread {
+    Q_OBJECT
+
+public:
+    static ArtworkNormalizer &instance();
+    ~ArtworkNormalizer();
+
+    // Interrupts the pass and waits for it, the rest stays queued
+    void stop();
+
+protected:
+    void run();
+
+private:
+    ArtworkNormalizer(QObject *parent = nullptr);
+    bool normalizeBatch();
+};
+
+#endif // ARTWORKNORMALIZER_H
@@ -0,0 +1,256 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "artworkstore.h"
+
+#include <QtGui>
+#include <QtSql>
+
+#include "database.h"
+#include "imageutils.h"
+
+namespace {
+
+// Shorter side of the renditions, from the finder thumbs to the artist photo of ArtistInfo
+const int ladder[] = {64, 180, 360, 720};
+const int ladderSize = sizeof(ladder) / sizeof(ladder[0]);
+
+} // namespace
+
+QString ArtworkStore::digest(const QByteArray &bytes) {
+    return QString::fromLatin1(
+            QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex());
+}
+
+QString ArtworkStore::path(const QString &digest) {
+    // fanned out, a single directory with thousands of entries is slow on some filesystems
+    return Database::getFilesLocation() + QLatin1String("_artwork/") + digest.leftRef(2) +
+           QLatin1Char('/') + digest;
+}
+
+QString ArtworkStore::renditionPath(const QString &digest, int size) {
+    return path(digest) + QLatin1Char('@') + QString::number(size);
+}
+
+bool ArtworkStore::setReference(Owner owner, const QString &hash, const QString &digest) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert or replace into artworkRefs (type, hash, digest) values (?,?,?)");
+    query.bindValue(0, owner);
+    query.bindValue(1, hash);
+    query.bindValue(2, digest);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ArtworkStore::setArtwork(Owner owner, const QString &hash, const QByteArray &bytes) {
+    if (bytes.isEmpty()) return false;
+    const QString digest = ArtworkStore::digest(bytes);
+
+    // Both rows or neither: collectGarbage() would take a lone artwork row for an orphan.
+    // Fails when the caller, e.g. a full scan, already has a transaction open.
+    QSqlDatabase db = Database::instance().getConnection();
+    const bool ownTransaction = db.transaction();
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert or ignore into artwork (digest, size) values (?,?)");
+    query.bindValue(0, digest);
+    query.bindValue(1, bytes.size());
+    bool success = query.exec();
+    if (!success) qWarning() << query.lastQuery() << query.lastError().text();
+    if (!success || !setReference(owner, hash, digest)) {
+        if (ownTransaction) db.rollback();
+        return false;
+    }
+    if (ownTransaction && !db.commit()) {
+        qWarning() << "Commit failed!";
+        db.rollback();
+        return false;
+    }
+
+    // After the rows: collectGarbage() may have just deleted an identical entry
+    const QString location = path(digest);
+    if (QFile::exists(location)) return true;
+    QDir().mkpath(QFileInfo(location).absolutePath());
+    QSaveFile file(location);
+    if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() ||
+        !file.commit()) {
+        qWarning() << "Error writing artwork" << location << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString ArtworkStore::location(Owner owner, const QString &hash, int pixelSize) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "select r.digest, a.rungs from artworkRefs r left join artwork a "
+            "on a.digest=r.digest where r.type=? and r.hash=?");
+    query.bindValue(0, owner);
+    query.bindValue(1, hash);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    if (!query.next()) return QString();
+    const QString digest = query.value(0).toString();
+    const int rungs = query.value(1).toInt();
+    query.finish();
+
+    if (pixelSize > 0) {
+        for (int i = 0; i < ladderSize; ++i) {
+            if ((rungs & (1 << i)) && ladder[i] >= pixelSize)
+                return renditionPath(digest, ladder[i]);
+        }
+    }
+    return path(digest);
+}
+
+bool ArtworkStore::hasArtwork(Owner owner, const QString &hash) {
+    return !location(owner, hash).isEmpty();
+}
+
+void ArtworkStore::addSource(const QString &sourceDigest, Owner owner, const QString &hash) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert or replace into artworkSources (source, digest) "
+            "select ?, digest from artworkRefs where type=? and hash=?");
+    query.bindValue(0, sourceDigest);
+    query.bindValue(1, owner);
+    query.bindValue(2, hash);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+}
+
+bool ArtworkStore::setArtworkFromSource(const QString &sourceDigest, Owner owner,
+                                        const QString &hash) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "select digest from artworkSources where source=?");
+    query.bindValue(0, sourceDigest);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    if (!query.next()) return false;
+    const QString digest = query.value(0).toString();
+    query.finish();
+    if (!QFile::exists(path(digest))) return false;
+    return setReference(owner, hash, digest);
+}
+
+void ArtworkStore::collectGarbage() {
+    QSqlDatabase db = Database::instance().getConnection();
+    db.transaction();
+
+    QSqlQuery query(db);
+    if (!query.exec("delete from artworkRefs where "
+                    "(type=" % QString::number(AlbumOwner) %
+                    " and hash not in (select hash from albums)) or "
+                    "(type=" % QString::number(ArtistOwner) %
+                    " and hash not in (select hash from artists))"))
+        qWarning() << query.lastQuery() << query.lastError().text();
+
+    if (!query.exec("select digest from artwork "
+                    "where digest not in (select digest from artworkRefs)"))
+        qWarning() << query.lastQuery() << query.lastError().text();
+    QStringList orphans;
+    while (query.next())
+        orphans << query.value(0).toString();
+
+    if (!orphans.isEmpty()) {
+        QSqlQuery deleteArtwork(db);
+        deleteArtwork.prepare("delete from artwork where digest=?");
+        QSqlQuery deleteSources(db);
+        deleteSources.prepare("delete from artworkSources where digest=?");
+        for (const QString &digest : qAsConst(orphans)) {
+            deleteArtwork.bindValue(0, digest);
+            if (!deleteArtwork.exec()) qWarning() << deleteArtwork.lastError().text();
+            deleteSources.bindValue(0, digest);
+            if (!deleteSources.exec()) qWarning() << deleteSources.lastError().text();
+            // while the transaction keeps setArtwork() from adding a reference
+            QFile::remove(path(digest));
+            for (int size : ladder)
+                QFile::remove(renditionPath(digest, size));
+        }
+    }
+
+    if (!db.commit()) qWarning() << "Commit failed!";
+    qDebug() << "Removed" << orphans.size() << "unreferenced artwork entries";
+}
+
+QStringList ArtworkStore::pendingRenditions(int limit) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "select digest from artwork where rungs is null limit ?");
+    query.bindValue(0, limit);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    QStringList digests;
+    while (query.next())
+        digests << query.value(0).toString();
+    return digests;
+}
+
+int ArtworkStore::makeRenditions(const QString &digest) {
+    QImageReader reader(path(digest));
+    QSize size = reader.size();
+    QImage image;
+    if (!size.isValid()) {
+        // the format cannot tell its size without decoding
+        image = reader.read();
+        if (image.isNull()) return -1;
+        size = image.size();
+    }
+
+    // never upscaled: the original serves anything bigger than its last rung
+    const int shorterSide = qMin(size.width(), size.height());
+    int largest = -1;
+    while (largest + 1 < ladderSize && ladder[largest + 1] < shorterSide)
+        ++largest;
+    if (largest < 0) return 0;
+
+    // decoded once at the largest rung, each smaller one is scaled from the previous
+    const QSize largestSize =
+            size.scaled(ladder[largest], ladder[largest], Qt::KeepAspectRatioByExpanding);
+    if (image.isNull()) {
+        reader.setScaledSize(largestSize);
+        image = reader.read();
+        if (image.isNull()) return -1;
+    }
+
+    int rungs = 0;
+    for (int i = largest; i >= 0; --i) {
+        const QSize rungSize = size.scaled(ladder[i], ladder[i], Qt::KeepAspectRatioByExpanding);
+        if (image.size() != rungSize)
+            image = ImageUtils::scaled(image, rungSize, Qt::IgnoreAspectRatio);
+        // JPEG decodes fastest, PNG keeps the alpha channel
+        const bool alpha = image.hasAlphaChannel();
+        QSaveFile file(renditionPath(digest, ladder[i]));
+        if (!file.open(QIODevice::WriteOnly) ||
+            !image.save(&file, alpha ? "PNG" : "JPG", alpha ? -1 : 85) || !file.commit()) {
+            qWarning() << "Error writing artwork" << file.fileName() << file.errorString();
+            continue;
+        }
+        rungs |= 1 << i;
+    }
+    return rungs;
+}
+
+bool ArtworkStore::setRenditions(const QString &digest, int rungs) {
+    QSqlQuery query =
+            Database::instance().cachedQuery("update artwork set rungs=? where digest=?");
+    query.bindValue(0, rungs);
+    query.bindValue(1, digest);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    return true;
+}
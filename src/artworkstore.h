@@ -0,0 +1,83 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef ARTWORKSTORE_H
+#define ARTWORKSTORE_H
+
+#include <QtCore>
+
+/**
+ * Album covers and artist photos, stored once per distinct image under
+ * Database::getFilesLocation()/_artwork, named by the SHA-1 of their bytes.
+ * Albums and artists reference an entry by their hash. The references of an entry are
+ * counted by collectGarbage(), which deletes entries nobody points to anymore.
+ * The tables outlive Database::clear(), so a full scan finds the artwork it already has.
+ *
+ * Each entry also gets renditions whose shorter side is one of a fixed ladder of sizes,
+ * made in the background by ArtworkNormalizer, so painting never scales a large image.
+ */
+class ArtworkStore {
+public:
+    enum Owner { AlbumOwner = 1, ArtistOwner };
+
+    static QString digest(const QByteArray &bytes);
+
+    /**
+     * Stores the encoded image, unless an identical one is already there,
+     * and makes it the artwork of the owner. Returns false if it could not be written.
+     */
+    static bool setArtwork(Owner owner, const QString &hash, const QByteArray &bytes);
+    /**
+     * The file of the owner's artwork, empty if it has none.
+     * With a pixelSize, the smallest rendition whose shorter side is at least that big,
+     * the original when there is no such rendition (yet).
+     */
+    static QString location(Owner owner, const QString &hash, int pixelSize = 0);
+    static bool hasArtwork(Owner owner, const QString &hash);
+
+    /**
+     * Pictures embedded in many files are decoded and scaled once:
+     * addSource() remembers what the original bytes turned into, then
+     * setArtworkFromSource() reuses it for the next owner.
+     */
+    static void addSource(const QString &sourceDigest, Owner owner, const QString &hash);
+    static bool setArtworkFromSource(const QString &sourceDigest, Owner owner,
+                                     const QString &hash);
+
+    // Drops the references of albums and artists that are gone, then unreferenced entries
+    static void collectGarbage();
+
+    // Digests of the entries that have no renditions yet
+    static QStringList pendingRenditions(int limit);
+    /**
+     * Writes the renditions smaller than the original, decoding it once.
+     * Returns the written rungs as a bit mask for setRenditions(), -1 if unreadable.
+     */
+    static int makeRenditions(const QString &digest);
+    static bool setRenditions(const QString &digest, int rungs);
+
+private:
+    ArtworkStore() {}
+    static QString path(const QString &digest);
+    static QString renditionPath(const QString &digest, int size);
+    static bool setReference(Owner owner, const QString &hash, const QString &digest);
+};
+
+#endif // ARTWORKSTORE_H
@@ -19,19 +19,55 @@ along with Musique.  If not, see <http://www.gnu.org/licenses/>.
 $END_LICENSE */
 
 #include "collectionscanner.h"
+#include "artworkstore.h"
 #include "coverutils.h"
 #include "database.h"
 #include "datautils.h"
+#include "durationupdater.h"
+#include "genretree.h"
 #include "imagedownloader.h"
 #include "model/track.h"
+#ifndef Q_OS_WIN
+#include "readaheadstream.h"
+#endif
 #include "tagchecker.h"
 #include "tagutils.h"
+#include "tileartwork.h"
 
 #include "model/genre.h"
 
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+enum FileState { FileGone, SameFile, OtherFile };
+
+// What is at the stored path of a track now, compared with a file the walk found
+FileState fileStateAt(const QString &path, const DirectoryWalker::Entry &entry) {
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (stat(QFile::encodeName(path).constData(), &st) != 0)
+        return errno == ENOENT || errno == ENOTDIR ? FileGone : OtherFile;
+    if (quint64(st.st_dev) == entry.device && quint64(st.st_ino) == entry.inode) return SameFile;
+    return OtherFile;
+#else
+    Q_UNUSED(entry);
+    return QFile::exists(path) ? OtherFile : FileGone;
+#endif
+}
+
+} // namespace
+
 CollectionScanner::CollectionScanner(QObject *parent)
-    : QObject(parent), working(false), stopped(false), incremental(false), lastUpdate(0),
-      maxQueueSize(0) {
+    : QObject(parent), working(false), stopped(false), incremental(false), offline(false),
+      walking(false), waitingForFiles(false), walkStart(0), maxQueueSize(0),
+      statementCacheHitsAtStart(0), statementCacheMissesAtStart(0), tagBlockReadsAtStart(0),
+      tagFileReadsAtStart(0), lastTelemetryUpdate(0) {
+    // Album::setArtist() is queued to the GUI thread for cached albums
+    qRegisterMetaType<Artist *>();
 #ifdef APP_MAC
     QString iTunesAlbumArtwork = QStandardPaths::writableLocation(QStandardPaths::MusicLocation) +
                                  "/iTunes/Album Artwork";
@@ -76,18 +112,37 @@ CollectionScanner::CollectionScanner(QObject *parent)
                             << "mpg"
                             << "wmv"
                             << "swf";
+
+    walker = new DirectoryWalker(this);
+    walker->setSkippedDirectories(directoryBlacklist);
+    walker->setSkippedSuffixes(fileExtensionsBlacklist);
+    // local covers come from the same listing
+    walker->setImagePattern(CoverUtils::coverFilePattern());
+    // hard links and symlinked files are imported once
+    walker->setSkipDuplicateFiles(true);
+    // queued, the walker threads emit them
+    connect(walker, &DirectoryWalker::found, this, &CollectionScanner::filesFound);
+    connect(walker, &DirectoryWalker::finished, this, &CollectionScanner::walkFinished);
 }
 
 void CollectionScanner::reset() {
     stopped = false;
+    walking = false;
+    waitingForFiles = false;
     fileQueue.clear();
     maxQueueSize = 0;
+    movedTrackCount = 0;
+    duplicateFileCount = 0;
     loadedArtists.clear();
     filesWaitingForArtists.clear();
     loadedAlbums.clear();
     filesWaitingForAlbums.clear();
+    coverDirectories.clear();
+    coverCandidates.clear();
+    pendingNonTracks.clear();
     processedTrackPaths.clear();
     tracksNeedingFix.clear();
+    infoRequestTimes.clear();
 }
 
 void CollectionScanner::run() {
@@ -101,6 +156,16 @@ void CollectionScanner::run() {
     working = true;
     stopped = false;
     reset();
+    statementCacheHitsAtStart = Database::instance().statementCacheHits();
+    statementCacheMissesAtStart = Database::instance().statementCacheMisses();
+#ifndef Q_OS_WIN
+    tagBlockReadsAtStart = ReadAheadStream::blockReads();
+    tagFileReadsAtStart = ReadAheadStream::fileReads();
+#endif
+    telemetry.start(incremental);
+    lastTelemetryUpdate = 0;
+    // the same artist and album tags come up over and over
+    DataUtils::setNormalizeTagCacheEnabled(true);
 
     if (incremental) {
         // check whether dir exists, is readable and isn't empty
@@ -140,11 +205,9 @@ void CollectionScanner::run() {
             return;
         }
 
-        // get the timestamp of the last db update
-        // we'll use it to determine if files have changed since the last time
-        lastUpdate = Database::instance().lastUpdate();
-        trackPaths = getTrackPaths();
-        nontrackPaths = getNonTrackPaths();
+        // what the files looked like last time, the walk compares each one of them
+        trackStamps = getTrackStamps();
+        nontrackStamps = getNonTrackStamps();
 
     } else {
         // delete any existing data
@@ -157,22 +220,19 @@ void CollectionScanner::run() {
         Genre::clearCache();
     }
 
-    // now scan the files
-    scanDirectory(rootDirectory);
-
-    maxQueueSize = fileQueue.size();
-    qDebug() << "Going to scan" << maxQueueSize << "files";
-
-    if (stopped) return;
-
     if (!incremental) {
-        Database::instance().closeConnections();
+        Database::instance().closeConnection();
         // Start transaction
         // http://web.utk.edu/~jplyon/sqlite/SQLite_optimization_FAQ.html#transactions
         Database::instance().getConnection().transaction();
     }
 
-    popFromQueue();
+    // now scan the files
+    // they stream in from the walker threads, the first batch starts the pipeline
+    walking = true;
+    waitingForFiles = true;
+    walkStart = telemetry.now();
+    walker->start(rootDirectory.absolutePath());
 
     // qDebug() << "CollectionScanner::run() exited";
 }
@@ -181,26 +241,53 @@ void CollectionScanner::popFromQueue() {
     if (stopped) return;
 
     if (fileQueue.isEmpty()) {
+        if (walking) {
+            // more files are on the way
+            waitingForFiles = true;
+            return;
+        }
         complete();
         return;
     }
 
-    QFileInfo fileInfo = fileQueue.first();
+    const DirectoryWalker::Entry entry = fileQueue.first();
+    const QFileInfo fileInfo(entry.path);
     // qDebug() << "Processing " << fileInfo.absoluteFilePath();
 
     // parse metadata with TagLib
+    telemetry.sampleQueue(ScanTelemetry::FileQueue, fileQueue.size());
+    telemetry.sampleQueue(ScanTelemetry::ArtistQueue,
+                          filesWaitingForArtists.size() + filesWaitingForAlbumArtists.size());
+    telemetry.sampleQueue(ScanTelemetry::AlbumQueue, filesWaitingForAlbums.size());
+
     QString filename = fileInfo.absoluteFilePath();
-    Tags *tags = TagUtils::load(filename);
+    telemetry.addFile(entry.size);
+    // Albums are mostly one per directory: read the cover in the same pass as the tags,
+    // but only once per directory as it can be big and files wait in queues for a while
+    const QString directory = fileInfo.absolutePath();
+    const bool withCover = !coverDirectories.contains(directory);
+    if (withCover) coverDirectories.insert(directory);
+    Tags *tags;
+    {
+        ScanTelemetry::Timer timer(telemetry, ScanTelemetry::Tags);
+        // the first scan should make the collection browsable quickly:
+        // MPEG durations that need a frame count are left to DurationUpdater
+        const int durationStyle =
+                incremental ? TagUtils::AccurateDuration : TagUtils::FastDuration;
+        tags = TagUtils::load(filename, TagUtils::ScanFields | TagUtils::SkipNonAudio |
+                                                durationStyle |
+                                                (withCover ? TagUtils::CoverField : 0));
+    }
 
     // if taglib cannot parse the file, drop it
     if (!tags) {
         // qDebug() << "Taglib cannot parse" << fileInfo.absoluteFilePath();
-        fileQueue.removeAll(fileInfo);
+        removeFromQueue(entry.path);
 
         // add to nontracks table
         QString path = fileInfo.absoluteFilePath();
         path.remove(this->rootDirectory.absolutePath() + "/");
-        insertOrUpdateNonTrack(path, QDateTime::currentDateTimeUtc().toTime_t());
+        queueNonTrack(path, entry);
 
         QTimer::singleShot(0, this, SLOT(popFromQueue()));
         return;
@@ -212,6 +299,7 @@ void CollectionScanner::popFromQueue() {
     // facing countless perils and finally reaching its final destination
     FileInfo *file = new FileInfo();
     file->setFileInfo(fileInfo);
+    file->setEntry(entry);
 
     // Copy TagLib::FileRef in our Tags class.
     // TagLib::FileRef keeps files open and we would quickly reach the max open files limit
@@ -239,19 +327,30 @@ void CollectionScanner::popFromQueue() {
 void CollectionScanner::stop() {
     if (working) {
         qDebug() << "Scan stopped";
+        DataUtils::setNormalizeTagCacheEnabled(false);
         Database::instance().getConnection().rollback();
         Database::instance().closeConnection();
         stopped = true;
         working = false;
+        walker->stop();
+        walking = false;
         qDebug() << "stop thread" << thread();
         thread()->exit();
     }
 }
 
 void CollectionScanner::complete() {
+    flushNonTracks();
+
     if (incremental) {
+        QSqlDatabase db = Database::instance().getConnection();
+        db.transaction();
         // clean db from stale data: non-existing files
         cleanStaleTracks();
+        if (GenreTree::rebuild()) TileArtwork::rebuild();
+        if (!db.commit()) qWarning() << "Commit failed!";
+    } else if (GenreTree::rebuild()) {
+        TileArtwork::rebuild();
     }
 
     Database::instance().setCollectionRoot(rootDirectory.absolutePath());
@@ -264,11 +363,15 @@ void CollectionScanner::complete() {
         }
     }
 
+    // every album and artist of the collection is in the db now
+    ArtworkStore::collectGarbage();
+
     QString hash = directoryHash(rootDirectory);
     QSettings settings;
     settings.setValue("collectionHash", hash);
     qDebug() << "Setting collection hash to" << hash;
-    trackPaths.clear();
+    trackStamps.clear();
+    nontrackStamps.clear();
 
     QSqlQuery("vacuum", Database::instance().getConnection());
 
@@ -283,8 +386,32 @@ void CollectionScanner::complete() {
 }
 
 void CollectionScanner::emitFinished() {
+    DataUtils::setNormalizeTagCacheEnabled(false);
     QVariantMap stats;
     stats.insert("trackCount", processedTrackPaths.size());
+    stats.insert("movedTrackCount", movedTrackCount);
+    stats.insert("duplicateDirectoryCount", walker->duplicateDirectoryCount());
+    stats.insert("duplicateFileCount", walker->duplicateFileCount() + duplicateFileCount);
+    const qint64 statementHits =
+            Database::instance().statementCacheHits() - statementCacheHitsAtStart;
+    const qint64 statementMisses =
+            Database::instance().statementCacheMisses() - statementCacheMissesAtStart;
+    stats.insert("statementCacheHits", statementHits);
+    stats.insert("statementCacheMisses", statementMisses);
+    if (statementHits + statementMisses > 0)
+        stats.insert("statementCacheHitRate",
+                     double(statementHits) / double(statementHits + statementMisses));
+#ifndef Q_OS_WIN
+    // the reads TagLib asked for, each one was a syscall or two with TagLib::FileStream
+    stats.insert("tagBlockReads", ReadAheadStream::blockReads() - tagBlockReadsAtStart);
+    stats.insert("tagFileReads", ReadAheadStream::fileReads() - tagFileReadsAtStart);
+#endif
+    const QVariantMap telemetryMap = telemetry.toVariantMap();
+    stats.insert("telemetry", telemetryMap);
+    // keep the last full scan around, incremental scans happen at every startup
+    const char *telemetryFile =
+            incremental ? "/scan-telemetry-incremental.json" : "/scan-telemetry-full.json";
+    ScanTelemetry::save(telemetryMap, Database::getDataLocation() + telemetryFile);
     stats.insert("trackPaths", processedTrackPaths);
     stats.insert("tracksNeedingFix", tracksNeedingFix);
     emit finished(stats);
@@ -305,81 +432,66 @@ void CollectionScanner::setDirectory(const QString &directory) {
 }
 
 QString CollectionScanner::directoryHash(const QDir &directory) {
+    ScanTelemetry::Timer timer(telemetry, ScanTelemetry::Fingerprint);
     return treeFingerprint(directory.absolutePath()).toHex();
 }
 
 QByteArray CollectionScanner::treeFingerprint(const QString &path) {
-    // qDebug() << "Hashing dir" << directory.absolutePath();
-    QDir directory(path);
-    directory.setFilter(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Readable);
-    const QFileInfoList list = directory.entryInfoList();
-
-    QCryptographicHash hash(QCryptographicHash::Md5);
-
-    for (const auto &fileInfo : list) {
-        hash.addData(fileInfo.fileName().toUtf8());
-        if (fileInfo.isDir()) {
-            // this is a directory, recurse
-            const QString subDirPath = fileInfo.absoluteFilePath();
-#ifdef APP_MAC
-            if (directoryBlacklist.contains(subDirPath)) {
-                qDebug() << "Skipping directory" << subDirPath;
-                continue;
-            }
-#endif
-            hash.addData(treeFingerprint(subDirPath));
-        } else {
-            // this is a file, add to hash
-            // qDebug() << "Hashing file" << fileInfo.absolutePath();
-            const qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
-            hash.addData(QByteArray::number(lastModified, 16));
-        }
+    DirectoryWalker fingerprintWalker;
+    fingerprintWalker.setSkippedDirectories(directoryBlacklist);
+    return fingerprintWalker.fingerprint(path);
+}
+
+void CollectionScanner::filesFound(const DirectoryWalker::Entries &entries) {
+    if (stopped || !working) return;
+
+    const int queueSize = fileQueue.size();
+    for (const DirectoryWalker::Entry &entry : entries) {
+        if (entry.isImage)
+            coverCandidates[QFileInfo(entry.path).absolutePath()] << entry.path;
+        else
+            processFile(entry);
+    }
+    maxQueueSize += fileQueue.size() - queueSize;
+
+    if (waitingForFiles && !fileQueue.isEmpty()) {
+        waitingForFiles = false;
+        popFromQueue();
     }
-    return hash.result();
 }
 
-void CollectionScanner::scanDirectory(const QDir &directory) {
-    QStack<QDir> stack;
-    stack.push(directory);
-    while (!stack.empty()) {
-        const QDir dir = stack.pop();
-        const QFileInfoList flist =
-                dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files | QDir::Readable);
+void CollectionScanner::walkFinished() {
+    if (stopped || !working) return;
 
-        for (const QFileInfo &fileInfo : flist) {
-            if (fileInfo.isFile()) {
-                processFile(fileInfo);
-            } else if (fileInfo.isDir()) {
-                QString subDirPath = fileInfo.absoluteFilePath();
-#ifdef APP_MAC
-                if (directoryBlacklist.contains(subDirPath)) {
-                    qDebug() << "Skipping directory" << subDirPath;
-                    continue;
-                }
-#endif
-                QDir subDir(subDirPath);
-                stack.push(subDir);
-            }
-        }
+    telemetry.record(ScanTelemetry::Walk, telemetry.now() - walkStart);
+    walking = false;
+    qDebug() << "Found" << maxQueueSize << "files to scan";
+
+    if (waitingForFiles) {
+        waitingForFiles = false;
+        popFromQueue();
     }
 }
 
-void CollectionScanner::processFile(const QFileInfo &fileInfo) {
-    // qDebug() << "FILE:" << fileInfo.absoluteFilePath();
+void CollectionScanner::processFile(const DirectoryWalker::Entry &entry) {
+    // qDebug() << "FILE:" << entry.path;
 
     // 1GB limit
-    static const int MAX_FILE_SIZE = 1024 * 1024 * 1024;
+    static const qint64 MAX_FILE_SIZE = 1024 * 1024 * 1024;
     // skip big files
-    if (fileInfo.size() > MAX_FILE_SIZE) {
-        // qDebug() << "Skipping file:" << fileInfo.absoluteFilePath();
+    if (entry.size > MAX_FILE_SIZE) {
+        // qDebug() << "Skipping file:" << entry.path;
         return;
     }
 
+    // no stat here, QFileInfo only splits the path
+    const QFileInfo fileInfo(entry.path);
+
     // skip UNIX hidden files
     // blacklist image files and other common file extensions
     if (fileInfo.baseName().isEmpty() ||
         fileExtensionsBlacklist.contains(fileInfo.suffix().toLower())) {
-        // qDebug() << "Skipping file:" << fileInfo.absoluteFilePath();
+        // qDebug() << "Skipping file:" << entry.path;
         return;
     }
 
@@ -388,42 +500,86 @@ void CollectionScanner::processFile(const QFileInfo &fileInfo) {
     if (incremental) {
         if (stopped) return;
 
-        const uint lastModified = fileInfo.lastModified().toTime_t();
-        if (lastModified > lastUpdate) {
-            // qDebug() << "lastModified > lastUpdate" << path;
-            qDebug() << "Modified file" << fileInfo.absoluteFilePath();
-            fileQueue << fileInfo;
+        // path relative to the root of the collection
+        QString path = entry.path;
+        path.remove(this->rootDirectory.absolutePath() + "/");
+        // the tracks left in trackStamps when the walk is over are gone from disk
+        const auto i = trackStamps.constFind(path);
+        if (i != trackStamps.constEnd()) {
+            const bool modified = !i.value().matches(entry);
+            trackStamps.erase(i);
+            if (modified) {
+                qDebug() << "Modified file" << entry.path;
+                fileQueue << entry;
+            }
             return;
         }
 
         /*
         if (Track::isModified(path, lastModified)) {
             // qDebug() << "Track::isModified" << path;
-            fileQueue << fileInfo;
+            fileQueue << entry;
 
         } else {
         */
 
         if (stopped) return;
 
-        // path relative to the root of the collection
-        QString path = fileInfo.absoluteFilePath();
-        path.remove(this->rootDirectory.absolutePath() + "/");
-
         // qDebug() << "Trying !isNonTrack && !isTrack" << path;
         // !isNonTrack(path) &&
         // if (!Track::exists(path)) {
-        if (!trackPaths.contains(path) && !nontrackPaths.contains(path)) {
+        const auto nontrack = nontrackStamps.constFind(path);
+        if (nontrack == nontrackStamps.constEnd()) {
+            if (matchKnownTrack(entry, path)) return;
             qDebug() << "New file" << path;
-            fileQueue << fileInfo;
+            fileQueue << entry;
+        } else if (!nontrack.value().matches(entry)) {
+            // maybe it has tags now
+            qDebug() << "Modified file" << path;
+            fileQueue << entry;
         }
 
         // }
 
     } else {
         // non-incremental scan, i.e. first scan: scan every file
-        fileQueue << fileInfo;
+        fileQueue << entry;
+    }
+}
+
+bool CollectionScanner::matchKnownTrack(const DirectoryWalker::Entry &entry, const QString &path) {
+    if (!entry.inode) return false;
+    const QString root = rootDirectory.absolutePath() + "/";
+    const QStringList oldPaths = Track::pathsForFile(entry.inode, entry.size, entry.lastModified);
+    for (const QString &oldPath : oldPaths) {
+        const FileState state = fileStateAt(root + oldPath, entry);
+        if (state == SameFile) {
+            // a hard link or a directory reached twice, e.g. a bind mount:
+            // the stored path wins whatever the walk order, the walker may have skipped it
+            trackStamps.remove(oldPath);
+            duplicateFileCount++;
+            qDebug() << "Duplicate file" << path << "of" << oldPath;
+            return true;
+        }
+        // walked already or still there: a copy, not a move
+        if (state != FileGone || !trackStamps.contains(oldPath)) continue;
+        if (!Track::updatePath(oldPath, path, entry.device, entry.lastChanged)) continue;
+        trackStamps.remove(oldPath);
+        movedTrackCount++;
+        qDebug() << "Moved file" << oldPath << "to" << path;
+        return true;
+    }
+    return false;
+}
+
+bool CollectionScanner::removeFromQueue(const QString &path) {
+    for (int i = 0; i < fileQueue.size(); ++i) {
+        if (fileQueue.at(i).path == path) {
+            fileQueue.remove(i);
+            return true;
+        }
     }
+    return false;
 }
 
 /*** Artist ***/
@@ -486,7 +642,11 @@ void CollectionScanner::processArtist(FileInfo *file) {
     filesWaitingForArtists.insert(artist->getHash(), files);
 
     connect(artist, SIGNAL(gotInfo()), SLOT(gotArtistInfo()));
-    artist->fetchInfo();
+    infoRequestTimes.insert(artist, telemetry.now());
+    if (offline)
+        QMetaObject::invokeMethod(artist, "gotInfo", Qt::QueuedConnection);
+    else
+        artist->fetchInfo();
 }
 
 void CollectionScanner::gotArtistInfo() {
@@ -496,6 +656,9 @@ void CollectionScanner::gotArtistInfo() {
         qDebug() << "Cannot get sender";
         return;
     }
+    if (infoRequestTimes.contains(artist))
+        telemetry.record(ScanTelemetry::ArtistInfo,
+                         telemetry.now() - infoRequestTimes.take(artist));
     // qDebug() << "got info for" << artist->getName();
 
     int artistId = Artist::idForName(artist->getName());
@@ -596,7 +759,11 @@ void CollectionScanner::processAlbumArtist(FileInfo *file) {
     filesWaitingForAlbumArtists.insert(artist->getHash(), files);
 
     connect(artist, SIGNAL(gotInfo()), SLOT(gotArtistInfo()));
-    artist->fetchInfo();
+    infoRequestTimes.insert(artist, telemetry.now());
+    if (offline)
+        QMetaObject::invokeMethod(artist, "gotInfo", Qt::QueuedConnection);
+    else
+        artist->fetchInfo();
 }
 
 /*** Album ***/
@@ -657,17 +824,29 @@ void CollectionScanner::processAlbum(FileInfo *file) {
     album->setProperty("originalHash", album->getHash());
 
     // local covers
-    const QString imageLocation = album->getImageLocation();
-    if (!QFile::exists(imageLocation)) {
+    if (!album->hasPhoto()) {
         const QString filePath = file->getFileInfo().absolutePath();
         bool localCover = false;
-        localCover = CoverUtils::coverFromFile(filePath, album);
+        {
+            ScanTelemetry::Timer timer(telemetry, ScanTelemetry::LocalCover);
+            QStringList candidates = coverCandidates.value(filePath);
+            // in the order the directory listing used to give
+            candidates.sort(Qt::CaseInsensitive);
+            localCover = CoverUtils::coverFromFiles(candidates, album);
+        }
         if (!localCover) {
-            localCover = CoverUtils::coverFromTags(filePath, album);
+            ScanTelemetry::Timer timer(telemetry, ScanTelemetry::EmbeddedCover);
+            Tags *tags = file->getTags();
+            if (tags->isCoverLoaded())
+                localCover = CoverUtils::coverFromData(tags->getCoverData(), album);
+            else
+                localCover = CoverUtils::coverFromTags(file->getFileInfo().absoluteFilePath(),
+                                                       album);
             if (localCover) qDebug() << "Found embedded cover for" << filePath;
         }
         if (localCover) album->setProperty("localCover", true);
     }
+    file->getTags()->releaseCoverData();
 
     if (loadedAlbums.contains(album->getHash())) {
         qDebug() << "ERROR Album already processed!" << album->getTitle() << album->getHash();
@@ -687,7 +866,11 @@ void CollectionScanner::processAlbum(FileInfo *file) {
     filesWaitingForAlbums.insert(album->getHash(), files);
 
     connect(album, SIGNAL(gotInfo()), SLOT(gotAlbumInfo()));
-    album->fetchInfo();
+    infoRequestTimes.insert(album, telemetry.now());
+    if (offline)
+        QMetaObject::invokeMethod(album, "gotInfo", Qt::QueuedConnection);
+    else
+        album->fetchInfo();
 }
 
 void CollectionScanner::gotAlbumInfo() {
@@ -697,6 +880,9 @@ void CollectionScanner::gotAlbumInfo() {
         qDebug() << "Cannot get sender";
         return;
     }
+    if (infoRequestTimes.contains(album))
+        telemetry.record(ScanTelemetry::AlbumInfo,
+                         telemetry.now() - infoRequestTimes.take(album));
 
     const QString hash = album->property("originalHash").toString();
     // qDebug() << "got info for album" << album->getTitle() << hash << album->getHash();
@@ -733,6 +919,7 @@ void CollectionScanner::gotAlbumInfo() {
 /*** Track ***/
 
 void CollectionScanner::processTrack(FileInfo *file) {
+    file->getTags()->releaseCoverData();
     Track *track = new Track();
     QString titleTag = file->getTags()->getTitle();
     // qDebug() << "we have a fresh track:" << titleTag;
@@ -752,7 +939,12 @@ void CollectionScanner::processTrack(FileInfo *file) {
         if (album->getId() > 0) track->setAlbum(album);
         // else qDebug() << "track"<< track->getTitle() << "has no album";
         if (!album->getArtist()) {
-            album->setArtist(artist);
+            // the album may be a cached one, which belongs to the GUI thread
+            if (album->thread() == QThread::currentThread())
+                album->setArtist(artist);
+            else
+                QMetaObject::invokeMethod(album, "setArtist", Qt::QueuedConnection,
+                                          Q_ARG(Artist *, artist));
         }
     }
 
@@ -774,29 +966,28 @@ void CollectionScanner::processTrack(FileInfo *file) {
     track->setYear(year);
 
     track->setLength(file->getTags()->getDuration());
+    const DirectoryWalker::Entry &entry = file->getEntry();
+    track->setFileIdentity(entry.device, entry.inode, entry.size, entry.lastModified,
+                           entry.lastChanged);
 
     // if (artist && artist->getId() > 0) {
     // artist = album->getArtist();
     track->setArtist(artist);
     // }
 
-    QString genreTag = file->getTags()->getGenre();
+    const QString genreTag = file->getTags()->getGenre();
     if (!genreTag.isEmpty()) {
-        auto genreNames =
-                genreTag.splitRef(QRegularExpression("([,/-;]| & )"), QString::SkipEmptyParts);
-        for (QStringRef &genreNameRef : genreNames) {
-            QString genreName = Genre::cleanGenreName(genreNameRef);
-            if (!genreName.isEmpty()) {
-                Genre *genre = Genre::maybeCreateByName(genreName);
-                if (genre) track->addGenre(genre);
-            }
+        const QStringList genreNames = Genre::namesFromTag(genreTag);
+        for (const QString &genreName : genreNames) {
+            Genre *genre = Genre::maybeCreateByName(genreName);
+            if (genre) track->addGenre(genre);
         }
     }
 
     // if (album) album->fixTrackTitle(track);
 
     // qDebug() << "Removing" << file->getFileInfo().baseName() << "from queue";
-    if (!fileQueue.removeAll(file->getFileInfo())) {
+    if (!removeFromQueue(file->getEntry().path)) {
         qDebug() << "Cannot remove file from queue";
     }
 
@@ -805,14 +996,19 @@ void CollectionScanner::processTrack(FileInfo *file) {
     const bool needsFix = TagChecker::checkTags(file->getTags());
     if (needsFix) tracksNeedingFix << path;
 
-    if (incremental && Track::exists(track->getPath())) {
-        qDebug() << "Updating track:" << track->getTitle();
-        // qDebug() << "with album" << track->getAlbum() << track->getAlbum()->getId();
-        // qDebug() << "with artist" << track->getArtist() << track->getArtist()->getId();
-        track->update();
-    } else {
-        // qDebug() << "We have a new cool track:" << track->getTitle();
-        track->insert();
+    {
+        ScanTelemetry::Timer timer(telemetry, ScanTelemetry::TrackInsert);
+        if (incremental && Track::exists(track->getPath())) {
+            qDebug() << "Updating track:" << track->getTitle();
+            // qDebug() << "with album" << track->getAlbum() << track->getAlbum()->getId();
+            // qDebug() << "with artist" << track->getArtist() << track->getArtist()->getId();
+            track->update();
+        } else {
+            // qDebug() << "We have a new cool track:" << track->getTitle();
+            track->insert();
+        }
+        if (file->getTags()->isDurationUncertain() && track->getId() > 0)
+            DurationUpdater::enqueue(track->getId());
     }
 
     /*
@@ -824,6 +1020,13 @@ void CollectionScanner::processTrack(FileInfo *file) {
     int percent = (maxQueueSize - fileQueue.size()) * 100 / maxQueueSize;
     emit progress(percent);
 
+    // twice per second is plenty for the scanner view
+    static const qint64 telemetryInterval = 500 * 1000 * 1000;
+    if (telemetry.now() - lastTelemetryUpdate > telemetryInterval) {
+        lastTelemetryUpdate = telemetry.now();
+        emit telemetryUpdated(telemetry.toVariantMap());
+    }
+
     // next!
     QTimer::singleShot(0, this, SLOT(popFromQueue()));
 
@@ -845,19 +1048,10 @@ void CollectionScanner::processTrack(FileInfo *file) {
 }
 
 void CollectionScanner::cleanStaleTracks() {
-    QString collectionRoot = rootDirectory.absolutePath() + "/";
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select path from tracks");
-    bool success = query.exec();
-    if (!success) qWarning() << query.lastError().text();
-    while (query.next()) {
-        QString path = query.value(0).toString();
-        if (!QFile::exists(collectionRoot + path)) {
-            qDebug() << "Removing track" << path;
-            Track::remove(path);
-        }
-    }
+    // every file the walk found was taken out of trackStamps
+    if (trackStamps.isEmpty()) return;
+    qDebug() << "Removing" << trackStamps.size() << "stale tracks";
+    Track::remove(trackStamps.keys());
 }
 
 bool CollectionScanner::isNonTrack(const QString &path) {
@@ -872,54 +1066,65 @@ bool CollectionScanner::isNonTrack(const QString &path) {
     return tstamp;
 }
 
-bool CollectionScanner::isModifiedNonTrack(const QString &path, uint lastModified) {
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select tstamp from nontracks where path=? and tstamp<?");
+bool CollectionScanner::insertOrUpdateNonTrack(const QString &path, const FileStamp &stamp) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert or replace into nontracks (path, tstamp, size, mtime, ctime) "
+            "values (?, ?, ?, ?, ?)");
     query.bindValue(0, path);
-    query.bindValue(1, lastModified);
+    query.bindValue(1, QDateTime::currentDateTimeUtc().toTime_t());
+    query.bindValue(2, stamp.size);
+    query.bindValue(3, stamp.lastModified);
+    query.bindValue(4, stamp.lastChanged);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
-    bool ret = query.next();
-    qDebug() << path << lastModified << ret;
-    return query.next();
+    return !query.next();
+}
+
+void CollectionScanner::queueNonTrack(const QString &path, const DirectoryWalker::Entry &entry) {
+    const FileStamp stamp = {entry.size, entry.lastModified, entry.lastChanged};
+    pendingNonTracks.append(qMakePair(path, stamp));
+    if (pendingNonTracks.size() >= 256) flushNonTracks();
 }
 
-bool CollectionScanner::insertOrUpdateNonTrack(const QString &path, uint lastModified) {
+void CollectionScanner::flushNonTracks() {
+    if (pendingNonTracks.isEmpty()) return;
+    // a full scan is already in a transaction
     QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("insert or replace into nontracks (path, tstamp) values (?, ?)");
-    query.bindValue(0, path);
-    query.bindValue(1, lastModified);
-    bool success = query.exec();
-    if (!success) qDebug() << query.lastError().text();
-    return !query.next();
+    if (incremental) db.transaction();
+    for (const auto &nonTrack : qAsConst(pendingNonTracks))
+        insertOrUpdateNonTrack(nonTrack.first, nonTrack.second);
+    if (incremental && !db.commit()) qWarning() << "Commit failed!";
+    pendingNonTracks.clear();
 }
 
-QStringList CollectionScanner::getTrackPaths() {
+QHash<QString, CollectionScanner::FileStamp> CollectionScanner::getTrackStamps() {
     QSqlDatabase db = Database::instance().getConnection();
     QSqlQuery query(db);
-    query.prepare("select path from tracks");
+    query.setForwardOnly(true);
+    query.prepare("select path, size, mtime, ctime from tracks");
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
-    QStringList paths;
-    paths.reserve(query.size());
+    QHash<QString, FileStamp> stamps;
     while (query.next()) {
-        paths << query.value(0).toString();
+        const FileStamp stamp = {query.value(1).toLongLong(), query.value(2).toLongLong(),
+                                 query.value(3).toLongLong()};
+        stamps.insert(query.value(0).toString(), stamp);
     }
-    return paths;
+    return stamps;
 }
 
-QStringList CollectionScanner::getNonTrackPaths() {
+QHash<QString, CollectionScanner::FileStamp> CollectionScanner::getNonTrackStamps() {
     QSqlDatabase db = Database::instance().getConnection();
     QSqlQuery query(db);
-    query.prepare("select path from nontracks");
+    query.setForwardOnly(true);
+    query.prepare("select path, size, mtime, ctime from nontracks");
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
-    QStringList paths;
-    paths.reserve(query.size());
+    QHash<QString, FileStamp> stamps;
     while (query.next()) {
-        paths << query.value(0).toString();
+        const FileStamp stamp = {query.value(1).toLongLong(), query.value(2).toLongLong(),
+                                 query.value(3).toLongLong()};
+        stamps.insert(query.value(0).toString(), stamp);
     }
-    return paths;
+    return stamps;
 }
@@ -29,6 +29,8 @@ $END_LICENSE */
 #include "fileref.h"
 #include "tag.h"
 
+#include "directorywalker.h"
+#include "scantelemetry.h"
 #include "tags.h"
 
 class FileInfo {
@@ -49,6 +51,9 @@ public:
     void setAlbum(Album *album) { this->album = album; }
     QFileInfo getFileInfo() { return fileInfo; }
     void setFileInfo(QFileInfo fileInfo) { this->fileInfo = fileInfo; }
+    // as the walker found it
+    const DirectoryWalker::Entry &getEntry() const { return entry; }
+    void setEntry(const DirectoryWalker::Entry &value) { entry = value; }
 
 private:
     Artist *artist;
@@ -56,6 +61,7 @@ private:
     Album *album;
     Tags *tags;
     QFileInfo fileInfo;
+    DirectoryWalker::Entry entry;
 };
 
 class CollectionScanner : public QObject {
@@ -64,17 +70,21 @@ class CollectionScanner : public QObject {
 public:
     CollectionScanner(QObject *parent);
     void setDirectory(const QString &directory);
+    // Do not fetch artist and album info from the internet, used by benchmarks
+    void setOffline(bool value) { offline = value; }
     void run();
     void stop();
     void complete();
 
 signals:
     void progress(int);
+    void telemetryUpdated(const QVariantMap &telemetry);
     void finished(const QVariantMap &stats);
     void error(QString message);
 
 private slots:
-    void scanDirectory(const QDir &directory);
+    void filesFound(const DirectoryWalker::Entries &entries);
+    void walkFinished();
     void popFromQueue();
     void giveThisFileAnArtist(FileInfo *file);
     void processArtist(FileInfo *file);
@@ -88,38 +98,79 @@ private slots:
     void emitFinished();
 
 private:
+    // What the walk compares against the db, a file is read again when any of these moved
+    struct FileStamp {
+        qint64 size;
+        qint64 lastModified;
+        qint64 lastChanged;
+        bool matches(const DirectoryWalker::Entry &entry) const {
+            return size == entry.size && lastModified == entry.lastModified &&
+                   lastChanged == entry.lastChanged;
+        }
+    };
+
     void reset();
-    void processFile(const QFileInfo &fileInfo);
+    void processFile(const DirectoryWalker::Entry &entry);
+    // A new path for a file the db knows: moved, or reached twice
+    bool matchKnownTrack(const DirectoryWalker::Entry &entry, const QString &path);
+    bool removeFromQueue(const QString &path);
     void cleanStaleTracks();
     static bool isNonTrack(const QString &path);
-    static bool isModifiedNonTrack(const QString &path, uint lastModified);
-    static bool insertOrUpdateNonTrack(const QString &path, uint lastModified);
+    static bool insertOrUpdateNonTrack(const QString &path, const FileStamp &stamp);
+    void queueNonTrack(const QString &path, const DirectoryWalker::Entry &entry);
+    void flushNonTracks();
     QString directoryHash(const QDir &directory);
     QByteArray treeFingerprint(const QString &path);
-    QStringList getTrackPaths();
-    QStringList getNonTrackPaths();
+    QHash<QString, FileStamp> getTrackStamps();
+    QHash<QString, FileStamp> getNonTrackStamps();
 
     bool working;
     bool stopped;
     bool incremental;
+    bool offline;
     QDir rootDirectory;
-    uint lastUpdate;
 
-    QVector<QFileInfo> fileQueue;
+    DirectoryWalker *walker;
+    // the walker is still finding files
+    bool walking;
+    // the queue ran dry while walking, the next batch restarts the pipeline
+    bool waitingForFiles;
+    qint64 walkStart;
+
+    QVector<DirectoryWalker::Entry> fileQueue;
     int maxQueueSize;
+    int movedTrackCount;
+    int duplicateFileCount;
     QHash<QString, Artist *> loadedArtists;
     QHash<QString, QVector<FileInfo *>> filesWaitingForArtists;
     QHash<QString, QVector<FileInfo *>> filesWaitingForAlbumArtists;
     QHash<QString, Album *> loadedAlbums;
     QHash<QString, QVector<FileInfo *>> filesWaitingForAlbums;
-    QStringList trackPaths;
-    QStringList nontrackPaths;
+    // directories whose first file was loaded with its embedded cover
+    QSet<QString> coverDirectories;
+    // cover image files found by the walker, by directory
+    QHash<QString, QStringList> coverCandidates;
+    // incremental scans: the db tracks not found by the walk yet, by path
+    QHash<QString, FileStamp> trackStamps;
+    QHash<QString, FileStamp> nontrackStamps;
+    // written in batches, there can be many in a row
+    QVector<QPair<QString, FileStamp>> pendingNonTracks;
 
     QStringList directoryBlacklist;
     QStringList fileExtensionsBlacklist;
 
     QStringList processedTrackPaths;
     QStringList tracksNeedingFix;
+
+    qint64 statementCacheHitsAtStart;
+    qint64 statementCacheMissesAtStart;
+    qint64 tagBlockReadsAtStart;
+    qint64 tagFileReadsAtStart;
+
+    ScanTelemetry telemetry;
+    // when artist or album info was requested
+    QHash<QObject *, qint64> infoRequestTimes;
+    qint64 lastTelemetryUpdate;
 };
 
 #endif // COLLECTIONSCANNER_H
@@ -22,9 +22,9 @@ $END_LICENSE */
 #include "collectionscanner.h"
 
 CollectionScannerThread::CollectionScannerThread(QObject *parent)
-    : QThread(parent), scanner(nullptr) {
-    // This will be used by Database to cache connections for this thread
-    setObjectName("scanner" + QString::number(qrand()));
+    : QThread(parent), offline(false), scanner(nullptr) {
+    // Only used for debugging, Database names its own connections
+    setObjectName("scanner");
 }
 
 void CollectionScannerThread::run() {
@@ -33,7 +33,10 @@ void CollectionScannerThread::run() {
     if (!scanner) {
         scanner = new CollectionScanner(nullptr);
         scanner->setDirectory(rootDirectory);
+        scanner->setOffline(offline);
         connect(scanner, SIGNAL(progress(int)), SIGNAL(progress(int)), Qt::QueuedConnection);
+        connect(scanner, SIGNAL(telemetryUpdated(QVariantMap)),
+                SIGNAL(telemetryUpdated(QVariantMap)), Qt::QueuedConnection);
         connect(scanner, SIGNAL(error(QString)), SIGNAL(error(QString)), Qt::QueuedConnection);
         connect(scanner, SIGNAL(finished(QVariantMap)), SLOT(finish(QVariantMap)),
                 Qt::QueuedConnection);
@@ -32,10 +32,12 @@ public:
     ~CollectionScannerThread();
     static CollectionScannerThread &instance();
     void setDirectory(QString directory);
+    void setOffline(bool value) { offline = value; }
     void run();
 
 signals:
     void progress(int);
+    void telemetryUpdated(const QVariantMap &telemetry);
     void error(QString message);
     void finished(const QVariantMap &stats);
 
@@ -47,6 +49,7 @@ private:
     CollectionScannerThread(QObject *parent = nullptr);
 
     QString rootDirectory;
+    bool offline;
     CollectionScanner* scanner;
 
 };
@@ -59,6 +59,11 @@ CollectionScannerView::CollectionScannerView(QWidget *parent) : View(parent) {
     progressBar->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Minimum);
     layout->addWidget(progressBar);
 
+    telemetryLabel = new QLabel(this);
+    telemetryLabel->setFont(FontUtils::small());
+    telemetryLabel->hide();
+    layout->addWidget(telemetryLabel);
+
     tipLabel = new QLabel(
             "<html><style>a { color: palette(text); }</style><body>" +
                     // tr("%1 is using <a href='%2'>%3</a> to catalog your music.")
@@ -76,10 +81,13 @@ void CollectionScannerView::setCollectionScannerThread(CollectionScannerThread *
     // qDebug() << "CollectionScannerView::startScan" << directory;
 
     progressBar->setMaximum(1);
+    telemetryLabel->hide();
 
     connect(scannerThread, SIGNAL(progress(int)), SLOT(progress(int)), Qt::QueuedConnection);
     connect(scannerThread, SIGNAL(progress(int)), progressBar, SLOT(setValue(int)),
             Qt::QueuedConnection);
+    connect(scannerThread, SIGNAL(telemetryUpdated(QVariantMap)),
+            SLOT(updateTelemetry(QVariantMap)), Qt::QueuedConnection);
 }
 
 void CollectionScannerView::scanError(const QString &message) {
@@ -90,6 +98,23 @@ void CollectionScannerView::progress(int value) {
     if (value > 0 && progressBar->maximum() != 100) progressBar->setMaximum(100);
 }
 
+void CollectionScannerView::updateTelemetry(const QVariantMap &telemetry) {
+    const QVariantMap queues = telemetry.value("queues").toMap();
+    const int waitingArtists = queues.value("artists").toMap().value("current").toInt();
+    const int waitingAlbums = queues.value("albums").toMap().value("current").toInt();
+
+    QString text = tr("%1 files, %2 per second, %3 MB read")
+                           .arg(telemetry.value("files").toInt())
+                           .arg(telemetry.value("filesPerSecond").toDouble(), 0, 'f', 0)
+                           .arg(telemetry.value("bytes").toLongLong() / (1024 * 1024));
+    if (waitingArtists + waitingAlbums > 0)
+        text += QLatin1String(" - ") + tr("waiting for %1 artists and %2 albums")
+                                               .arg(waitingArtists)
+                                               .arg(waitingAlbums);
+    telemetryLabel->setText(text);
+    telemetryLabel->show();
+}
+
 void CollectionScannerView::screenChanged() {
     logo->setPixmap(IconUtils::pixmap(":/images/app.png", devicePixelRatioF()));
 }
@@ -48,12 +48,14 @@ protected:
 
 private slots:
     void progress(int value);
+    void updateTelemetry(const QVariantMap &telemetry);
     void scanError(const QString& message);
     void screenChanged();
 
 private:
     QLabel *logo;
     QProgressBar *progressBar;
+    QLabel *telemetryLabel;
 
 };
 
@@ -19,22 +19,32 @@ along with Musique.  If not, see <http://www.gnu.org/licenses/>.
 $END_LICENSE */
 
 #include "coverutils.h"
+#include "artworkstore.h"
 #include "finderitemdelegate.h"
+#include "imageutils.h"
 #include "model/album.h"
+#include "tagutils.h"
 
-bool CoverUtils::isAcceptableImage(const QImage &image) {
+namespace {
+
+// Stored covers are at most this big
+const int maximumSize = 300;
+
+} // namespace
+
+bool CoverUtils::isAcceptableSize(const QSize &size) {
     const int minimumSize = FinderItemDelegate::ITEM_WIDTH;
-    const int width = image.size().width();
-    const int height = image.size().height();
+    const int width = size.width();
+    const int height = size.height();
 
     if (width < minimumSize || height < minimumSize) {
-        qDebug() << "Local cover too small" << image.size();
+        qDebug() << "Local cover too small" << size;
         return false;
     }
 
     float aspectRatio = (float)width / (float)height;
     if (aspectRatio > 1.2 || aspectRatio < 0.8) {
-        qDebug() << "Local cover not square enough" << image.size();
+        qDebug() << "Local cover not square enough" << size;
         return false;
     }
 
@@ -42,13 +52,11 @@ bool CoverUtils::isAcceptableImage(const QImage &image) {
 }
 
 QImage CoverUtils::maybeScaleImage(const QImage &image) {
-    static const int maximumSize = 300;
     const int width = image.size().width();
     const int height = image.size().height();
     if (width > maximumSize || height > maximumSize) {
         qDebug() << "Scaling local cover" << image.size();
-        return image.scaled(maximumSize, maximumSize, Qt::KeepAspectRatio,
-                            Qt::SmoothTransformation);
+        return ImageUtils::scaled(image, QSize(maximumSize, maximumSize));
     }
     return image;
 }
@@ -61,114 +69,75 @@ bool CoverUtils::saveImage(const QImage &image, Album *album) {
     return true;
 }
 
-bool CoverUtils::coverFromFile(const QString &dir, Album *album) {
-    static const QVector<QRegExp> coverREs = [] {
-        QLatin1String ext(".(jpe?g|gif|png|bmp)");
-        QVector<QRegExp> res;
-        res << QRegExp(".*cover.*" + ext, Qt::CaseInsensitive)
-            << QRegExp(".*front.*" + ext, Qt::CaseInsensitive)
-            << QRegExp(".*folder.*" + ext, Qt::CaseInsensitive);
-        return res;
+const QRegularExpression &CoverUtils::coverFilePattern() {
+    static const QRegularExpression re = [] {
+        QRegularExpression re("(cover|front|folder).*\\.(jpe?g|gif|png|bmp)$",
+                              QRegularExpression::CaseInsensitiveOption);
+        re.optimize();
+        return re;
     }();
+    return re;
+}
 
-    const QFileInfoList flist =
-            QDir(dir).entryInfoList(QDir::NoDotAndDotDot | QDir::Files | QDir::Readable);
-
-    for (const QFileInfo &fileInfo : flist) {
-        const QString filename = fileInfo.fileName();
-        for (const QRegExp &re : coverREs) {
-            if (filename.contains(re)) {
-                qDebug() << "Found local cover" << filename;
-                QImage image(fileInfo.absoluteFilePath());
-                if (isAcceptableImage(image)) return saveImage(image, album);
-                break;
-            }
-        }
+QImage CoverUtils::readAcceptableImage(QImageReader &reader) {
+    // some formats cannot tell without decoding
+    const QSize size = reader.size();
+    if (!size.isValid()) {
+        const QImage image = reader.read();
+        if (image.isNull() || !isAcceptableSize(image.size())) return QImage();
+        return image;
     }
 
-    return false;
+    if (!isAcceptableSize(size)) return QImage();
+    if (size.width() > maximumSize || size.height() > maximumSize) {
+        qDebug() << "Scaling local cover" << size;
+        return ImageUtils::readScaled(reader, QSize(maximumSize, maximumSize));
+    }
+    return reader.read();
 }
 
-bool CoverUtils::coverFromTags(const QString &filename, Album *album) {
-    const QString suffix = QFileInfo(filename).suffix().toLower();
-    if (suffix == "mp3") {
-        TagLib::MPEG::File f((TagLib::FileName)filename.toUtf8());
-        if (!f.isValid()) return false;
-        return coverFromMPEGTags(f.ID3v2Tag(), album);
-    } else if (suffix == "ogg" || suffix == "oga") {
-        TagLib::Ogg::Vorbis::File f((TagLib::FileName)filename.toUtf8());
-        if (!f.isValid()) return false;
-        return coverFromXiphComment(f.tag(), album);
-    } else if (suffix == "flac") {
-        TagLib::FLAC::File f((TagLib::FileName)filename.toUtf8());
-        bool res = false;
-        if (f.isValid()) res = coverFromMPEGTags(f.ID3v2Tag(), album);
-        if (!res) res = coverFromXiphComment(f.xiphComment(), album);
-        return res;
-    } else if (suffix == "aac" || suffix == "m4a" || suffix == "m4b" || suffix == "m4p" ||
-               suffix == "mp4") {
-        return coverFromMP4(filename, album);
+bool CoverUtils::coverFromFiles(const QStringList &candidates, Album *album) {
+    for (const QString &path : candidates) {
+        // the header rules out most candidates, those are never read whole
+        QImageReader probe(path);
+        if (!probe.canRead()) continue;
+        const QSize size = probe.size();
+        if (size.isValid() && !isAcceptableSize(size)) continue;
+
+        // read whole, the same file is often copied in every disc directory of a box set
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) continue;
+        if (coverFromData(file.readAll(), album)) {
+            qDebug() << "Found local cover" << path;
+            return true;
+        }
     }
     return false;
 }
 
-bool CoverUtils::coverFromMPEGTags(TagLib::ID3v2::Tag *tag, Album *album) {
-    if (!tag) return false;
-
-    TagLib::ID3v2::FrameList list = tag->frameList("APIC");
-    if (list.isEmpty()) return false;
-
-    TagLib::ID3v2::AttachedPictureFrame *frame =
-            static_cast<TagLib::ID3v2::AttachedPictureFrame *>(list.front());
-    if (!frame) return false;
-    const int frameSize = frame->picture().size();
-    if (frameSize <= 0) return false;
-
-    QImage image;
-    image.loadFromData((const uchar *)frame->picture().data(), frame->picture().size());
-    if (!isAcceptableImage(image)) return false;
-
-    return saveImage(image, album);
-}
-
-bool CoverUtils::coverFromXiphComment(TagLib::Ogg::XiphComment *xiphComment, Album *album) {
-    if (!xiphComment) return false;
-
-    const TagLib::StringList &stringList = xiphComment->fieldListMap()["COVERART"];
-    if (stringList.isEmpty()) return false;
-    TagLib::ByteVector byteVector = stringList.front().data(TagLib::String::Latin1);
-
-    QByteArray encodedData;
-    encodedData.setRawData(byteVector.data(), byteVector.size());
-
-    QByteArray data = QByteArray::fromBase64(encodedData);
-
-    QImage image;
-    image.loadFromData(data);
-    if (!isAcceptableImage(image)) return false;
-
-    qDebug() << "Cover from Xiph!";
-
-    return saveImage(image, album);
+bool CoverUtils::coverFromTags(const QString &filename, Album *album) {
+    Tags *tags = TagUtils::load(filename, TagUtils::CoverField);
+    if (!tags) return false;
+    const bool res = coverFromData(tags->getCoverData(), album);
+    delete tags;
+    return res;
 }
 
-bool CoverUtils::coverFromMP4(const QString &filename, Album *album) {
-    TagLib::MP4::File f((TagLib::FileName)filename.toUtf8());
-    if (!f.isValid()) return false;
-
-    TagLib::MP4::Tag *tag = static_cast<TagLib::MP4::Tag *>(f.tag());
-    if (!tag) return false;
+bool CoverUtils::coverFromData(const QByteArray &data, Album *album) {
+    if (data.isEmpty()) return false;
 
-    TagLib::MP4::ItemListMap itemsListMap = tag->itemListMap();
-    TagLib::MP4::Item coverItem = itemsListMap["covr"];
-    TagLib::MP4::CoverArtList coverArtList = coverItem.toCoverArtList();
-    TagLib::MP4::CoverArt coverArt = coverArtList.front();
+    // identical pictures are decoded, scaled and encoded only the first time
+    const QString source = ArtworkStore::digest(data);
+    if (ArtworkStore::setArtworkFromSource(source, ArtworkStore::AlbumOwner, album->getHash()))
+        return true;
 
-    QImage image;
-    image.loadFromData((const uchar *)coverArt.data().data(), coverArt.data().size());
-    if (!isAcceptableImage(image)) return false;
-
-    qDebug() << "Cover from MP4!";
+    QBuffer buffer;
+    buffer.setData(data);
+    QImageReader reader(&buffer);
+    const QImage image = readAcceptableImage(reader);
+    if (image.isNull()) return false;
 
-    return saveImage(image, album);
+    if (!saveImage(image, album)) return false;
+    ArtworkStore::addSource(source, ArtworkStore::AlbumOwner, album->getHash());
+    return true;
 }
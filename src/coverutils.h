@@ -23,32 +23,27 @@ $END_LICENSE */
 
 #include <QtWidgets>
 
-// TagLib
-#include <id3v2tag.h>
-#include <mpegfile.h>
-#include <attachedpictureframe.h>
-#include <oggfile.h>
-#include <vorbisfile.h>
-#include <flacfile.h>
-#include <oggflacfile.h>
-#include <mp4file.h>
-
 class Album;
 
 class CoverUtils {
 
 public:
-    static bool coverFromFile(const QString& dir, Album *album);
+    // Cover, front or folder images, by filename
+    static const QRegularExpression &coverFilePattern();
+    // The first acceptable image of the candidates, as listed by the scanner.
+    // Only a candidate whose header passes the size checks is read and hashed.
+    static bool coverFromFiles(const QStringList &candidates, Album *album);
     static bool coverFromTags(const QString& filename, Album *album);
+    // Encoded picture bytes as extracted by TagUtils::load()
+    static bool coverFromData(const QByteArray &data, Album *album);
 
 private:
     CoverUtils() {}
-    static bool isAcceptableImage(const QImage &image);
+    static bool isAcceptableSize(const QSize &size);
+    // Checks the dimensions in the image header, then decodes at the stored size
+    static QImage readAcceptableImage(QImageReader &reader);
     static QImage maybeScaleImage(const QImage &image);
     static bool saveImage(const QImage &image, Album *album);
-    static bool coverFromMPEGTags(TagLib::ID3v2::Tag *tag, Album *album);
-    static bool coverFromXiphComment(TagLib::Ogg::XiphComment *xiphComment, Album *album);
-    static bool coverFromMP4(const QString& filename, Album *album);
 
 };
 
@@ -44,7 +44,11 @@ Database::Database() {
 }
 
 Database::~Database() {
-    closeConnections();
+    // at exit, the threads that still hold a connection are not running anymore
+    QMutexLocker locker(&connectionsLock);
+    for (Connection *connection : qAsConst(connections))
+        destroyConnection(connection);
+    connections.clear();
 }
 
 const QString &Database::getDataLocation() {
@@ -105,16 +109,56 @@ void Database::create() {
               "artist integer,"
               "albumArtist integer,"
               "album integer,"
-              "tstamp integer)",
+              "tstamp integer,"
+              // the file, to recognize it after a move
+              "device integer,"
+              "inode integer,"
+              "size integer,"
+              // msecs, with size they tell incremental scans which files changed
+              "mtime integer,"
+              "ctime integer,"
+              // IntegrityChecker: XXH64 of the file, when it was computed,
+              // 1 if a later pass read different content from an unmodified file
+              "contentHash integer,"
+              "hashed integer,"
+              "contentChanged integer)",
               db);
     QSqlQuery("create unique index unique_tracks_path on tracks(path)", db);
+    QSqlQuery("create index tracks_inode on tracks(inode)", db);
+    QSqlQuery("create index tracks_hashed on tracks(hashed)", db);
+    QSqlQuery("create index tracks_contenthash on tracks(contentHash)", db);
+
+    // tracks whose duration is an estimate, DurationUpdater measures them later
+    QSqlQuery("create table pendingDurations (track integer primary key)", db);
 
     QSqlQuery("create table nontracks ("
               "path varchar(255),"
-              "tstamp integer)",
+              "tstamp integer,"
+              "size integer,"
+              "mtime integer,"
+              "ctime integer)",
               db);
     QSqlQuery("create unique index unique_nontracks_path on nontracks(path)", db);
 
+    // ArtworkStore, these tables survive clear()
+    // rungs: bit mask of the renditions written, null until ArtworkNormalizer gets to it
+    QSqlQuery("create table artwork ("
+              "digest varchar(40) primary key,"
+              "size integer,"
+              "rungs integer)",
+              db);
+    QSqlQuery("create table artworkRefs ("
+              "type integer,"
+              "hash varchar(255),"
+              "digest varchar(40),"
+              "primary key (type, hash))",
+              db);
+    QSqlQuery("create index artwork_refs_digest on artworkRefs(digest)", db);
+    QSqlQuery("create table artworkSources ("
+              "source varchar(40) primary key,"
+              "digest varchar(40))",
+              db);
+
     QSqlQuery("create table downloads ("
               "id integer primary key autoincrement,"
               "objectid integer,"
@@ -138,6 +182,31 @@ void Database::create() {
               db);
     QSqlQuery("create unique index unique_genre_mapping on genreTracks(genre, track)", db);
 
+    // meta-genre tree, rebuilt at the end of every scan
+    QSqlQuery("create table genreTree ("
+              "genre integer primary key,"
+              "parent integer,"
+              "depth integer,"
+              "position integer,"
+              "totalTrackCount integer)",
+              db);
+    QSqlQuery("create index genre_tree_order on genreTree(depth, parent, position)", db);
+
+    // artwork candidates for the Genres view tiles, rebuilt at the end of every scan
+    QSqlQuery("create table genreArtists ("
+              "genre integer,"
+              "artist integer,"
+              "position integer)",
+              db);
+    QSqlQuery("create index genre_artists_order on genreArtists(genre, position)", db);
+
+    QSqlQuery("create table decadeAlbums ("
+              "decade integer,"
+              "album integer,"
+              "position integer)",
+              db);
+    QSqlQuery("create index decade_albums_order on decadeAlbums(decade, position)", db);
+
     /* TODO tags
     QSqlQuery("create table tags ("
               "id integer primary key autoincrement,"
@@ -180,32 +249,98 @@ Database &Database::instance() {
 }
 
 QSqlDatabase Database::getConnection() {
+    Connection *connection = connectionForCurrentThread();
+    if (!connection) return QSqlDatabase();
+    return connection->db;
+}
+
+Database::Connection *Database::connectionForCurrentThread() {
     QThread *currentThread = QThread::currentThread();
     if (!currentThread) {
         qDebug() << "current thread is null";
-        return QSqlDatabase();
+        return nullptr;
     }
 
-    const QString threadName = currentThread->objectName();
-    // qDebug() << "threadName" << threadName << currentThread;
-
-    static QMutex mutex;
-    QMutexLocker locker(&mutex);
+    QMutexLocker locker(&connectionsLock);
 
     auto i = connections.constFind(currentThread);
     if (i != connections.constEnd()) return i.value();
 
-    qDebug() << "Creating db connection for" << threadName;
-    QSqlDatabase connection = QSqlDatabase::addDatabase("QSQLITE", threadName);
-    connection.setDatabaseName(getDbLocation());
-    if (!connection.open()) {
+    const QString threadName = currentThread->objectName();
+
+    // Thread names are not unique and would leak a named QSqlDatabase per thread,
+    // connections get their own names and are removed when released
+    Connection *connection = new Connection();
+    connection->name = QLatin1String("connection") + QString::number(++connectionCounter);
+    qDebug() << "Creating db connection" << connection->name << "for" << threadName;
+    connection->db = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+    connection->db.setDatabaseName(getDbLocation());
+    if (!connection->db.open()) {
         qWarning() << QString("Cannot connect to database %1 in thread %2")
-                              .arg(connection.databaseName(), threadName);
+                              .arg(connection->db.databaseName(), threadName);
+    }
+
+    // A connection can only be used by the thread that created it.
+    // Release it as soon as the thread is done, QThread pointers can be recycled.
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app || currentThread != app->thread()) {
+        connection->threadFinished = connect(
+                currentThread, &QThread::finished, this,
+                [this, currentThread] { releaseConnection(currentThread); },
+                Qt::DirectConnection);
     }
+
     connections.insert(currentThread, connection);
     return connection;
 }
 
+QSqlQuery Database::cachedQuery(const QString &sql) {
+    Connection *connection = connectionForCurrentThread();
+    if (!connection) return QSqlQuery();
+
+    auto i = connection->statements.find(sql);
+    const bool cached = i != connection->statements.end();
+    // positioned on a row: an outer loop may still be reading it, finish() would end it.
+    // Callers that stop early without finish() land here too, they just lose the cache.
+    if (cached && !(i.value().isActive() && i.value().at() >= 0)) {
+        connection->hits++;
+        statementHits.fetchAndAddRelaxed(1);
+        i.value().finish();
+        return i.value();
+    }
+
+    connection->misses++;
+    statementMisses.fetchAndAddRelaxed(1);
+    QSqlQuery query(connection->db);
+    query.setForwardOnly(true);
+    if (!query.prepare(sql)) qWarning() << sql << query.lastError().text();
+    if (!cached) connection->statements.insert(sql, query);
+    return query;
+}
+
+void Database::releaseConnection(QThread *thread) {
+    Connection *connection = nullptr;
+    {
+        QMutexLocker locker(&connectionsLock);
+        connection = connections.take(thread);
+    }
+    if (connection) destroyConnection(connection);
+}
+
+void Database::destroyConnection(Connection *connection) {
+    QObject::disconnect(connection->threadFinished);
+    const int total = connection->hits + connection->misses;
+    qDebug() << "Closing connection" << connection->name << "statement cache hit rate"
+             << (total ? connection->hits * 100 / total : 0) << "%" << connection->hits << "/"
+             << total;
+    const QString name = connection->name;
+    // statements must go before their connection
+    connection->statements.clear();
+    connection->db.close();
+    delete connection;
+    QSqlDatabase::removeDatabase(name);
+}
+
 int Database::status() {
     QVariant status = getAttribute("status");
     if (status.isValid())
@@ -235,19 +370,20 @@ void Database::setCollectionRoot(const QString &dir) {
 }
 
 QVariant Database::getAttribute(const QString &name) {
-    QSqlQuery query("select value from attributes where name=?", getConnection());
+    QSqlQuery query = cachedQuery("select value from attributes where name=?");
     query.bindValue(0, name);
 
     bool success = query.exec();
     if (!success)
         qDebug() << query.lastQuery() << query.boundValues().values() << query.lastError().text();
-    if (query.next()) return query.value(0);
-    return QVariant();
+    QVariant value;
+    if (query.next()) value = query.value(0);
+    query.finish();
+    return value;
 }
 
 void Database::setAttribute(const QString &name, const QVariant &value) {
-    QSqlQuery query(getConnection());
-    query.prepare("update attributes set value=? where name=?");
+    QSqlQuery query = cachedQuery("update attributes set value=? where name=?");
     query.bindValue(0, value);
     query.bindValue(1, name);
     bool success = query.exec();
@@ -286,7 +422,7 @@ void Database::drop() {
         query.exec("vacuum");
     }
 
-    closeConnections();
+    closeConnection();
 }
 
 void Database::clear() {
@@ -299,6 +435,8 @@ void Database::clear() {
     while (query.next()) {
         QString tableName = query.value(0).toString();
         if (tableName.startsWith("sqlite_")) continue;
+        // artwork is kept across full scans, ArtworkStore::collectGarbage() prunes it
+        if (tableName.startsWith(QLatin1String("artwork"))) continue;
         QString dropSQL = "delete from " + tableName;
         QSqlQuery query2(db);
         if (!query2.exec(dropSQL)) {
@@ -311,20 +449,8 @@ void Database::clear() {
     createAttributes();
 }
 
-void Database::closeConnections() {
-    for (QSqlDatabase connection : qAsConst(connections)) {
-        qDebug() << "Closing connection" << connection;
-        connection.close();
-    }
-    connections.clear();
-}
-
 void Database::closeConnection() {
-    QThread *currentThread = QThread::currentThread();
-    if (!connections.contains(currentThread)) return;
-    QSqlDatabase connection = connections.take(currentThread);
-    qDebug() << "Closing connection" << connection;
-    connection.close();
+    releaseConnection(QThread::currentThread());
 }
 
 bool Database::removeRecursively(const QString &dirName) {
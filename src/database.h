@@ -35,6 +35,13 @@ class Database : public QObject {
 
 public:
     static Database& instance();
+    /**
+     * The calling thread's connection, opened on first use. This is per-thread caching, not a
+     * pool: Qt lets a connection be used only by the thread that opened it, so connections
+     * are never handed to another thread. Long-lived threads keep theirs, and threads that
+     * touch the database should be long-lived too: each new thread opens a new connection
+     * and prepares its statements again.
+     */
     QSqlDatabase getConnection();
     ~Database();
     void create();
@@ -46,23 +53,51 @@ public:
     void setLastUpdate(uint date);
     QString collectionRoot();
     void setCollectionRoot(const QString& dir);
-    void closeConnections();
+    // Releases the calling thread's connection, other threads release theirs when they finish
     void closeConnection();
     const QString &needsUpdate() { return updateRoot; }
 
+    /**
+     * Returns a prepared statement for sql, taken from the cache of the calling thread's
+     * connection. Statements are prepared on first use and reused afterwards.
+     * Callers must bind every placeholder and call finish() when they don't consume
+     * all the rows of a select, so that SQLite can release its locks.
+     * A select that is still being iterated is never reset: the same sql nested in its own
+     * loop gets a fresh, uncached statement.
+     */
+    QSqlQuery cachedQuery(const QString &sql);
+    qint64 statementCacheHits() const { return statementHits.loadAcquire(); }
+    qint64 statementCacheMisses() const { return statementMisses.loadAcquire(); }
+
     static const QString &getDataLocation();
     static const QString &getFilesLocation();
     static const QString &getDbLocation();
 
 private:
+    struct Connection {
+        QSqlDatabase db;
+        QString name;
+        QHash<QString, QSqlQuery> statements;
+        QMetaObject::Connection threadFinished;
+        int hits = 0;
+        int misses = 0;
+    };
+
     Database();
+    Connection *connectionForCurrentThread();
+    void releaseConnection(QThread *thread);
+    static void destroyConnection(Connection *connection);
     void createAttributes();
     QVariant getAttribute(const QString& name);
     void setAttribute(const QString& name, const QVariant& value);
     bool removeRecursively(const QString & dirName);
 
     QMutex lock;
-    QHash<QThread*, QSqlDatabase> connections;
+    QMutex connectionsLock;
+    QHash<QThread *, Connection *> connections;
+    int connectionCounter = 0;
+    QAtomicInteger<qint64> statementHits;
+    QAtomicInteger<qint64> statementMisses;
     QString updateRoot;
 };
 
@@ -20,6 +20,92 @@ $END_LICENSE */
 
 #include "datautils.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+thread_local bool normalizeTagCacheEnabled = false;
+thread_local QHash<QString, QString> normalizeTagCache;
+// artists and albums of a big collection, with room to spare
+const int normalizeTagCacheMaxSize = 1 << 16;
+
+/**
+ * Copies tag to out as Latin-1 if it is pure ASCII, out must hold tag.length() bytes.
+ */
+bool toAscii(const QString &tag, char *out) {
+    const ushort *chars = tag.utf16();
+    const int length = tag.length();
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i nonAscii = _mm_set1_epi16(short(0xff80));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(chars + i));
+        const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(v, nonAscii), zero);
+        if (_mm_movemask_epi8(ascii) != 0xffff) return false;
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(v, v));
+    }
+#endif
+    for (; i < length; ++i) {
+        if (chars[i] >= 0x80) return false;
+        out[i] = char(chars[i]);
+    }
+    return true;
+}
+
+bool isAsciiSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Same as the generic normalizeTag() code path, in a single pass over ASCII input.
+ */
+QString normalizeAsciiTag(const char *s, int length) {
+    // lower case letters and digits, zero for everything else
+    static const QVector<char> alnum = [] {
+        QVector<char> table(128, 0);
+        for (int c = '0'; c <= '9'; ++c)
+            table[c] = char(c);
+        for (int c = 'a'; c <= 'z'; ++c)
+            table[c] = char(c);
+        for (int c = 'A'; c <= 'Z'; ++c)
+            table[c] = char(c - 'A' + 'a');
+        return table;
+    }();
+
+    int begin = 0;
+    int end = length;
+    while (begin < end && isAsciiSpace(s[begin]))
+        ++begin;
+    while (end > begin && isAsciiSpace(s[end - 1]))
+        --end;
+
+    // The Beatles => Beatles
+    if (end - begin > 4 && qstrnicmp(s + begin, "the ", 4) == 0) begin += 4;
+
+    // "and" replacements can make the result longer than the input
+    QVarLengthArray<char, 256> n;
+    n.reserve((end - begin) * 3);
+    for (int i = begin; i < end; ++i) {
+        const char c = s[i];
+        if (const char l = alnum.at(c)) {
+            n.append(l);
+        } else if (c == '&') {
+            // Wendy & Lisa => Wendy and Lisa
+            n.append("and", 3);
+        } else if (c == '\'' && i + 2 < end && (s[i + 1] | 0x20) == 'n' && s[i + 2] == '\'') {
+            // Rock'n'roll => Rock and Roll
+            n.append("and", 3);
+            i += 2;
+        }
+    }
+    return QString::fromLatin1(n.constData(), n.size());
+}
+
+} // namespace
+
 DataUtils::DataUtils() {}
 
 QString DataUtils::cleanTag(QString s) {
@@ -27,7 +113,33 @@ QString DataUtils::cleanTag(QString s) {
     return s.simplified();
 }
 
+void DataUtils::setNormalizeTagCacheEnabled(bool enabled) {
+    normalizeTagCacheEnabled = enabled;
+    if (!enabled) normalizeTagCache = QHash<QString, QString>();
+}
+
 QString DataUtils::normalizeTag(const QString &tag) {
+    if (normalizeTagCacheEnabled) {
+        const auto i = normalizeTagCache.constFind(tag);
+        if (i != normalizeTagCache.constEnd()) return i.value();
+    }
+
+    QString n;
+    QVarLengthArray<char, 256> ascii(tag.length());
+    if (toAscii(tag, ascii.data())) {
+        n = normalizeAsciiTag(ascii.constData(), ascii.size());
+    } else {
+        n = normalizeUnicodeTag(tag);
+    }
+
+    if (normalizeTagCacheEnabled) {
+        if (normalizeTagCache.size() >= normalizeTagCacheMaxSize) normalizeTagCache.clear();
+        normalizeTagCache.insert(tag, n);
+    }
+    return n;
+}
+
+QString DataUtils::normalizeUnicodeTag(const QString &tag) {
     QString s = tag.trimmed().toLower();
 
     // The Beatles => Beatles
@@ -64,6 +176,43 @@ QString DataUtils::simplify(const QString &s) {
     return s2;
 }
 
+QChar DataUtils::foldAccent(QChar c) {
+    // Base letters for the Latin blocks, where nearly all accented letters in tags come from
+    static const int tableSize = 0x250;
+    static const QVector<ushort> table = [] {
+        QVector<ushort> t(tableSize);
+        for (int i = 0; i < tableSize; ++i) {
+            t[i] = ushort(i);
+            const QChar c(i);
+            if (c.decompositionTag() != QChar::Canonical) continue;
+            // ǖ => ü + macron, ü was folded already
+            const ushort base = c.decomposition().at(0).unicode();
+            if (base < i) t[i] = t[base];
+        }
+        // letters with a stroke and the like, they have no canonical decomposition
+        const char *extras[] = {"dđĐ", "hħĦ", "iı", "kĸ", "lŀĿłŁ", "nŉŋŊ", "oøØ", "sſ", "tŧŦ"};
+        for (const char *extra : extras) {
+            const QString letters = QString::fromUtf8(extra);
+            for (int i = 1; i < letters.length(); ++i) {
+                const QChar letter = letters.at(i);
+                t[letter.unicode()] = letter.isUpper() ? letters.at(0).toUpper().unicode()
+                                                       : letters.at(0).unicode();
+            }
+        }
+        return t;
+    }();
+
+    const ushort u = c.unicode();
+    return u < tableSize ? QChar(table.at(u)) : c;
+}
+
+QString DataUtils::foldAccents(const QString &s) {
+    QString folded = s;
+    for (QChar &c : folded)
+        c = foldAccent(c);
+    return folded;
+}
+
 QString DataUtils::md5(const QString &name) {
     return QString::fromLatin1(
             QCryptographicHash::hash(name.toUtf8(), QCryptographicHash::Md5).toHex());
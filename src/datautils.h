@@ -27,7 +27,12 @@ class DataUtils {
 public:
     static QString cleanTag(QString tag);
     static QString normalizeTag(const QString &tag);
+    // Memoizes normalizeTag() in the calling thread, disabling also empties the cache
+    static void setNormalizeTagCacheEnabled(bool enabled);
     static QString simplify(const QString &s);
+    // èé => e etc. Not used by normalizeTag(), its keys are stored in the database
+    static QChar foldAccent(QChar c);
+    static QString foldAccents(const QString &s);
     static QString md5(const QString &);
     static QString getXMLElementText(const QByteArray &bytes, const QString &element);
     static QString
@@ -37,6 +42,7 @@ public:
 
 private:
     DataUtils();
+    static QString normalizeUnicodeTag(const QString &tag);
 };
 
 #endif // DATAUTILS_H
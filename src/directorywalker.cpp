@@ -0,0 +1,446 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "directorywalker.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Files per found() signal
+const int batchSize = 128;
+
+QString childPath(const QString &directory, const QString &name) {
+    if (directory.endsWith('/')) return directory + name;
+    return directory + '/' + name;
+}
+
+QByteArray directoryIdentity(quint64 device, quint64 inode) {
+    return QByteArray::number(device, 16) + ':' + QByteArray::number(inode, 16);
+}
+
+// One directory: its identity and what it lists, sorted as getdents order is arbitrary.
+// Subdirectories are listed by name only, their content goes in their own digest.
+QByteArray directoryDigest(const QByteArray &identity, const DirectoryWalker::Entries &entries,
+                           int from, const QStringList &subdirectories) {
+    QVector<QByteArray> lines;
+    lines.reserve(entries.size() - from + subdirectories.size());
+    for (int i = from; i < entries.size(); ++i) {
+        const DirectoryWalker::Entry &entry = entries.at(i);
+        const QString name = entry.path.mid(entry.path.lastIndexOf('/') + 1);
+        lines << name.toUtf8() + '\t' + QByteArray::number(entry.size, 16) + '\t' +
+                         QByteArray::number(entry.lastModified, 16) + '\t' +
+                         QByteArray::number(entry.lastChanged, 16);
+    }
+    for (const QString &subdirectory : subdirectories)
+        lines << subdirectory.mid(subdirectory.lastIndexOf('/') + 1).toUtf8() + '/';
+    std::sort(lines.begin(), lines.end());
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(identity);
+    for (const QByteArray &line : qAsConst(lines)) {
+        hash.addData("\n", 1);
+        hash.addData(line);
+    }
+    return hash.result();
+}
+
+#ifdef Q_OS_LINUX
+
+// The kernel record, glibc does not always declare it
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[256];
+};
+
+struct FileStat {
+    mode_t mode;
+    qint64 size;
+    qint64 lastModified;
+    qint64 lastChanged;
+    quint64 device;
+    quint64 inode;
+};
+
+// Follows symlinks, like QFileInfo
+bool statAt(int directoryFd, const char *name, FileStat *fileStat) {
+#ifdef STATX_BASIC_STATS
+    struct statx st;
+    const unsigned int mask = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_CTIME | STATX_INO;
+    if (statx(directoryFd, name, 0, mask, &st) != 0) return false;
+    fileStat->mode = st.stx_mode;
+    fileStat->size = st.stx_size;
+    fileStat->lastModified = qint64(st.stx_mtime.tv_sec) * 1000 + st.stx_mtime.tv_nsec / 1000000;
+    fileStat->lastChanged = qint64(st.stx_ctime.tv_sec) * 1000 + st.stx_ctime.tv_nsec / 1000000;
+    fileStat->device = makedev(st.stx_dev_major, st.stx_dev_minor);
+    fileStat->inode = st.stx_ino;
+#else
+    struct stat st;
+    if (fstatat(directoryFd, name, &st, 0) != 0) return false;
+    fileStat->mode = st.st_mode;
+    fileStat->size = st.st_size;
+    fileStat->lastModified = qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+    fileStat->lastChanged = qint64(st.st_ctim.tv_sec) * 1000 + st.st_ctim.tv_nsec / 1000000;
+    fileStat->device = st.st_dev;
+    fileStat->inode = st.st_ino;
+#endif
+    return true;
+}
+
+#endif
+
+} // namespace
+
+class DirectoryWalker::Worker : public QThread {
+public:
+    Worker(DirectoryWalker *walker) : walker(walker) {}
+
+protected:
+    void run() override { walker->work(); }
+
+private:
+    DirectoryWalker *walker;
+};
+
+DirectoryWalker::DirectoryWalker(QObject *parent)
+    : QObject(parent), threadCount(qBound(2, QThread::idealThreadCount(), 4)),
+      skipDuplicateFiles(false), busyWorkers(0), collecting(false),
+      fingerprinting(false) {
+    qRegisterMetaType<DirectoryWalker::Entries>();
+}
+
+DirectoryWalker::~DirectoryWalker() {
+    stop();
+}
+
+void DirectoryWalker::setSkippedDirectories(const QStringList &paths) {
+    skippedDirectories.clear();
+    for (const QString &path : paths)
+        skippedDirectories.insert(path);
+}
+
+void DirectoryWalker::setSkippedSuffixes(const QStringList &suffixes) {
+    skippedSuffixes.clear();
+    for (const QString &suffix : suffixes)
+        skippedSuffixes.insert(QFile::encodeName(suffix.toLower()));
+}
+
+void DirectoryWalker::start(const QString &root) {
+    stop();
+    pendingDirectories.clear();
+    pendingDirectories.push(root);
+    visitedDirectories.clear();
+    visitedCanonicalPaths.clear();
+    visitedFiles.clear();
+    duplicateDirectories = 0;
+    duplicateFiles = 0;
+    busyWorkers = 0;
+    cancelled = 0;
+    runningWorkers = threadCount;
+    for (int i = 0; i < threadCount; ++i) {
+        Worker *worker = new Worker(this);
+        workers << worker;
+        worker->start();
+    }
+}
+
+void DirectoryWalker::stop() {
+    if (workers.isEmpty()) return;
+    {
+        QMutexLocker locker(&mutex);
+        cancelled = 1;
+        directoriesAvailable.wakeAll();
+    }
+    wait();
+}
+
+bool DirectoryWalker::isRunning() const {
+    return runningWorkers.loadAcquire() > 0;
+}
+
+DirectoryWalker::Entries DirectoryWalker::walk(const QString &root) {
+    collecting = true;
+    start(root);
+    wait();
+    collecting = false;
+    Entries entries;
+    entries.swap(collected);
+    return entries;
+}
+
+QByteArray DirectoryWalker::fingerprint(const QString &root) {
+    directoryDigests.clear();
+    fingerprinting = true;
+    walk(root);
+    fingerprinting = false;
+    // the walk order depends on thread timing
+    std::sort(directoryDigests.begin(), directoryDigests.end());
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    for (const QByteArray &digest : qAsConst(directoryDigests))
+        hash.addData(digest);
+    directoryDigests.clear();
+    return hash.result();
+}
+
+void DirectoryWalker::wait() {
+    for (Worker *worker : qAsConst(workers)) {
+        worker->wait();
+        delete worker;
+    }
+    workers.clear();
+}
+
+void DirectoryWalker::work() {
+    Entries entries;
+    QStringList subdirectories;
+    forever {
+        QString path;
+        {
+            QMutexLocker locker(&mutex);
+            while (pendingDirectories.isEmpty() && busyWorkers > 0 && !cancelled)
+                directoriesAvailable.wait(&mutex);
+            // no pending directories and nobody can find more: we're done
+            if (cancelled || pendingDirectories.isEmpty()) break;
+            path = pendingDirectories.pop();
+            ++busyWorkers;
+        }
+
+        const int firstEntry = entries.size();
+        QByteArray identity;
+        readDirectory(path, subdirectories, entries, identity);
+
+        QByteArray digest;
+        if (fingerprinting) {
+            if (!identity.isEmpty())
+                digest = directoryDigest(identity, entries, firstEntry, subdirectories);
+            entries.resize(firstEntry);
+        }
+
+        {
+            QMutexLocker locker(&mutex);
+            --busyWorkers;
+            if (!digest.isEmpty()) directoryDigests << digest;
+            if (skipDuplicateFiles) removeDuplicateFiles(entries, firstEntry);
+            for (const QString &subdirectory : qAsConst(subdirectories))
+                pendingDirectories.push(subdirectory);
+            if (!subdirectories.isEmpty() || busyWorkers == 0) directoriesAvailable.wakeAll();
+        }
+        subdirectories.clear();
+
+        if (entries.size() >= batchSize) flush(entries);
+    }
+
+    if (!cancelled) flush(entries);
+    if (runningWorkers.fetchAndAddOrdered(-1) == 1 && !cancelled && !collecting) emit finished();
+}
+
+void DirectoryWalker::flush(Entries &entries) {
+    if (entries.isEmpty()) return;
+    if (collecting) {
+        QMutexLocker locker(&mutex);
+        collected += entries;
+    } else {
+        emit found(entries);
+    }
+    entries.clear();
+}
+
+bool DirectoryWalker::enterDirectory(quint64 device, quint64 inode) {
+    QMutexLocker locker(&mutex);
+    const QPair<quint64, quint64> key(device, inode);
+    if (visitedDirectories.contains(key)) {
+        duplicateDirectories.fetchAndAddRelaxed(1);
+        return false;
+    }
+    visitedDirectories.insert(key);
+    return true;
+}
+
+bool DirectoryWalker::enterDirectory(const QString &canonicalPath) {
+    QMutexLocker locker(&mutex);
+    if (visitedCanonicalPaths.contains(canonicalPath)) {
+        duplicateDirectories.fetchAndAddRelaxed(1);
+        return false;
+    }
+    visitedCanonicalPaths.insert(canonicalPath);
+    return true;
+}
+
+void DirectoryWalker::removeDuplicateFiles(Entries &entries, int from) {
+    int kept = from;
+    for (int i = from; i < entries.size(); ++i) {
+        const Entry entry = entries.at(i);
+        // images are not stat'ed and have no inode, neither do files on some platforms
+        if (entry.inode) {
+            const int visited = visitedFiles.size();
+            visitedFiles.insert(qMakePair(entry.device, entry.inode));
+            if (visitedFiles.size() == visited) {
+                duplicateFiles.fetchAndAddRelaxed(1);
+                continue;
+            }
+        }
+        if (i != kept) entries[kept] = entry;
+        ++kept;
+    }
+    entries.resize(kept);
+}
+
+bool DirectoryWalker::isSkippedSuffix(const char *name) const {
+    if (skippedSuffixes.isEmpty()) return false;
+    const char *dot = strrchr(name, '.');
+    if (!dot) return false;
+    QByteArray suffix(dot + 1);
+    for (char &c : suffix) {
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    return skippedSuffixes.contains(suffix);
+}
+
+void DirectoryWalker::maybeAddImage(const QString &directory, const QString &name,
+                                    Entries &entries) const {
+    if (imagePattern.pattern().isEmpty() || !imagePattern.match(name).hasMatch()) return;
+    entries.append({childPath(directory, name), 0, 0, 0, true, 0, 0});
+}
+
+#ifdef Q_OS_LINUX
+
+void DirectoryWalker::readDirectory(const QString &path, QStringList &subdirectories,
+                                    Entries &entries, QByteArray &identity) {
+    const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat directoryStat;
+    if (fstat(fd, &directoryStat) != 0 ||
+        !enterDirectory(directoryStat.st_dev, directoryStat.st_ino)) {
+        close(fd);
+        return;
+    }
+    identity = directoryIdentity(directoryStat.st_dev, directoryStat.st_ino);
+
+    char buffer[32 * 1024];
+    forever {
+        const long size = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (size <= 0) break;
+        for (long offset = 0; offset < size;) {
+            const auto *dirent = reinterpret_cast<const LinuxDirent64 *>(buffer + offset);
+            offset += dirent->d_reclen;
+            const char *name = dirent->d_name;
+
+            // hidden files, "." and ".."
+            if (name[0] == '.') continue;
+
+            bool isDir = dirent->d_type == DT_DIR;
+            if (dirent->d_type == DT_REG && isSkippedSuffix(name)) {
+                maybeAddImage(path, QFile::decodeName(name), entries);
+                continue;
+            }
+
+            // the type is known without a stat for most entries,
+            // directories are never stat'ed but symlinks and unknown types have to
+            FileStat fileStat;
+            if (!isDir) {
+                if (dirent->d_type != DT_REG && dirent->d_type != DT_LNK &&
+                    dirent->d_type != DT_UNKNOWN)
+                    continue;
+                if (!statAt(fd, name, &fileStat)) continue;
+                isDir = S_ISDIR(fileStat.mode);
+                if (!isDir && !S_ISREG(fileStat.mode)) continue;
+            }
+
+            const QString entryPath = childPath(path, QFile::decodeName(name));
+            if (isDir) {
+                if (skippedDirectories.contains(entryPath)) {
+                    qDebug() << "Skipping directory" << entryPath;
+                    continue;
+                }
+                subdirectories << entryPath;
+            } else if (dirent->d_type != DT_REG && isSkippedSuffix(name)) {
+                maybeAddImage(path, QFile::decodeName(name), entries);
+            } else {
+                entries.append({entryPath, fileStat.size, fileStat.lastModified,
+                                fileStat.lastChanged, false, fileStat.device, fileStat.inode});
+            }
+        }
+    }
+    close(fd);
+}
+
+#else
+
+void DirectoryWalker::readDirectory(const QString &path, QStringList &subdirectories,
+                                    Entries &entries, QByteArray &identity) {
+#ifdef Q_OS_UNIX
+    struct stat directoryStat;
+    if (stat(QFile::encodeName(path).constData(), &directoryStat) != 0 ||
+        !enterDirectory(directoryStat.st_dev, directoryStat.st_ino))
+        return;
+    identity = directoryIdentity(directoryStat.st_dev, directoryStat.st_ino);
+#else
+    const QString canonicalPath = QFileInfo(path).canonicalFilePath();
+    if (!enterDirectory(canonicalPath)) return;
+    identity = canonicalPath.toUtf8();
+#endif
+    const QDir directory(path);
+    const QFileInfoList list =
+            directory.entryInfoList(QDir::NoDotAndDotDot | QDir::Dirs | QDir::Files |
+                                    QDir::Readable);
+    for (const QFileInfo &fileInfo : list) {
+        if (fileInfo.isDir()) {
+            const QString subdirectory = fileInfo.absoluteFilePath();
+            if (skippedDirectories.contains(subdirectory)) {
+                qDebug() << "Skipping directory" << subdirectory;
+                continue;
+            }
+            subdirectories << subdirectory;
+        } else if (isSkippedSuffix(QFile::encodeName(fileInfo.fileName()).constData())) {
+            maybeAddImage(path, fileInfo.fileName(), entries);
+        } else {
+            const qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+            Entry entry = {fileInfo.absoluteFilePath(), fileInfo.size(), lastModified,
+                           lastModified, false, 0, 0};
+#ifdef Q_OS_UNIX
+            // QFileInfo keeps the inode to itself, the stat above makes this one cheap
+            struct stat st;
+            if (stat(QFile::encodeName(entry.path).constData(), &st) == 0) {
+                entry.lastChanged = qint64(st.st_ctime) * 1000;
+                entry.device = st.st_dev;
+                entry.inode = st.st_ino;
+            }
+#endif
+            entries.append(entry);
+        }
+    }
+}
+
+#endif
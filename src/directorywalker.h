@@ -0,0 +1,131 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QtCore>
+
+/**
+ * Lists the files of a directory tree on a few threads, one directory at a time per thread.
+ * Hidden files and directories are skipped, symlinks are followed. Files are reported in
+ * batches while the walk goes on, in no particular order. A directory reached twice,
+ * through a symlink cycle or a bind mount, is read once.
+ *
+ * On Linux directories are read with getdents64 and only files are stat'ed,
+ * relative to their directory descriptor.
+ */
+class DirectoryWalker : public QObject {
+    Q_OBJECT
+
+public:
+    struct Entry {
+        QString path;
+        qint64 size;
+        // msecs since the epoch
+        qint64 lastModified;
+        // status change time, in msecs since the epoch: also moves when a tagger restores mtime
+        qint64 lastChanged;
+        // matched the image pattern, size and lastModified are not set
+        bool isImage;
+        // identify a file across renames, zero where the platform has no inodes
+        quint64 device;
+        quint64 inode;
+    };
+    typedef QVector<Entry> Entries;
+
+    DirectoryWalker(QObject *parent = nullptr);
+    ~DirectoryWalker();
+
+    void setThreadCount(int value) { threadCount = value; }
+    void setSkippedDirectories(const QStringList &paths);
+    // Files with these lowercase extensions are neither stat'ed nor reported
+    void setSkippedSuffixes(const QStringList &suffixes);
+    // Files with a skipped suffix matching this are still reported, as images, without a stat
+    void setImagePattern(const QRegularExpression &value) { imagePattern = value; }
+    // A file reached twice, e.g. hard links, is reported once: the first path found wins
+    void setSkipDuplicateFiles(bool value) { skipDuplicateFiles = value; }
+
+    // What the current or last walk skipped
+    int duplicateDirectoryCount() const { return duplicateDirectories.loadAcquire(); }
+    int duplicateFileCount() const { return duplicateFiles.loadAcquire(); }
+
+    // found() and finished() are emitted from the walker threads
+    void start(const QString &root);
+    // Cancels the walk and waits for the threads, finished() is not emitted
+    void stop();
+    bool isRunning() const;
+
+    // Blocking walk, no signals are emitted
+    Entries walk(const QString &root);
+    // Blocking digest of the names, sizes and times under root. Each directory is hashed once,
+    // keyed by its (device, inode) and not by the path it was reached through, so neither the
+    // walk order nor which alias of a symlinked or bind-mounted directory came first matters.
+    QByteArray fingerprint(const QString &root);
+
+signals:
+    void found(const DirectoryWalker::Entries &entries);
+    void finished();
+
+private:
+    class Worker;
+    void work();
+    // identity is left empty when the directory was skipped or already read
+    void readDirectory(const QString &path, QStringList &subdirectories, Entries &entries,
+                       QByteArray &identity);
+    bool isSkippedSuffix(const char *name) const;
+    void maybeAddImage(const QString &directory, const QString &name, Entries &entries) const;
+    bool enterDirectory(quint64 device, quint64 inode);
+    // Where there are no inodes
+    bool enterDirectory(const QString &canonicalPath);
+    // The caller holds the mutex
+    void removeDuplicateFiles(Entries &entries, int from);
+    void flush(Entries &entries);
+    void wait();
+
+    int threadCount;
+    QSet<QString> skippedDirectories;
+    QSet<QByteArray> skippedSuffixes;
+    QRegularExpression imagePattern;
+    bool skipDuplicateFiles;
+
+    QVector<Worker *> workers;
+    QMutex mutex;
+    QWaitCondition directoriesAvailable;
+    QStack<QString> pendingDirectories;
+    // directories already read, symlinks can make cycles
+    QSet<QPair<quint64, quint64>> visitedDirectories;
+    QSet<QString> visitedCanonicalPaths;
+    QSet<QPair<quint64, quint64>> visitedFiles;
+    QAtomicInt duplicateDirectories;
+    QAtomicInt duplicateFiles;
+    int busyWorkers;
+    QAtomicInt runningWorkers;
+    QAtomicInt cancelled;
+
+    bool collecting;
+    Entries collected;
+    bool fingerprinting;
+    QVector<QByteArray> directoryDigests;
+};
+
+Q_DECLARE_METATYPE(DirectoryWalker::Entries)
+
+#endif // DIRECTORYWALKER_H
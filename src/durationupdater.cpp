@@ -0,0 +1,139 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "durationupdater.h"
+
+#include <QtSql>
+
+#include "database.h"
+#include "tagutils.h"
+
+#include "model/track.h"
+
+namespace {
+
+// Tracks per transaction
+const int batchSize = 32;
+
+struct PendingTrack {
+    int id;
+    QString path;
+    int duration;
+};
+
+} // namespace
+
+DurationUpdater::DurationUpdater(QObject *parent) : QThread(parent) {
+    setObjectName("durations");
+}
+
+DurationUpdater::~DurationUpdater() {
+    stop();
+}
+
+DurationUpdater &DurationUpdater::instance() {
+    static DurationUpdater i;
+    return i;
+}
+
+void DurationUpdater::enqueue(int trackId) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert or ignore into pendingDurations (track) values (?)");
+    query.bindValue(0, trackId);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+}
+
+void DurationUpdater::stop() {
+    if (!isRunning()) return;
+    requestInterruption();
+    wait();
+}
+
+void DurationUpdater::run() {
+    const QString root = Database::instance().collectionRoot() + "/";
+    while (!isInterruptionRequested() && updateBatch(root)) {
+    }
+    Database::instance().closeConnection();
+}
+
+bool DurationUpdater::updateBatch(const QString &root) {
+    QSqlDatabase db = Database::instance().getConnection();
+    QSqlQuery query(db);
+    // tracks removed since then have no path
+    query.prepare("select p.track,t.path,t.duration from pendingDurations p "
+                  "left join tracks t on t.id=p.track limit ?");
+    query.bindValue(0, batchSize);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    QVector<PendingTrack> tracks;
+    while (query.next())
+        tracks.append({query.value(0).toInt(), query.value(1).toString(), query.value(2).toInt()});
+    query.finish();
+    if (tracks.isEmpty()) return false;
+
+    // Files are read outside of the transaction, they're the slow part
+    QVector<PendingTrack> measured;
+    measured.reserve(tracks.size());
+    for (const PendingTrack &track : qAsConst(tracks)) {
+        if (isInterruptionRequested()) break;
+        PendingTrack result = {track.id, QString(), -1};
+        if (!track.path.isEmpty()) {
+            Tags *tags = TagUtils::load(root + track.path,
+                                        TagUtils::DurationField | TagUtils::AccurateDuration);
+            // the frame count was cut short, measure it again next time
+            if (isInterruptionRequested()) {
+                delete tags;
+                break;
+            }
+            // unreadable files keep the estimate
+            if (tags && tags->getDuration() > 0 && tags->getDuration() != track.duration)
+                result.duration = tags->getDuration();
+            delete tags;
+        }
+        measured << result;
+    }
+
+    db.transaction();
+    for (const PendingTrack &track : qAsConst(measured)) {
+        if (track.duration > 0) {
+            QSqlQuery update = Database::instance().cachedQuery(
+                    "update tracks set duration=? where id=?");
+            update.bindValue(0, track.duration);
+            update.bindValue(1, track.id);
+            if (!update.exec()) qWarning() << update.lastQuery() << update.lastError().text();
+        }
+        QSqlQuery remove =
+                Database::instance().cachedQuery("delete from pendingDurations where track=?");
+        remove.bindValue(0, track.id);
+        if (!remove.exec()) qWarning() << remove.lastQuery() << remove.lastError().text();
+    }
+    if (!db.commit()) {
+        qWarning() << "Commit failed!";
+        return false;
+    }
+
+    for (const PendingTrack &track : qAsConst(measured)) {
+        if (track.duration > 0) Track::updateCachedLength(track.id, track.duration);
+    }
+    qDebug() << "Measured" << measured.size() << "durations";
+    return true;
+}
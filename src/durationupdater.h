@@ -0,0 +1,51 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef DURATIONUPDATER_H
+#define DURATIONUPDATER_H
+
+#include <QtCore>
+
+/**
+ * Low priority pass after a scan: measures the tracks whose duration is only an estimate
+ * (see TagUtils::FastDuration) and patches tracks.duration in batches.
+ * The queue is the pendingDurations table, so it survives restarts.
+ */
+class DurationUpdater : public QThread {
+    Q_OBJECT
+
+public:
+    static DurationUpdater &instance();
+    ~DurationUpdater();
+
+    // On the caller's connection, i.e. in the scanner transaction
+    static void enqueue(int trackId);
+    // Interrupts the pass and waits for it, the rest stays queued
+    void stop();
+
+protected:
+    void run();
+
+private:
+    DurationUpdater(QObject *parent = nullptr);
+    bool updateBatch(const QString &root);
+};
+
+#endif // DURATIONUPDATER_H
@@ -10,6 +10,26 @@
 #include "model/genre.h"
 #include "model/item.h"
 
+namespace {
+
+// Calls f(owner, ids) for each owner of a query returning owner,id rows sorted by owner
+template <typename F> void forEachGroup(QSqlQuery &query, F f) {
+    int owner = 0;
+    QVector<int> ids;
+    while (query.next()) {
+        const int rowOwner = query.value(0).toInt();
+        if (rowOwner != owner && !ids.isEmpty()) {
+            f(owner, ids);
+            ids.clear();
+        }
+        owner = rowOwner;
+        ids << query.value(1).toInt();
+    }
+    if (!ids.isEmpty()) f(owner, ids);
+}
+
+} // namespace
+
 Genres::Genres() : QObject() {
     connect(MainWindow::instance(), &MainWindow::collectionCreated, this, &Genres::init);
 }
@@ -19,140 +39,35 @@ void Genres::init() {
     items.clear();
     loadGenres();
     loadDecades();
+    loadArtwork();
     emit initialized();
 }
 
 void Genres::loadGenres() {
-    static const auto genreTree = [] {
-        QVector<QPair<QString, QStringList>> map;
-        QFile f(":/res/genre-tree.csv");
-        if (f.open(QFile::ReadOnly)) {
-            QTextStream stream(&f);
-            QString line;
-            while (!stream.atEnd()) {
-                stream.readLineInto(&line);
-                if (line.isEmpty()) continue;
-                QString badWord;
-                QString goodWord;
-                const auto fields = line.splitRef(',');
-                QString metaGenre;
-                QStringList genres;
-                for (const QStringRef &field : fields) {
-                    if (metaGenre.isNull())
-                        metaGenre = field.toString();
-                    else
-                        genres << field.toString();
-                }
-                map.append(qMakePair(metaGenre, genres));
-            }
-        }
-        return map;
-    }();
-    qDebug() << genreTree;
-
+    // The tree is built by the scanner, parents always come before their children
     QSqlDatabase db = Database::instance().getConnection();
     QSqlQuery query(db);
-    query.prepare("select id from genres where trackCount > 5 "
-                  "order by trackCount desc");
+    query.prepare("select t.genre,t.parent,t.totalTrackCount,g.hash,g.name,g.trackCount "
+                  "from genreTree t join genres g on g.id=t.genre "
+                  "order by t.depth,t.parent,t.position");
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
 
-    QVector<Genre *> metaGenres;
-    metaGenres.reserve(genreTree.size());
-
-    QVector<Genre *> otherGenres;
-    otherGenres.reserve(query.size() / 2);
-
     while (query.next()) {
-        Genre *genre = Genre::forId(query.value(0).toInt());
-        const QString &genreHash = genre->getHash();
-        qDebug() << "Processing" << genreHash;
-
-        Genre *metaGenre = nullptr;
-        bool addAsChild = false;
-
-        for (const auto &pair : genreTree) {
-            const QString &metaGenreHash = pair.first;
-
-            if (genreHash == metaGenreHash) {
-                qDebug() << "It's a meta" << metaGenreHash;
-                metaGenre = Genre::forHash(metaGenreHash);
-                break;
-            }
-
-            if (genreHash.contains(metaGenreHash)) {
-                qDebug() << "It's a word child" << metaGenreHash << genreHash;
-                metaGenre = Genre::forHash(metaGenreHash);
-                addAsChild = true;
-                break;
-            }
-
-            const QStringList &subGenreHashes = pair.second;
-            for (const auto &subGenreHash : subGenreHashes) {
-                if (genreHash.contains(subGenreHash)) {
-                    qDebug() << "Found subgenre" << subGenreHash << metaGenreHash;
-                    metaGenre = Genre::forHash(metaGenreHash);
-                    addAsChild = true;
-
-                    const auto &siblings = metaGenre->getChildren();
-                    bool parentFound = false;
-                    for (Genre *sibling : siblings) {
-                        if (genreHash.contains(sibling->getHash())) {
-                            qDebug() << genreHash << sibling->getHash();
-                            sibling->addChild(genre);
-                            parentFound = true;
-                            break;
-                        }
-                    }
-                    if (!parentFound) metaGenre->addChild(genre);
-
-                    break;
-                }
-            }
-
-            if (metaGenre) break;
-        }
-
-        if (metaGenre) {
-            if (!metaGenres.contains(metaGenre)) metaGenres << metaGenre;
-
-            if (addAsChild) {
-                const auto &siblings = metaGenre->getChildren();
-                bool parentFound = false;
-                for (Genre *sibling : siblings) {
-                    if (genreHash.contains(sibling->getHash())) {
-                        qDebug() << genreHash << sibling->getHash();
-                        sibling->addChild(genre);
-                        parentFound = true;
-                        break;
-                    }
-                }
-                if (!parentFound) metaGenre->addChild(genre);
-            }
-
-        } else if (genre->getTrackCount() > 20) {
-            otherGenres << genre;
+        Genre *genre = Genre::forId(query.value(0).toInt(), query.value(3).toString(),
+                                    query.value(4).toString(), query.value(5).toInt());
+        genre->setTotalTrackCount(query.value(2).toInt());
+        genre->clearChildren();
+
+        const int parentId = query.value(1).toInt();
+        if (parentId == 0) {
+            genre->setParent(nullptr);
+            genre->setRow(items.size());
+            items.append(genre);
+        } else if (Genre *parent = Genre::forId(parentId)) {
+            parent->addChild(genre);
         }
     }
-
-    // remove almost empty metagenres
-    for (auto i = metaGenres.begin(); i != metaGenres.end(); /* NOTHING */) {
-        Genre *g = *i;
-        qDebug() << g->getName() << g->getTotalTrackCount();
-        if (g->getTotalTrackCount() <= 30) {
-            qDebug() << "Dropping" << g->getName();
-            metaGenres.removeOne(g);
-        } else
-            ++i;
-    }
-
-    items.reserve(metaGenres.size() + otherGenres.size());
-    for (const auto &g : qAsConst(metaGenres)) {
-        g->setRow(items.size());
-        items.append(g);
-    }
-    for (const auto &g : qAsConst(otherGenres))
-        items.append(g);
 }
 
 void Genres::loadDecades() {
@@ -179,3 +94,27 @@ void Genres::loadDecades() {
         }
     }
 }
+
+void Genres::loadArtwork() {
+    QHash<int, Decade *> decades;
+    for (Item *item : qAsConst(items)) {
+        if (Decade *decade = qobject_cast<Decade *>(item))
+            decades.insert(decade->getStartYear(), decade);
+    }
+
+    QSqlDatabase db = Database::instance().getConnection();
+    QSqlQuery query(db);
+    query.prepare("select genre,artist from genreArtists order by genre,position");
+    bool success = query.exec();
+    if (!success) qDebug() << query.lastError().text();
+    forEachGroup(query, [](int genreId, const QVector<int> &artistIds) {
+        if (Genre *genre = Genre::forId(genreId)) genre->setArtworkArtists(artistIds);
+    });
+
+    query.prepare("select decade,album from decadeAlbums order by decade,position");
+    success = query.exec();
+    if (!success) qDebug() << query.lastError().text();
+    forEachGroup(query, [&decades](int startYear, const QVector<int> &albumIds) {
+        if (Decade *decade = decades.value(startYear)) decade->setArtworkAlbums(albumIds);
+    });
+}
@@ -23,6 +23,7 @@ signals:
 private:
     void loadGenres();
     void loadDecades();
+    void loadArtwork();
 
     QVector<Item *> items;
 };
@@ -0,0 +1,87 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "genretagparser.h"
+
+GenreTagParser::GenreTagParser(const QString &replacementsFile) {
+    static const QLatin1String separators[] = {QLatin1String(","), QLatin1String("/"),
+                                               QLatin1String(";"), QLatin1String(" & ")};
+    for (const QLatin1String &separator : separators)
+        matcher.addPattern(separator, Separator);
+
+    QFile f(replacementsFile);
+    if (f.open(QFile::ReadOnly)) {
+        QTextStream stream(&f);
+        QString line;
+        while (!stream.atEnd()) {
+            stream.readLineInto(&line);
+            if (line.isEmpty()) continue;
+            const int comma = line.indexOf(',');
+            if (comma == 0) continue;
+            // no comma: the whole line is removed
+            matcher.addPattern(comma < 0 ? line : line.left(comma), replacements.size());
+            replacements << (comma < 0 ? QString() : line.mid(comma + 1));
+        }
+    } else {
+        qWarning() << "Cannot read" << replacementsFile;
+    }
+    matcher.build();
+}
+
+QStringList GenreTagParser::parse(const QString &tag) const {
+    const int length = tag.length();
+    // longest match starting at each position
+    QVarLengthArray<Match, 256> matches(length);
+    matcher.match(tag, [&matches](int start, int matchLength, int value) {
+        Match &m = matches[start];
+        if (m.value == Separator && m.length > 0) return;
+        if (value == Separator || matchLength > m.length) m = {matchLength, value};
+    });
+
+    QStringList names;
+    QString name;
+    int i = 0;
+    while (i < length) {
+        // next segment, without surrounding spaces
+        int end = i;
+        while (end < length && matches.at(end).value != Separator)
+            ++end;
+        const int next = end < length ? end + matches.at(end).length : end;
+        while (i < end && tag.at(i).isSpace())
+            ++i;
+        while (end > i && tag.at(end - 1).isSpace())
+            --end;
+
+        name.clear();
+        while (i < end) {
+            const Match &m = matches.at(i);
+            if (m.length > 0 && i + m.length <= end) {
+                name += replacements.at(m.value);
+                i += m.length;
+            } else
+                name += tag.at(i++);
+        }
+
+        name = name.simplified();
+        if (!name.isEmpty()) names << name;
+        i = next;
+    }
+    return names;
+}
@@ -0,0 +1,52 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef GENRETAGPARSER_H
+#define GENRETAGPARSER_H
+
+#include <QtCore>
+
+#include "stringmatcher.h"
+
+/**
+ * Splits a genre tag and applies genre-replacements.csv in a single pass.
+ * Separators and bad words are all patterns of the same automaton. Splitting wins over
+ * replacing and, like QString::replace(), the leftmost and then longest bad word wins.
+ * A line without a comma is a bad word that is removed.
+ */
+class GenreTagParser {
+public:
+    explicit GenreTagParser(
+            const QString &replacementsFile = QStringLiteral(":/res/genre-replacements.csv"));
+
+    QStringList parse(const QString &tag) const;
+
+private:
+    enum { Separator = -1 };
+    struct Match {
+        int length = 0;
+        int value = 0;
+    };
+
+    StringMatcher matcher;
+    QStringList replacements;
+};
+
+#endif // GENRETAGPARSER_H
@@ -0,0 +1,239 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "genretree.h"
+
+#include <QtSql>
+
+#include "database.h"
+#include "stringmatcher.h"
+
+#include "model/genre.h"
+
+namespace {
+
+// Genres smaller than this are not shown at all
+const int minTrackCount = 5;
+// Unclassified genres smaller than this are not shown
+const int minOtherTrackCount = 20;
+// Meta-genres smaller than this, children included, are not shown
+const int minMetaTrackCount = 30;
+
+/**
+ * Finds the meta-genre of a genre hash. A genre belongs to the first row of genre-tree.csv
+ * whose meta-genre or sub-genres are contained in its hash.
+ */
+class Classifier {
+public:
+    Classifier() {
+        QFile f(":/res/genre-tree.csv");
+        if (f.open(QFile::ReadOnly)) {
+            QTextStream stream(&f);
+            QString line;
+            while (!stream.atEnd()) {
+                stream.readLineInto(&line);
+                if (line.isEmpty()) continue;
+                const QStringList fields = line.split(',');
+                const int row = metaGenres.size();
+                metaGenres << fields.first();
+                // odd values are the meta-genre words
+                matcher.addPattern(fields.first(), row * 2 + 1);
+                for (int i = 1; i < fields.size(); ++i)
+                    matcher.addPattern(fields.at(i), row * 2);
+            }
+        }
+        matcher.build();
+    }
+
+    // Returns the csv row or -1. exact is set when the hash is the meta-genre itself.
+    int classify(const QString &hash, bool *exact) const {
+        int row = -1;
+        int exactRow = -1;
+        matcher.match(hash, [&](int start, int length, int value) {
+            const int matchRow = value / 2;
+            if (row < 0 || matchRow < row) row = matchRow;
+            if (value % 2 && start == 0 && length == hash.length()) exactRow = matchRow;
+        });
+        *exact = row >= 0 && row == exactRow;
+        return row;
+    }
+
+    const QString &metaGenre(int row) const { return metaGenres.at(row); }
+
+private:
+    StringMatcher matcher;
+    QStringList metaGenres;
+};
+
+const Classifier &classifier() {
+    static const Classifier classifier;
+    return classifier;
+}
+
+struct Node {
+    int id;
+    QString hash;
+    int trackCount;
+    int totalTrackCount;
+    QVector<int> children;
+};
+
+class Builder {
+public:
+    bool build();
+    bool save() const;
+
+private:
+    int addNode(int id, const QString &hash, int trackCount);
+    int metaNode(int row);
+    int computeTotal(int node);
+    bool saveNode(int node, int parent, int depth, int position) const;
+
+    QVector<Node> nodes;
+    QHash<int, int> metaNodes;
+    QVector<int> topLevel;
+};
+
+int Builder::addNode(int id, const QString &hash, int trackCount) {
+    nodes.append({id, hash, trackCount, 0, {}});
+    return nodes.size() - 1;
+}
+
+int Builder::metaNode(int row) {
+    auto i = metaNodes.constFind(row);
+    if (i != metaNodes.constEnd()) return i.value();
+
+    const QString &hash = classifier().metaGenre(row);
+    QSqlQuery query =
+            Database::instance().cachedQuery("select id,trackCount from genres where hash=?");
+    query.bindValue(0, hash);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    int node = -1;
+    if (query.next()) {
+        node = addNode(query.value(0).toInt(), hash, query.value(1).toInt());
+    } else {
+        // meta-genres may have no tracks of their own
+        QString name = hash;
+        name[0] = name.at(0).toUpper();
+        Genre *genre = Genre::maybeCreateByName(name);
+        if (genre) node = addNode(genre->getId(), genre->getHash(), 0);
+    }
+    query.finish();
+
+    metaNodes.insert(row, node);
+    return node;
+}
+
+int Builder::computeTotal(int node) {
+    int total = nodes.at(node).trackCount;
+    for (int child : qAsConst(nodes.at(node).children))
+        total += computeTotal(child);
+    nodes[node].totalTrackCount = total;
+    return total;
+}
+
+bool Builder::build() {
+    QSqlQuery query(Database::instance().getConnection());
+    query.prepare("select id,hash,trackCount from genres where trackCount>? "
+                  "order by trackCount desc");
+    query.bindValue(0, minTrackCount);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+
+    QVector<int> metaGenres;
+    QVector<int> otherGenres;
+    while (query.next()) {
+        const int id = query.value(0).toInt();
+        const QString hash = query.value(1).toString();
+        const int trackCount = query.value(2).toInt();
+
+        bool exact;
+        const int row = classifier().classify(hash, &exact);
+        const int meta = row >= 0 ? metaNode(row) : -1;
+        if (meta < 0) {
+            if (trackCount > minOtherTrackCount) otherGenres << addNode(id, hash, trackCount);
+            continue;
+        }
+
+        if (!metaGenres.contains(meta)) metaGenres << meta;
+        if (exact || nodes.at(meta).id == id) continue;
+
+        // "deathmetal" goes under "heavymetal" if that came first
+        const int node = addNode(id, hash, trackCount);
+        int parent = meta;
+        for (int sibling : qAsConst(nodes.at(meta).children)) {
+            if (hash.contains(nodes.at(sibling).hash)) {
+                parent = sibling;
+                break;
+            }
+        }
+        nodes[parent].children << node;
+    }
+
+    for (int meta : qAsConst(metaGenres)) {
+        if (computeTotal(meta) > minMetaTrackCount) topLevel << meta;
+    }
+    for (int other : qAsConst(otherGenres)) {
+        nodes[other].totalTrackCount = nodes.at(other).trackCount;
+        topLevel << other;
+    }
+    return true;
+}
+
+bool Builder::saveNode(int node, int parent, int depth, int position) const {
+    const Node &n = nodes.at(node);
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert or replace into genreTree (genre,parent,depth,position,totalTrackCount) "
+            "values (?,?,?,?,?)");
+    query.bindValue(0, n.id);
+    query.bindValue(1, parent);
+    query.bindValue(2, depth);
+    query.bindValue(3, position);
+    query.bindValue(4, n.totalTrackCount);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    for (int i = 0; i < n.children.size(); ++i) {
+        if (!saveNode(n.children.at(i), n.id, depth + 1, i)) return false;
+    }
+    return true;
+}
+
+bool Builder::save() const {
+    QSqlQuery query(Database::instance().getConnection());
+    if (!query.exec("delete from genreTree")) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    for (int i = 0; i < topLevel.size(); ++i) {
+        if (!saveNode(topLevel.at(i), 0, 0, i)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool GenreTree::rebuild() {
+    Builder builder;
+    return builder.build() && builder.save();
+}
@@ -0,0 +1,36 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef GENRETREE_H
+#define GENRETREE_H
+
+#include <QtCore>
+
+/**
+ * Arranges the genres of the collection under the meta-genres of genre-tree.csv.
+ * The tree is stored in the genreTree table, the Genres view just reads it back.
+ */
+class GenreTree {
+public:
+    // Runs at the end of a scan, inside the caller's transaction
+    static bool rebuild();
+};
+
+#endif // GENRETREE_H
@@ -0,0 +1,273 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "imageutils.h"
+
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Filter weights are 1.14 fixed point, the taps of each output pixel sum to exactly 1 << 14
+const int weightBits = 14;
+
+struct Taps {
+    int first;
+    int count;
+    int offset; // into Filter::weights
+};
+
+struct Filter {
+    QVector<Taps> taps;
+    QVector<qint16> weights;
+};
+
+/**
+ * A tent filter whose support widens with the downscaling factor: every source pixel is
+ * averaged into the output, like a box prefilter followed by bilinear interpolation.
+ * When upscaling it is plain bilinear interpolation.
+ */
+Filter makeFilter(int srcSize, int dstSize) {
+    Filter filter;
+    filter.taps.resize(dstSize);
+    const double scale = double(dstSize) / srcSize;
+    const double support = scale < 1. ? 1. / scale : 1.;
+    const int maxTaps = int(std::ceil(support)) * 2 + 1;
+    filter.weights.reserve(dstSize * maxTaps);
+    QVector<double> values(maxTaps + 1);
+
+    for (int i = 0; i < dstSize; ++i) {
+        const double center = (i + .5) / scale;
+        const int first = qMax(0, int(std::floor(center - support)));
+        const int last = qMin(srcSize - 1, int(std::ceil(center + support)));
+        double sum = 0;
+        int count = 0;
+        for (int j = first; j <= last; ++j) {
+            const double value = qMax(0., 1. - std::abs(j + .5 - center) / support);
+            values[count++] = value;
+            sum += value;
+        }
+
+        Taps &taps = filter.taps[i];
+        taps.first = first;
+        taps.count = count;
+        taps.offset = filter.weights.size();
+        if (sum <= 0) {
+            // the output pixel falls between source pixels, take the nearest
+            taps.first = qBound(0, int(center), srcSize - 1);
+            taps.count = 1;
+            filter.weights.append(1 << weightBits);
+            continue;
+        }
+
+        // rounding leftovers go to the biggest weight so the taps sum to exactly one
+        int total = 0;
+        int biggest = 0;
+        for (int j = 0; j < count; ++j) {
+            const int weight = int(values[j] / sum * (1 << weightBits) + .5);
+            if (values[j] > values[biggest]) biggest = j;
+            filter.weights.append(qint16(weight));
+            total += weight;
+        }
+        filter.weights[taps.offset + biggest] += (1 << weightBits) - total;
+    }
+    return filter;
+}
+
+inline quint32 clampPixel(const int *channels) {
+    quint32 pixel = 0;
+    for (int c = 3; c >= 0; --c) {
+        const int value = (channels[c] + (1 << (weightBits - 1))) >> weightBits;
+        pixel = (pixel << 8) | quint32(qBound(0, value, 255));
+    }
+    return pixel;
+}
+
+// Channels are handled as bytes in memory order, so the pixel format does not matter here
+void resampleRowScalar(const quint32 *src, quint32 *dst, const Filter &filter) {
+    const int width = filter.taps.size();
+    for (int x = 0; x < width; ++x) {
+        const Taps &taps = filter.taps.at(x);
+        const qint16 *weights = filter.weights.constData() + taps.offset;
+        int channels[4] = {0, 0, 0, 0};
+        for (int i = 0; i < taps.count; ++i) {
+            const quint32 pixel = src[taps.first + i];
+            for (int c = 0; c < 4; ++c)
+                channels[c] += int((pixel >> (c * 8)) & 0xff) * weights[i];
+        }
+        dst[x] = clampPixel(channels);
+    }
+}
+
+void resampleColumnsScalar(const quint32 *const *rows, const qint16 *weights, int count,
+                           quint32 *dst, int from, int width) {
+    for (int x = from; x < width; ++x) {
+        int channels[4] = {0, 0, 0, 0};
+        for (int i = 0; i < count; ++i) {
+            const quint32 pixel = rows[i][x];
+            for (int c = 0; c < 4; ++c)
+                channels[c] += int((pixel >> (c * 8)) & 0xff) * weights[i];
+        }
+        dst[x] = clampPixel(channels);
+    }
+}
+
+#ifdef __SSE2__
+
+inline __m128i weightPair(qint16 a, qint16 b) {
+    return _mm_set1_epi32(int(quint32(quint16(b)) << 16 | quint16(a)));
+}
+
+inline quint32 packPixel(__m128i acc) {
+    acc = _mm_srai_epi32(acc, weightBits);
+    acc = _mm_packs_epi32(acc, acc);
+    acc = _mm_packus_epi16(acc, acc);
+    return quint32(_mm_cvtsi128_si32(acc));
+}
+
+/**
+ * Two source pixels per step: their channels are interleaved as 16 bit integers so that
+ * _mm_madd_epi16 weighs and sums both at once.
+ */
+void resampleRowSse2(const quint32 *src, quint32 *dst, const Filter &filter) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (weightBits - 1));
+    const int width = filter.taps.size();
+    for (int x = 0; x < width; ++x) {
+        const Taps &taps = filter.taps.at(x);
+        const quint32 *pixels = src + taps.first;
+        const qint16 *weights = filter.weights.constData() + taps.offset;
+        __m128i acc = rounding;
+        int i = 0;
+        for (; i + 1 < taps.count; i += 2) {
+            __m128i pair = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels + i));
+            pair = _mm_unpacklo_epi8(pair, zero);
+            pair = _mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pair, weightPair(weights[i], weights[i + 1])));
+        }
+        if (i < taps.count) {
+            __m128i pixel = _mm_cvtsi32_si128(int(pixels[i]));
+            pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(pixel, zero), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pixel, weightPair(weights[i], 0)));
+        }
+        dst[x] = packPixel(acc);
+    }
+}
+
+// Four output pixels per step, two source rows at a time
+void resampleColumnsSse2(const quint32 *const *rows, const qint16 *weights, int count,
+                         quint32 *dst, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (weightBits - 1));
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i acc0 = rounding, acc1 = rounding, acc2 = rounding, acc3 = rounding;
+        for (int i = 0; i < count; i += 2) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[i] + x));
+            const __m128i b = i + 1 < count ?
+                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[i + 1] + x)) :
+                        zero;
+            const __m128i weight = weightPair(weights[i], i + 1 < count ? weights[i + 1] : 0);
+            const __m128i aLow = _mm_unpacklo_epi8(a, zero);
+            const __m128i aHigh = _mm_unpackhi_epi8(a, zero);
+            const __m128i bLow = _mm_unpacklo_epi8(b, zero);
+            const __m128i bHigh = _mm_unpackhi_epi8(b, zero);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(aLow, bLow), weight));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(aLow, bLow), weight));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(aHigh, bHigh), weight));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(aHigh, bHigh), weight));
+        }
+        const __m128i low = _mm_packs_epi32(_mm_srai_epi32(acc0, weightBits),
+                                            _mm_srai_epi32(acc1, weightBits));
+        const __m128i high = _mm_packs_epi32(_mm_srai_epi32(acc2, weightBits),
+                                             _mm_srai_epi32(acc3, weightBits));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(low, high));
+    }
+    resampleColumnsScalar(rows, weights, count, dst, x, width);
+}
+
+#endif
+
+} // namespace
+
+QImage ImageUtils::scaled(const QImage &image, const QSize &size, Qt::AspectRatioMode mode) {
+    if (image.isNull()) return image;
+    const QSize dstSize = image.size().scaled(size, mode);
+    if (dstSize.isEmpty()) return QImage();
+    if (dstSize == image.size()) return image;
+
+    // alpha is filtered premultiplied, or transparent pixels would bleed their color
+    const QImage::Format format = image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                          : QImage::Format_RGB32;
+    const QImage src = image.format() == format ? image : image.convertToFormat(format);
+
+    const int srcHeight = src.height();
+    const int dstWidth = dstSize.width();
+    const int dstHeight = dstSize.height();
+    const Filter horizontal = makeFilter(src.width(), dstWidth);
+    const Filter vertical = makeFilter(srcHeight, dstHeight);
+
+    // horizontal pass first: the intermediate rows are already dstWidth wide
+    QVector<quint32> rows(dstWidth * srcHeight);
+    for (int y = 0; y < srcHeight; ++y) {
+        const quint32 *line = reinterpret_cast<const quint32 *>(src.constScanLine(y));
+#ifdef __SSE2__
+        resampleRowSse2(line, rows.data() + y * dstWidth, horizontal);
+#else
+        resampleRowScalar(line, rows.data() + y * dstWidth, horizontal);
+#endif
+    }
+
+    QImage dst(dstSize, format);
+    if (dst.isNull()) return dst;
+    QVector<const quint32 *> taps;
+    for (int y = 0; y < dstHeight; ++y) {
+        const Taps &t = vertical.taps.at(y);
+        taps.resize(t.count);
+        for (int i = 0; i < t.count; ++i)
+            taps[i] = rows.constData() + (t.first + i) * dstWidth;
+        const qint16 *weights = vertical.weights.constData() + t.offset;
+        quint32 *line = reinterpret_cast<quint32 *>(dst.scanLine(y));
+#ifdef __SSE2__
+        resampleColumnsSse2(taps.constData(), weights, t.count, line, dstWidth);
+#else
+        resampleColumnsScalar(taps.constData(), weights, t.count, line, 0, dstWidth);
+#endif
+    }
+    return dst;
+}
+
+
+QImage ImageUtils::readScaled(QImageReader &reader, const QSize &size) {
+    const QSize originalSize = reader.size();
+    if (!originalSize.isValid()) {
+        // the format cannot tell its size without decoding
+        const QImage image = reader.read();
+        if (image.isNull() || image.size() == image.size().scaled(size, Qt::KeepAspectRatio))
+            return image;
+        return scaled(image, size);
+    }
+
+    const QSize scaledSize = originalSize.scaled(size, Qt::KeepAspectRatio);
+    if (scaledSize != originalSize) reader.setScaledSize(scaledSize);
+    return reader.read();
+}
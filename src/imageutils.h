@@ -0,0 +1,47 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef IMAGEUTILS_H
+#define IMAGEUTILS_H
+
+#include <QtGui>
+
+class ImageUtils {
+public:
+    /**
+     * Decodes the image scaled to fit size, keeping the aspect ratio.
+     * The scaling happens while decoding: JPEGs are downscaled in the DCT domain by libjpeg,
+     * so the full resolution bitmap is never allocated.
+     */
+    static QImage readScaled(QImageReader &reader, const QSize &size);
+
+    /**
+     * Smooth scaling for thumbnails, a drop-in for QImage::scaled() with
+     * Qt::SmoothTransformation. Separable fixed point filter, vectorized with SSE2 where
+     * available. Reentrant: it can run in any thread.
+     */
+    static QImage scaled(const QImage &image, const QSize &size,
+                         Qt::AspectRatioMode mode = Qt::KeepAspectRatio);
+
+private:
+    ImageUtils() {}
+};
+
+#endif // IMAGEUTILS_H
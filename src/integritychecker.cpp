@@ -0,0 +1,318 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "integritychecker.h"
+
+#include <QtSql>
+#include <cstring>
+
+#include "database.h"
+
+namespace {
+
+// Tracks per transaction
+const int batchSize = 64;
+// Concurrent readers per device, spinning disks do not like more
+const int readersPerDevice = 2;
+// Also how much a reader may still read once stop() is called
+const qint64 chunkSize = 256 * 1024;
+// Pause between chunks when throttled, i.e. about 20MB/s per device
+const int throttleSleep = 12;
+// Hashes are verified again after this long
+const uint reverifySecs = 30 * 24 * 60 * 60;
+
+// XXH64, streaming: the files are read in chunks
+class Xxh64 {
+public:
+    Xxh64() {
+        v[0] = prime1 + prime2;
+        v[1] = prime2;
+        v[2] = 0;
+        v[3] = 0 - prime1;
+    }
+
+    void addData(const char *data, qint64 length) {
+        const uchar *p = reinterpret_cast<const uchar *>(data);
+        const uchar *end = p + length;
+        total += length;
+        if (bufferSize) {
+            const int n = int(qMin<qint64>(32 - bufferSize, length));
+            memcpy(buffer + bufferSize, p, n);
+            bufferSize += n;
+            p += n;
+            if (bufferSize < 32) return;
+            stripe(buffer);
+            bufferSize = 0;
+        }
+        for (; end - p >= 32; p += 32)
+            stripe(p);
+        bufferSize = int(end - p);
+        memcpy(buffer, p, bufferSize);
+    }
+
+    quint64 result() const {
+        quint64 h;
+        if (total >= 32) {
+            h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (quint64 lane : v)
+                h = (h ^ round(0, lane)) * prime1 + prime4;
+        } else {
+            h = prime5;
+        }
+        h += quint64(total);
+
+        const uchar *p = buffer;
+        const uchar *end = buffer + bufferSize;
+        for (; end - p >= 8; p += 8) {
+            h ^= round(0, qFromLittleEndian<quint64>(p));
+            h = rotl(h, 27) * prime1 + prime4;
+        }
+        if (end - p >= 4) {
+            h ^= quint64(qFromLittleEndian<quint32>(p)) * prime1;
+            h = rotl(h, 23) * prime2 + prime3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h ^= *p * prime5;
+            h = rotl(h, 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    static const quint64 prime1 = 11400714785074694791ULL;
+    static const quint64 prime2 = 14029467366897019727ULL;
+    static const quint64 prime3 = 1609587929392839161ULL;
+    static const quint64 prime4 = 9650029242287828579ULL;
+    static const quint64 prime5 = 2870177450012600261ULL;
+
+    static quint64 rotl(quint64 x, int r) { return (x << r) | (x >> (64 - r)); }
+    static quint64 round(quint64 acc, quint64 input) {
+        return rotl(acc + input * prime2, 31) * prime1;
+    }
+    // Four independent lanes, the CPU keeps them in flight together
+    void stripe(const uchar *p) {
+        v[0] = round(v[0], qFromLittleEndian<quint64>(p));
+        v[1] = round(v[1], qFromLittleEndian<quint64>(p + 8));
+        v[2] = round(v[2], qFromLittleEndian<quint64>(p + 16));
+        v[3] = round(v[3], qFromLittleEndian<quint64>(p + 24));
+    }
+
+    quint64 v[4];
+    uchar buffer[32];
+    int bufferSize = 0;
+    qint64 total = 0;
+};
+
+struct CheckedTrack {
+    int id;
+    QString path;
+    quint64 device;
+    qint64 size;
+    qint64 lastModified;
+    bool hashed;
+    quint64 storedHash;
+    // filled in by the readers
+    bool read;
+    quint64 hash;
+    bool changed;
+};
+
+// The tracks of one device, shared by its readers
+struct DeviceQueue {
+    QVector<int> indexes;
+    QAtomicInt next;
+};
+
+class HashTask : public QRunnable {
+public:
+    HashTask(const IntegrityChecker *checker, const QString &root, QVector<CheckedTrack> *tracks,
+             DeviceQueue *queue)
+        : checker(checker), root(root), tracks(tracks), queue(queue) {}
+
+    void run() override {
+        QByteArray data(int(chunkSize), Qt::Uninitialized);
+        while (!checker->isInterruptionRequested()) {
+            const int i = queue->next.fetchAndAddRelaxed(1);
+            if (i >= queue->indexes.size()) break;
+            hash((*tracks)[queue->indexes.at(i)], data);
+        }
+    }
+
+private:
+    // Gives up mid-file when the checker is stopped, the track stays queued
+    void hash(CheckedTrack &track, QByteArray &data) {
+        QFile file(root + track.path);
+        if (!file.open(QIODevice::ReadOnly)) return;
+        // the stat the scanner stored, i.e. has the file been touched since?
+        const QFileInfo fileInfo(file);
+        const bool unmodified = fileInfo.size() == track.size &&
+                                fileInfo.lastModified().toMSecsSinceEpoch() == track.lastModified;
+        Xxh64 xxh;
+        while (true) {
+            if (checker->isInterruptionRequested()) return;
+            const qint64 n = file.read(data.data(), chunkSize);
+            if (n < 0) return;
+            if (n == 0) break;
+            xxh.addData(data.constData(), n);
+            if (checker->isThrottled() && !checker->isInterruptionRequested())
+                QThread::msleep(throttleSleep);
+        }
+        track.read = true;
+        track.hash = xxh.result();
+        track.changed = unmodified && track.hashed && track.hash != track.storedHash;
+    }
+
+    const IntegrityChecker *checker;
+    const QString root;
+    QVector<CheckedTrack> *tracks;
+    DeviceQueue *queue;
+};
+
+} // namespace
+
+IntegrityChecker::IntegrityChecker(QObject *parent) : QThread(parent) {
+    setObjectName("integrity");
+}
+
+IntegrityChecker::~IntegrityChecker() {
+    stop();
+}
+
+IntegrityChecker &IntegrityChecker::instance() {
+    static IntegrityChecker i;
+    return i;
+}
+
+void IntegrityChecker::stop() {
+    if (!isRunning()) return;
+    requestInterruption();
+    wait();
+}
+
+void IntegrityChecker::run() {
+    const QString root = Database::instance().collectionRoot() + "/";
+    while (!isInterruptionRequested() && checkBatch(root)) {
+    }
+    if (!isInterruptionRequested()) emit checked(collectStats());
+    Database::instance().closeConnection();
+}
+
+bool IntegrityChecker::checkBatch(const QString &root) {
+    QSqlDatabase db = Database::instance().getConnection();
+    QSqlQuery query(db);
+    // never hashed first, then the oldest hashes
+    query.prepare("select id,path,device,size,mtime,contentHash from tracks "
+                  "where hashed is null or hashed<? order by hashed limit ?");
+    query.bindValue(0, QDateTime::currentDateTimeUtc().toTime_t() - reverifySecs);
+    query.bindValue(1, batchSize);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    QVector<CheckedTrack> tracks;
+    while (query.next()) {
+        const QVariant storedHash = query.value(5);
+        tracks.append({query.value(0).toInt(), query.value(1).toString(),
+                       quint64(query.value(2).toLongLong()), query.value(3).toLongLong(),
+                       query.value(4).toLongLong(), !storedHash.isNull(),
+                       quint64(storedHash.toLongLong()), false, 0, false});
+    }
+    query.finish();
+    if (tracks.isEmpty()) return false;
+
+    // Files are read outside of the transaction, they're the slow part
+    QHash<quint64, DeviceQueue *> queues;
+    for (int i = 0; i < tracks.size(); ++i) {
+        DeviceQueue *&queue = queues[tracks.at(i).device];
+        if (!queue) queue = new DeviceQueue();
+        queue->indexes << i;
+    }
+    QThreadPool pool;
+    const int readers = isThrottled() ? 1 : readersPerDevice;
+    pool.setMaxThreadCount(qMax(1, qMin(QThread::idealThreadCount(), queues.size() * readers)));
+    for (DeviceQueue *queue : qAsConst(queues)) {
+        for (int i = 0; i < qMin(readers, queue->indexes.size()); ++i)
+            pool.start(new HashTask(this, root, &tracks, queue));
+    }
+    pool.waitForDone();
+    qDeleteAll(queues);
+    if (isInterruptionRequested()) return false;
+
+    db.transaction();
+    const uint now = QDateTime::currentDateTimeUtc().toTime_t();
+    for (const CheckedTrack &track : qAsConst(tracks)) {
+        if (track.changed) qWarning() << "Content changed" << track.path;
+        // unreadable files keep their hash, the scanner deals with them
+        QSqlQuery update = Database::instance().cachedQuery(
+                track.read ? "update tracks set hashed=?, contentHash=?, contentChanged=? "
+                             "where id=?"
+                           : "update tracks set hashed=? where id=?");
+        update.bindValue(0, now);
+        if (track.read) {
+            // a changed file keeps the good hash, it's reported until it is rewritten
+            update.bindValue(1, qint64(track.changed ? track.storedHash : track.hash));
+            update.bindValue(2, track.changed ? QVariant(1) : QVariant());
+            update.bindValue(3, track.id);
+        } else {
+            update.bindValue(1, track.id);
+        }
+        if (!update.exec()) qWarning() << update.lastQuery() << update.lastError().text();
+    }
+    if (!db.commit()) {
+        qWarning() << "Commit failed!";
+        return false;
+    }
+    qDebug() << "Hashed" << tracks.size() << "tracks";
+    return true;
+}
+
+QVariantMap IntegrityChecker::collectStats() {
+    QSqlDatabase db = Database::instance().getConnection();
+    QSqlQuery query(db);
+
+    QStringList corruptTracks;
+    query.prepare("select path from tracks where contentChanged=1");
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    while (query.next())
+        corruptTracks << query.value(0).toString();
+
+    // same size too, a 64 bit hash can collide in a big collection
+    QStringList duplicateTracks;
+    query.prepare("select t.path from tracks t join "
+                  "(select contentHash,size from tracks where contentHash is not null "
+                  "group by contentHash,size having count(*)>1) d "
+                  "on t.contentHash=d.contentHash and t.size=d.size "
+                  "order by t.contentHash,t.path");
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    while (query.next())
+        duplicateTracks << query.value(0).toString();
+
+    QVariantMap stats;
+    stats.insert("corruptTracks", corruptTracks);
+    stats.insert("duplicateTracks", duplicateTracks);
+    return stats;
+}
@@ -0,0 +1,61 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef INTEGRITYCHECKER_H
+#define INTEGRITYCHECKER_H
+
+#include <QtCore>
+
+/**
+ * Opt-in low priority pass: hashes the content of every track (XXH64) and stores it in
+ * tracks.contentHash. Files are read by a thread pool, a few at a time per device.
+ * Hashes older than a month are verified again: content that changed while size and mtime
+ * did not is flagged. The queue is the tracks table itself, so it survives restarts.
+ */
+class IntegrityChecker : public QThread {
+    Q_OBJECT
+
+public:
+    static IntegrityChecker &instance();
+    ~IntegrityChecker();
+
+    // Files are read one at a time per device and slower, e.g. while playing
+    void setThrottled(bool value) { throttled.storeRelease(value); }
+    bool isThrottled() const { return throttled.loadAcquire(); }
+    // Interrupts the pass and waits for it, the rest stays queued.
+    // Readers give up mid-file, after at most one 256KB chunk.
+    void stop();
+
+signals:
+    // Emitted when a pass is complete: corruptTracks and duplicateTracks, lists of paths
+    void checked(const QVariantMap &stats);
+
+protected:
+    void run();
+
+private:
+    IntegrityChecker(QObject *parent = nullptr);
+    bool checkBatch(const QString &root);
+    QVariantMap collectStats();
+
+    QAtomicInt throttled;
+};
+
+#endif // INTEGRITYCHECKER_H
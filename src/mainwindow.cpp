@@ -49,8 +49,11 @@ $END_LICENSE */
 #elif defined Q_OS_UNIX
 #include "gnomeglobalshortcutbackend.h"
 #endif
+#include "artworknormalizer.h"
 #include "collectionsuggester.h"
+#include "durationupdater.h"
 #include "imagedownloader.h"
+#include "integritychecker.h"
 #include "lastfm.h"
 #include "lastfmlogindialog.h"
 #include <iostream>
@@ -138,6 +141,11 @@ void MainWindow::lazyInit() {
 #endif
     connect(&shortcuts, SIGNAL(PlayPause()), playAct, SLOT(trigger()));
     connect(&shortcuts, SIGNAL(Stop()), this, SLOT(stop()));
+
+    // downloaded covers and photos need their renditions too
+    connect(&ImageDownloader::instance(), SIGNAL(finished()), SLOT(normalizeArtwork()));
+    connect(&IntegrityChecker::instance(), SIGNAL(checked(QVariantMap)),
+            SLOT(integrityChecked(QVariantMap)));
 }
 
 void MainWindow::showInitialView() {
@@ -358,6 +366,14 @@ void MainWindow::createActions() {
     actionMap.insert("finetune", action);
     connect(action, SIGNAL(triggered()), SLOT(runFinetune()));
 
+    action = new QAction(tr("&Verify Collection Files"), this);
+    action->setStatusTip(tr("Find damaged and duplicate files in the background"));
+    action->setCheckable(true);
+    action->setMenuRole(QAction::ApplicationSpecificRole);
+    actionMap.insert("integrityCheck", action);
+    // not toggled(): restoring the setting must not start a pass
+    connect(action, SIGNAL(triggered(bool)), SLOT(toggleIntegrityCheck(bool)));
+
     action = new QAction(tr("&Report an Issue..."), this);
     actionMap.insert("report-issue", action);
     connect(action, SIGNAL(triggered()), SLOT(reportIssue()));
@@ -489,6 +505,7 @@ void MainWindow::createMenus() {
     fileMenu = menuBar()->addMenu(tr("&Application"));
     fileMenu->addAction(actionMap.value("finetune"));
     fileMenu->addAction(chooseFolderAct);
+    fileMenu->addAction(actionMap.value("integrityCheck"));
     fileMenu->addAction(actionMap.value("lastFmLogout"));
 #ifndef APP_MAC
     fileMenu->addSeparator();
@@ -688,6 +705,7 @@ void MainWindow::readSettings() {
     maximizedBeforeFullScreen = isMaximized();
     actionMap.value("shufflePlaylist")->setChecked(settings.value("shuffle").toBool());
     actionMap.value("repeatPlaylist")->setChecked(settings.value("repeat").toBool());
+    actionMap.value("integrityCheck")->setChecked(settings.value("integrityCheck").toBool());
 
     bool scrobbling = settings.value("scrobbling").toBool();
     actionMap.value("scrobbling")->setChecked(scrobbling);
@@ -790,6 +808,9 @@ void MainWindow::donate() {
 }
 
 void MainWindow::quit() {
+    DurationUpdater::instance().stop();
+    ArtworkNormalizer::instance().stop();
+    IntegrityChecker::instance().stop();
     savePlaylist();
     writeSettings();
     qApp->quit();
@@ -881,6 +902,11 @@ void MainWindow::startFullScan(QString directory) {
     }
     showView(collectionScannerView);
 
+    // the collection is about to be wiped
+    DurationUpdater::instance().stop();
+    ArtworkNormalizer::instance().stop();
+    IntegrityChecker::instance().stop();
+
     CollectionScannerThread &scannerThread = CollectionScannerThread::instance();
     collectionScannerView->setCollectionScannerThread(&scannerThread);
     scannerThread.setDirectory(std::move(directory));
@@ -916,12 +942,19 @@ void MainWindow::fullScanFinished(const QVariantMap &stats) {
         chooseFolderAct->setEnabled(true);
 
     ImageDownloader::instance().start();
+    DurationUpdater::instance().start(QThread::LowestPriority);
+    // finished() comes from the scanner thread, which may not have exited yet
+    ArtworkNormalizer::instance().start(QThread::LowestPriority);
+    checkIntegrity();
     CollectionScannerThread::instance().disconnect(this);
 }
 
 void MainWindow::startIncrementalScan() {
     showMessage(tr("Updating collection..."));
     chooseFolderAct->setEnabled(false);
+    DurationUpdater::instance().stop();
+    ArtworkNormalizer::instance().stop();
+    IntegrityChecker::instance().stop();
     CollectionScannerThread &scannerThread = CollectionScannerThread::instance();
     // incremental!
     scannerThread.setDirectory(QString());
@@ -942,11 +975,48 @@ void MainWindow::incrementalScanFinished(const QVariantMap &stats) {
     showMessage(tr("Collection updated"));
     showFinetuneDialog(stats);
     ImageDownloader::instance().start();
+    DurationUpdater::instance().start(QThread::LowestPriority);
+    ArtworkNormalizer::instance().start(QThread::LowestPriority);
+    checkIntegrity();
     CollectionScannerThread::instance().disconnect(this);
 }
 
+void MainWindow::normalizeArtwork() {
+    // it would compete with the scan for the albums, it starts when the scan is over
+    if (CollectionScannerThread::instance().isRunning()) return;
+    ArtworkNormalizer::instance().start(QThread::LowestPriority);
+}
+
+void MainWindow::checkIntegrity() {
+    QSettings settings;
+    if (!settings.value("integrityCheck").toBool()) return;
+    IntegrityChecker::instance().start(QThread::LowestPriority);
+}
+
+void MainWindow::toggleIntegrityCheck(bool enable) {
+    QSettings settings;
+    settings.setValue("integrityCheck", enable);
+    if (!enable)
+        IntegrityChecker::instance().stop();
+    else if (!CollectionScannerThread::instance().isRunning())
+        checkIntegrity();
+    // otherwise it starts when the scan is over
+}
+
+void MainWindow::integrityChecked(const QVariantMap &stats) {
+    const int corruptCount = stats.value("corruptTracks").toStringList().size();
+    const int duplicateCount = stats.value("duplicateTracks").toStringList().size();
+    qDebug() << "Integrity check:" << corruptCount << "changed" << duplicateCount << "duplicate";
+    if (corruptCount > 0)
+        showMessage(tr("%n file(s) changed on disk without being modified", "", corruptCount));
+    else if (duplicateCount > 0)
+        showMessage(tr("%n file(s) have a duplicate in your collection", "", duplicateCount));
+}
+
 void MainWindow::stateChanged(Media::State state) {
     // play action
+    // reading files competes with playback
+    IntegrityChecker::instance().setThrottled(state == Media::PlayingState);
     if (state == Media::PlayingState) {
         playAct->setChecked(true);
     } else if (state == Media::StoppedState || state == Media::PausedState) {
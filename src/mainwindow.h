@@ -109,6 +109,10 @@ private slots:
     void startIncrementalScan();
     void incrementalScanProgress(int percent);
     void incrementalScanFinished(const QVariantMap &stats);
+    void normalizeArtwork();
+    void checkIntegrity();
+    void toggleIntegrityCheck(bool enable);
+    void integrityChecked(const QVariantMap &stats);
     void search(QString query);
     void suggestionAccepted(Suggestion *suggestion);
     void searchCleared();
@@ -29,19 +29,20 @@ $END_LICENSE */
 #include "../httputils.h"
 #include "http.h"
 
+#include "../artworkstore.h"
 #include "../finderitemdelegate.h"
+#include "../imageutils.h"
 
 Album::Album() : year(0), artist(nullptr), listeners(0) {}
 
-QHash<int, Album *> Album::cache;
+IdentityMap<int, Album> Album::cache;
 
 Album *Album::forId(int albumId) {
-    auto i = cache.constFind(albumId);
-    if (i != cache.constEnd()) return i.value();
+    Album *cached;
+    if (cache.find(albumId, &cached)) return cached;
 
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select title, year, artist from albums where id=?");
+    QSqlQuery query =
+            Database::instance().cachedQuery("select title, year, artist from albums where id=?");
     query.bindValue(0, albumId);
     bool success = query.exec();
     if (!success) qDebug() << query.lastQuery() << query.lastError().text();
@@ -50,40 +51,40 @@ Album *Album::forId(int albumId) {
         album->setId(albumId);
         album->setTitle(query.value(0).toString());
         album->setYear(query.value(1).toInt());
+        const int artistId = query.value(2).toInt();
+        query.finish();
 
         // relations
-        int artistId = query.value(2).toInt();
         album->setArtist(Artist::forId(artistId));
         // if (!album->getArtist()) qWarning() << "no artist for" << album->getName();
 
-        // put into cache
-        cache.insert(albumId, album);
-        return album;
+        // put into cache, another thread may have been faster
+        cached = cache.insert(albumId, album);
+        if (cached != album) cache.dispose(album);
+        return cached;
     }
-    cache.insert(albumId, nullptr);
-    return nullptr;
+    return cache.insert(albumId, nullptr);
 }
 
 int Album::idForHash(const QString &hash) {
     int id = -1;
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select id from albums where hash=?");
+    QSqlQuery query = Database::instance().cachedQuery("select id from albums where hash=?");
     query.bindValue(0, hash);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
     if (query.next()) {
         id = query.value(0).toInt();
     }
+    query.finish();
     // qDebug() << "album id" << id;
     return id;
 }
 
 void Album::insert() {
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("insert into albums (hash,title,year,artist,trackCount,listeners)"
-                  " values (?,?,?,?,0,?)");
+    Database &database = Database::instance();
+    QSqlQuery query = database.cachedQuery("insert into albums "
+                                           "(hash,title,year,artist,trackCount,listeners)"
+                                           " values (?,?,?,?,0,?)");
     query.bindValue(0, getHash());
     query.bindValue(1, name);
     query.bindValue(2, year);
@@ -96,16 +97,15 @@ void Album::insert() {
 
     // increment artist's album count
     if (artist && artist->getId()) {
-        QSqlQuery query(db);
-        query.prepare("update artists set albumCount=albumCount+1 where id=?");
+        QSqlQuery query =
+                database.cachedQuery("update artists set albumCount=albumCount+1 where id=?");
         query.bindValue(0, artist->getId());
         bool success = query.exec();
         if (!success) qDebug() << query.lastError().text();
 
         // for artists that have no yearFrom, use the earliest album year
         if (year > 0) {
-            query = QSqlQuery(db);
-            query.prepare(
+            query = database.cachedQuery(
                     "update artists set yearFrom=? where id=? and (yearFrom=0 or yearFrom>?)");
             query.bindValue(0, year);
             query.bindValue(1, artist->getId());
@@ -118,9 +118,8 @@ void Album::insert() {
 
 void Album::update() {
     // qDebug() << "Album::update";
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("update albums set title=?, year=?, artist=? where hash=?");
+    QSqlQuery query = Database::instance().cachedQuery(
+            "update albums set title=?, year=?, artist=? where hash=?");
     query.bindValue(0, name);
     query.bindValue(1, year);
     int artistId = artist ? artist->getId() : 0;
@@ -178,12 +177,12 @@ void Album::fetchInfo() {
 // *** Last.fm Photo ***
 
 bool Album::hasPhoto() {
-    return QFile::exists(getImageLocation());
+    return ArtworkStore::hasArtwork(ArtworkStore::AlbumOwner, getHash());
 }
 
-QPixmap Album::getPhoto() {
+QPixmap Album::getPhoto(int pixelSize) {
     QPixmap p;
-    QFile file(getImageLocation());
+    QFile file(getImageLocation(pixelSize));
     if (file.open(QFile::ReadOnly)) {
         p.loadFromData(file.readAll());
         file.close();
@@ -194,16 +193,11 @@ QPixmap Album::getPhoto() {
 QPixmap Album::getThumb(int width, int height, qreal pixelRatio) {
     if (pixmap.isNull() || pixmap.devicePixelRatio() != pixelRatio ||
         pixmap.width() != width * pixelRatio) {
-        pixmap = getPhoto();
+        // decoded straight at the thumb size, from the nearest rendition
+        const QSize pixelSize(width * pixelRatio, height * pixelRatio);
+        QImageReader reader(getImageLocation(qMax(pixelSize.width(), pixelSize.height())));
+        pixmap = QPixmap::fromImage(ImageUtils::readScaled(reader, pixelSize));
         if (pixmap.isNull()) return pixmap;
-        const int pixelWidth = width * pixelRatio;
-        const int pixelHeight = height * pixelRatio;
-        const int wDiff = pixmap.width() - pixelWidth;
-        const int hDiff = pixmap.height() - pixelHeight;
-        if (wDiff || hDiff) {
-            pixmap = pixmap.scaled(pixelWidth, pixelHeight, Qt::KeepAspectRatio,
-                                   Qt::SmoothTransformation);
-        }
         pixmap.setDevicePixelRatio(pixelRatio);
     }
     return pixmap;
@@ -346,7 +340,7 @@ void Album::parseLastFmInfo(const QByteArray &bytes) {
                          xml.attributes().value("size") == QLatin1String("extralarge")) {
                     bool imageAlreadyPresent = property("localCover").toBool();
                     if (!imageAlreadyPresent)
-                        imageAlreadyPresent = QFile::exists(getImageLocation());
+                        imageAlreadyPresent = hasPhoto();
                     if (!imageAlreadyPresent) {
                         QString imageUrl = xml.readElementText();
                         if (!imageUrl.isEmpty()) setProperty("imageUrl", imageUrl);
@@ -409,8 +403,8 @@ QString Album::getBaseLocation() {
     return Database::getFilesLocation() + getHash();
 }
 
-QString Album::getImageLocation() {
-    return getBaseLocation() + QLatin1String("/_cover");
+QString Album::getImageLocation(int pixelSize) {
+    return ArtworkStore::location(ArtworkStore::AlbumOwner, getHash(), pixelSize);
 }
 
 QString Album::getWikiLocation() {
@@ -419,20 +413,7 @@ QString Album::getWikiLocation() {
 
 void Album::setPhoto(const QByteArray &bytes) {
     qDebug() << "Storing photo for" << name;
-
-    // store photo
-    QString storageLocation = getImageLocation();
-
-    QFileInfo info(storageLocation);
-    QDir().mkpath(info.absolutePath());
-
-    QFile file(storageLocation);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Error opening file for writing" << file.fileName();
-    }
-    QDataStream stream(&file);
-    stream.writeRawData(bytes.constData(), bytes.size());
-
+    ArtworkStore::setArtwork(ArtworkStore::AlbumOwner, getHash(), bytes);
     emit gotPhoto();
 }
 
@@ -477,53 +458,10 @@ QString normalizeString(QString s) {
     if (s2.simplified().length() > 4) s = s2;
     s2.clear();
 
-    // keep only letters
-    int stringSize = s.size();
-    for (int i = 0; i < stringSize; ++i) {
-        const QChar c = s.at(i);
-        if (c.isLetter()) s2.append(c);
-    }
-    s = s2;
-    s2.clear();
-
-    // simplify accented chars èé=>e etc
-    static QVector<QPair<QChar, QString>> charVariants;
-    static int charVariantsSize;
-    if (charVariants.isEmpty()) {
-        charVariants << QPair<QChar, QString>('a', "áàâäãåāăą")
-                     << QPair<QChar, QString>('e', "éèêëēĕėęě")
-                     << QPair<QChar, QString>('i', "íìıîïĩīĭį")
-                     << QPair<QChar, QString>('o', "óòôöõōŏőơ")
-                     << QPair<QChar, QString>('u', "úùûüũūŭůűųư")
-                     << QPair<QChar, QString>('c', "çćčĉċ") << QPair<QChar, QString>('d', "đ")
-                     << QPair<QChar, QString>('g', "ğĝġģǵ") << QPair<QChar, QString>('h', "ĥħ")
-                     << QPair<QChar, QString>('j', "ĵ") << QPair<QChar, QString>('k', "ķĸ")
-                     << QPair<QChar, QString>('l', "ĺļľŀ") << QPair<QChar, QString>('n', "ñńņňŉŋ")
-                     << QPair<QChar, QString>('r', "ŕŗř") << QPair<QChar, QString>('s', "śŝſș")
-                     << QPair<QChar, QString>('t', "ţťŧț") << QPair<QChar, QString>('r', "ŕŗř")
-                     << QPair<QChar, QString>('w', "ŵ") << QPair<QChar, QString>('y', "ýÿŷ")
-                     << QPair<QChar, QString>('z', "źż");
-        charVariantsSize = charVariants.size();
-    }
-
-    stringSize = s.size();
-    for (int i = 0; i < stringSize; ++i) {
-        // qDebug() << s.at(i) << s.at(i).decomposition();
-        const QChar currentChar = s.at(i);
-        bool replaced = false;
-
-        for (int y = 0; y < charVariantsSize; ++y) {
-            QPair<QChar, QString> pair = charVariants.at(y);
-            QChar c = pair.first;
-            QString variants = pair.second;
-            if (variants.contains(currentChar)) {
-                s2.append(c);
-                replaced = true;
-                break;
-            }
-        }
-
-        if (!replaced) s2.append(currentChar);
+    // keep only letters and simplify accented chars èé=>e etc
+    s2.reserve(s.size());
+    for (const QChar c : qAsConst(s)) {
+        if (c.isLetter()) s2.append(DataUtils::foldAccent(c));
     }
 
     return s2;
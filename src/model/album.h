@@ -22,6 +22,7 @@ $END_LICENSE */
 #define ALBUM_H
 
 #include "artist.h"
+#include "identitymap.h"
 #include "item.h"
 #include "track.h"
 #include <QtWidgets>
@@ -49,13 +50,14 @@ public:
 
     // relations
     Artist *getArtist() { return artist; }
-    void setArtist(Artist *artist) { this->artist = artist; }
+    Q_INVOKABLE void setArtist(Artist *artist) { this->artist = artist; }
 
     // data access
     static void clearCache() {
-        qDeleteAll(cache);
+        const QVector<Album *> albums = cache.values();
         cache.clear();
-        cache.squeeze();
+        for (Album *album : albums)
+            cache.dispose(album);
     }
     static Album *forId(int albumId);
     static int idForHash(const QString &name);
@@ -73,11 +75,12 @@ public:
     void fetchInfo();
 
     bool hasPhoto();
-    QPixmap getPhoto();
+    // With a pixelSize, the smallest stored rendition that covers it
+    QPixmap getPhoto(int pixelSize = 0);
     QPixmap getThumb(int width, int height, qreal pixelRatio);
     void clearPixmapCache() { pixmap = QPixmap(); }
 
-    QString getImageLocation();
+    QString getImageLocation(int pixelSize = 0);
 
     void fixTrackTitle(Track *track);
 
@@ -99,7 +102,7 @@ private:
     QString getBaseLocation();
     QString fixTrackTitleUsingTitle(Track *track, QString newTitle);
 
-    static QHash<int, Album *> cache;
+    static IdentityMap<int, Album> cache;
 
     QString name;
     int year;
@@ -29,20 +29,21 @@ $END_LICENSE */
 #include "../httputils.h"
 #include "http.h"
 
+#include "../artworkstore.h"
 #include "../imagedownloader.h"
+#include "../imageutils.h"
 
 Artist::Artist(QObject *parent)
     : Item(parent), trackCount(0), yearFrom(0), yearTo(0), listeners(0) {}
 
-QHash<int, Artist *> Artist::cache;
+IdentityMap<int, Artist> Artist::cache;
 
 Artist *Artist::forId(int artistId) {
-    auto i = cache.constFind(artistId);
-    if (i != cache.constEnd()) return i.value();
+    Artist *cached;
+    if (cache.find(artistId, &cached)) return cached;
 
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select name, trackCount, yearFrom, yearTo, listeners from artists where id=?");
+    QSqlQuery query = Database::instance().cachedQuery(
+            "select name, trackCount, yearFrom, yearTo, listeners from artists where id=?");
     query.bindValue(0, artistId);
     bool success = query.exec();
     if (!success) qDebug() << query.lastQuery() << query.lastError().text();
@@ -55,27 +56,27 @@ Artist *Artist::forId(int artistId) {
         artist->yearTo = query.value(3).toInt();
         artist->listeners = query.value(4).toUInt();
         // Add other fields here...
+        query.finish();
 
-        // put into cache
-        cache.insert(artistId, artist);
-        return artist;
+        // put into cache, another thread may have been faster
+        cached = cache.insert(artistId, artist);
+        if (cached != artist) cache.dispose(artist);
+        return cached;
     }
-    cache.insert(artistId, nullptr);
-    return nullptr;
+    return cache.insert(artistId, nullptr);
 }
 
 int Artist::idForName(const QString &name) {
     int id = -1;
     const QString hash = Artist::getHash(name);
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select id from artists where hash=?");
+    QSqlQuery query = Database::instance().cachedQuery("select id from artists where hash=?");
     query.bindValue(0, hash);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
     if (query.next()) {
         id = query.value(0).toInt();
     }
+    query.finish();
     // qDebug() << "artist hash" <<   hash << "id" << id;
     return id;
 }
@@ -85,11 +86,10 @@ void Artist::insert() {
     if (hash.isEmpty() || hash.length() < 3) return;
 
     // qDebug() << "Artist::insert";
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("insert into artists"
-                  " (hash, name, yearFrom, yearTo, listeners, albumCount, trackCount)"
-                  " values (?,?,?,?,?,0,0)");
+    QSqlQuery query = Database::instance().cachedQuery(
+            "insert into artists"
+            " (hash, name, yearFrom, yearTo, listeners, albumCount, trackCount)"
+            " values (?,?,?,?,?,0,0)");
     query.bindValue(0, hash);
     query.bindValue(1, name);
     query.bindValue(2, yearFrom);
@@ -103,9 +103,7 @@ void Artist::insert() {
 
 void Artist::update() {
     // qDebug() << "Artist::update";
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("update artists set name=? where hash=?");
+    QSqlQuery query = Database::instance().cachedQuery("update artists set name=? where hash=?");
     query.bindValue(0, name);
     query.bindValue(1, getHash());
     bool success = query.exec();
@@ -424,8 +422,8 @@ QString Artist::getBaseLocation() {
     return Database::getFilesLocation() + getHash();
 }
 
-QString Artist::getImageLocation() {
-    return getBaseLocation() + QLatin1String("/_photo");
+QString Artist::getImageLocation(int pixelSize) {
+    return ArtworkStore::location(ArtworkStore::ArtistOwner, getHash(), pixelSize);
 }
 
 QString Artist::getBioLocation() {
@@ -433,12 +431,12 @@ QString Artist::getBioLocation() {
 }
 
 bool Artist::hasPhoto() {
-    return QFile::exists(getImageLocation());
+    return ArtworkStore::hasArtwork(ArtworkStore::ArtistOwner, getHash());
 }
 
-QPixmap Artist::getPhoto() {
+QPixmap Artist::getPhoto(int pixelSize) {
     QPixmap p;
-    QFile file(getImageLocation());
+    QFile file(getImageLocation(pixelSize));
     if (file.open(QFile::ReadOnly)) {
         p.loadFromData(file.readAll());
         file.close();
@@ -446,31 +444,54 @@ QPixmap Artist::getPhoto() {
     return p;
 }
 
+namespace {
+
+// Fills the thumb, keeping the aspect ratio: the excess is cropped, faces are usually on top
+void thumbGeometry(const QSize &size, int pixelWidth, int pixelHeight, QSize *scaledSize,
+                   QRect *clipRect) {
+    const int wDiff = size.width() - pixelWidth;
+    const int hDiff = size.height() - pixelHeight;
+    if (wDiff > hDiff)
+        *scaledSize = QSize(size.width() * pixelHeight / size.height(), pixelHeight);
+    else
+        *scaledSize = QSize(pixelWidth, size.height() * pixelWidth / size.width());
+    const int xOffset = qMax(0, scaledSize->width() - pixelWidth) / 2;
+    const int yOffset = qMax(0, scaledSize->height() - pixelHeight) / 4;
+    *clipRect = QRect(xOffset, yOffset, pixelWidth, pixelHeight);
+}
+
+} // namespace
+
 QPixmap Artist::getThumb(int width, int height, qreal pixelRatio) {
     if (pixmap.isNull() || pixmap.devicePixelRatio() != pixelRatio ||
         pixmap.width() != width * pixelRatio) {
-        pixmap = getPhoto();
-        if (pixmap.isNull()) return pixmap;
-
         const int pixelWidth = width * pixelRatio;
         const int pixelHeight = height * pixelRatio;
 
-        int wDiff = pixmap.width() - pixelWidth;
-        int hDiff = pixmap.height() - pixelHeight;
-        if (wDiff > 0 || hDiff > 0) {
-            if (wDiff > hDiff) {
-                pixmap = pixmap.scaledToHeight(pixelHeight, Qt::SmoothTransformation);
-            } else {
-                pixmap = pixmap.scaledToWidth(pixelWidth, Qt::SmoothTransformation);
-            }
-            wDiff = pixmap.width() - pixelWidth;
-            hDiff = pixmap.height() - pixelHeight;
-            int xOffset = 0;
-            int yOffset = 0;
-            if (hDiff > 0) yOffset = hDiff / 4;
-            if (wDiff > 0) xOffset = wDiff / 2;
-            pixmap = pixmap.copy(xOffset, yOffset, pixelWidth, pixelHeight);
+        // photos can be big: scale and crop while decoding, from the nearest rendition
+        QImageReader reader(getImageLocation(qMax(pixelWidth, pixelHeight)));
+        const QSize size = reader.size();
+        QSize scaledSize;
+        QRect clipRect;
+        const bool tooBig = size.width() > pixelWidth || size.height() > pixelHeight;
+        if (size.isValid() && tooBig) {
+            thumbGeometry(size, pixelWidth, pixelHeight, &scaledSize, &clipRect);
+            reader.setScaledSize(scaledSize);
+            reader.setScaledClipRect(clipRect);
+        }
+        QImage image = reader.read();
+        if (image.isNull()) {
+            pixmap = QPixmap();
+            return pixmap;
         }
+
+        // the format could not tell its size upfront
+        if (!size.isValid() &&
+            (image.width() > pixelWidth || image.height() > pixelHeight)) {
+            thumbGeometry(image.size(), pixelWidth, pixelHeight, &scaledSize, &clipRect);
+            image = ImageUtils::scaled(image, scaledSize, Qt::IgnoreAspectRatio).copy(clipRect);
+        }
+        pixmap = QPixmap::fromImage(image);
         pixmap.setDevicePixelRatio(pixelRatio);
     }
     return pixmap;
@@ -478,17 +499,7 @@ QPixmap Artist::getThumb(int width, int height, qreal pixelRatio) {
 
 void Artist::setPhoto(const QByteArray &bytes) {
     qDebug() << "Storing photo for" << name;
-
-    // store photo
-    QString storageLocation = getImageLocation();
-    QDir().mkpath(QFileInfo(storageLocation).absolutePath());
-    QFile file(storageLocation);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qDebug() << "Error opening file for writing" << file.fileName();
-    }
-    QDataStream stream(&file); // we will serialize the data into the file
-    stream.writeRawData(bytes.constData(), bytes.size());
-
+    ArtworkStore::setArtwork(ArtworkStore::ArtistOwner, getHash(), bytes);
     emit gotPhoto();
 }
 
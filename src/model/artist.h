@@ -21,6 +21,7 @@ $END_LICENSE */
 #ifndef ARTIST_H
 #define ARTIST_H
 
+#include "identitymap.h"
 #include "item.h"
 #include "track.h"
 #include <QImage>
@@ -52,9 +53,10 @@ public:
 
     // data access
     static void clearCache() {
-        qDeleteAll(cache);
+        const QVector<Artist *> artists = cache.values();
         cache.clear();
-        cache.squeeze();
+        for (Artist *artist : artists)
+            cache.dispose(artist);
     }
     static Artist *forId(int artistId);
     static int idForName(const QString &name);
@@ -63,9 +65,10 @@ public:
 
     // internet
 
-    QString getImageLocation();
+    QString getImageLocation(int pixelSize = 0);
     bool hasPhoto();
-    QPixmap getPhoto();
+    // With a pixelSize, the smallest stored rendition that covers it
+    QPixmap getPhoto(int pixelSize = 0);
     QPixmap getThumb(int width, int height, qreal pixelRatio);
     void clearPixmapCache() { pixmap = QPixmap(); }
 
@@ -105,7 +108,7 @@ private:
     void parseNameAndMbid(const QByteArray &bytes, const QString &preferredName);
     static QString getHash(const QString &name);
 
-    static QHash<int, Artist *> cache;
+    static IdentityMap<int, Artist> cache;
 
     int trackCount;
 
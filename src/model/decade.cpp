@@ -3,11 +3,12 @@
 #include <QtSql>
 
 #include "../database.h"
+#include "../imageutils.h"
 
 #include "album.h"
 #include "track.h"
 
-Decade::Decade() : startYear(0), pixmapAlbum(nullptr) {}
+Decade::Decade() : startYear(0), pixmapAlbum(nullptr), artworkOffset(0) {}
 
 QVector<Track *> Decade::getTracks() {
     QSqlDatabase db = Database::instance().getConnection();
@@ -29,40 +30,38 @@ QVector<Track *> Decade::getTracks() {
 }
 
 QPixmap Decade::getThumb(int width, int height, qreal pixelRatio) {
-    if (!pixmapAlbum) pixmapAlbum = randomAlbum();
+    if (!pixmapAlbum) pixmapAlbum = pickAlbum();
     if (!pixmapAlbum) return pixmap;
     if (pixmap.isNull() || pixmap.devicePixelRatio() != pixelRatio ||
         pixmap.width() != width * pixelRatio) {
-        pixmap = pixmapAlbum->getPhoto();
-        if (pixmap.isNull()) return pixmap;
-
         const int pixelWidth = width * pixelRatio;
         const int pixelHeight = height * pixelRatio;
+        pixmap = pixmapAlbum->getPhoto(qMax(pixelWidth, pixelHeight));
+        if (pixmap.isNull()) return pixmap;
+
         const int wDiff = pixmap.width() - pixelWidth;
         const int hDiff = pixmap.height() - pixelHeight;
         if (wDiff || hDiff) {
-            pixmap = pixmap.scaled(pixelWidth, pixelHeight, Qt::KeepAspectRatio,
-                                   Qt::SmoothTransformation);
+            pixmap = QPixmap::fromImage(
+                    ImageUtils::scaled(pixmap.toImage(), QSize(pixelWidth, pixelHeight)));
         }
         pixmap.setDevicePixelRatio(pixelRatio);
     }
     return pixmap;
 }
 
-Album *Decade::randomAlbum() {
-    Album *album = nullptr;
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select a.id from genreTracks g, tracks t, albums a "
-                  "where g.track=t.id and t.album=a.id and t.year>=? and t.year<=? "
-                  "order by random() limit 10");
-    query.bindValue(0, startYear);
-    query.bindValue(1, startYear + 9);
-    bool success = query.exec();
-    if (!success) qDebug() << query.lastError().text();
-    while (query.next()) {
-        album = Album::forId(query.value(0).toInt());
-        if (album->hasPhoto()) break;
+void Decade::setArtworkAlbums(const QVector<int> &albumIds) {
+    artworkAlbums = albumIds;
+    artworkOffset = albumIds.isEmpty() ? 0 : qrand() % albumIds.size();
+    pixmapAlbum = nullptr;
+    pixmap = QPixmap();
+}
+
+Album *Decade::pickAlbum() {
+    const int size = artworkAlbums.size();
+    for (int i = 0; i < size; ++i) {
+        Album *album = Album::forId(artworkAlbums.at((artworkOffset + i) % size));
+        if (album && album->hasPhoto()) return album;
     }
-    return album;
+    return nullptr;
 }
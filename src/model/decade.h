@@ -19,15 +19,20 @@ public:
     QPixmap getThumb(int width, int height, qreal pixelRatio);
 
     void setName(const QString &value) { name = value; }
+    int getStartYear() const { return startYear; }
     void setStartYear(int value) { startYear = value; }
+    // Representative albums for the thumb, most relevant first
+    void setArtworkAlbums(const QVector<int> &albumIds);
 
 private:
-    Album *randomAlbum();
+    Album *pickAlbum();
 
     QString name;
     int startYear;
     Album *pixmapAlbum;
     QPixmap pixmap;
+    QVector<int> artworkAlbums;
+    int artworkOffset;
 };
 
 typedef QPointer<Decade> DecadePointer;
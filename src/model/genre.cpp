@@ -5,13 +5,16 @@
 #include "../database.h"
 #include "../datautils.h"
 #include "../iconutils.h"
+#include "../imageutils.h"
+#include "../genretagparser.h"
 
 #include "artist.h"
+#include "identitymap.h"
 #include "track.h"
 
 namespace {
-QHash<int, Genre *> cache;
-QHash<QString, Genre *> hashCache;
+IdentityMap<int, Genre> cache;
+IdentityMap<QString, Genre> hashCache;
 
 QString toCamelCase(const QString &s) {
     QString s2;
@@ -29,20 +32,19 @@ QString toCamelCase(const QString &s) {
 } // namespace
 
 void Genre::clearCache() {
-    qDeleteAll(cache);
+    const QVector<Genre *> genres = cache.values();
     cache.clear();
-    cache.squeeze();
     hashCache.clear();
-    hashCache.squeeze();
+    for (Genre *genre : genres)
+        cache.dispose(genre);
 }
 
 Genre *Genre::forId(int id) {
-    auto i = cache.constFind(id);
-    if (i != cache.constEnd()) return i.value();
+    Genre *cached;
+    if (cache.find(id, &cached)) return cached;
 
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select hash,name,trackCount from genres where id=?");
+    QSqlQuery query =
+            Database::instance().cachedQuery("select hash,name,trackCount from genres where id=?");
     query.bindValue(0, id);
     bool success = query.exec();
     if (!success) qDebug() << query.lastQuery() << query.lastError().text();
@@ -55,28 +57,59 @@ Genre *Genre::forId(int id) {
         genre->setHash(hash);
         genre->setName(query.value(1).toString());
         genre->setTrackCount(query.value(2).toInt());
-        hashCache.insert(hash, genre);
     }
-    cache.insert(id, genre);
+    query.finish();
+
+    // another thread may have been faster
+    cached = cache.insert(id, genre);
+    if (cached != genre) {
+        cache.dispose(genre);
+        return cached;
+    }
+    if (genre) hashCache.insert(genre->getHash(), genre);
+    return genre;
+}
+
+Genre *Genre::forId(int id, const QString &hash, const QString &name, int trackCount) {
+    Genre *genre;
+    if (cache.find(id, &genre)) {
+        // a cached genre belongs to the GUI thread, the scanner calls this too
+        if (genre->thread() == QThread::currentThread())
+            genre->setTrackCount(trackCount);
+        else
+            QMetaObject::invokeMethod(genre, "setTrackCount", Qt::QueuedConnection,
+                                      Q_ARG(int, trackCount));
+        return genre;
+    }
+
+    genre = new Genre();
+    genre->setId(id);
+    genre->setHash(hash);
+    genre->setName(name);
+    genre->setTrackCount(trackCount);
+
+    Genre *cached = cache.insert(id, genre);
+    if (cached != genre) {
+        cache.dispose(genre);
+        return cached;
+    }
+    hashCache.insert(hash, genre);
     return genre;
 }
 
 Genre *Genre::maybeCreateByName(const QString &name) {
     const QString hash = DataUtils::normalizeTag(name);
     if (hash.isEmpty()) return nullptr;
-    auto i = hashCache.constFind(hash);
-    if (i != hashCache.constEnd()) return i.value();
     Genre *genre = nullptr;
+    if (hashCache.find(hash, &genre)) return genre;
     int id = Genre::idForHash(hash);
     if (id != -1)
         genre = Genre::forId(id);
     else {
         // Insert it
-        QSqlDatabase db = Database::instance().getConnection();
-        QSqlQuery query(db);
-        query.prepare("insert into genres "
-                      "(hash,name,trackCount) "
-                      "values (?,?,0)");
+        QSqlQuery query = Database::instance().cachedQuery("insert into genres "
+                                                           "(hash,name,trackCount) "
+                                                           "values (?,?,0)");
         query.bindValue(0, hash);
         query.bindValue(1, name);
         bool success = query.exec();
@@ -92,9 +125,8 @@ Genre *Genre::maybeCreateByName(const QString &name) {
 
 Genre *Genre::forHash(const QString &hash) {
     if (hash.isEmpty()) return nullptr;
-    auto i = hashCache.constFind(hash);
-    if (i != hashCache.constEnd()) return i.value();
     Genre *genre = nullptr;
+    if (hashCache.find(hash, &genre)) return genre;
     int id = Genre::idForHash(hash);
     if (id != -1)
         genre = Genre::forId(id);
@@ -109,58 +141,35 @@ Genre *Genre::forHash(const QString &hash) {
 
 int Genre::idForHash(const QString &hash) {
     int id = -1;
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select id from genres where hash=?");
-
+    QSqlQuery query = Database::instance().cachedQuery("select id from genres where hash=?");
     query.bindValue(0, hash);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
     if (query.next()) {
         id = query.value(0).toInt();
     }
+    query.finish();
     return id;
 }
 
-QString Genre::cleanGenreName(QStringRef &genreName) {
-    static const auto replacements = [] {
-        QVector<QPair<QString, QString>> map;
-        QFile f(":/res/genre-replacements.csv");
-        if (f.open(QFile::ReadOnly)) {
-            QTextStream stream(&f);
-            QString line;
-            while (!stream.atEnd()) {
-                stream.readLineInto(&line);
-                QString badWord;
-                QString goodWord;
-                const auto fields = line.splitRef(',');
-                for (const QStringRef &field : fields) {
-                    if (badWord.isNull())
-                        badWord = field.toString();
-                    else
-                        goodWord = field.toString();
-                }
-                map.append(qMakePair(badWord, goodWord));
-            }
-        }
-        return map;
-    }();
+QStringList Genre::namesFromTag(const QString &tag) {
+    static const GenreTagParser parser;
+    static QMutex mutex;
+    static QHash<QString, QStringList> memo;
 
-    genreName = genreName.trimmed();
-    // if (genreName.startsWith(QLatin1String("& "))) genreName = genreName.mid(2);
-    if (genreName.isEmpty()) return QString();
+    QMutexLocker locker(&mutex);
+    auto i = memo.constFind(tag);
+    if (i != memo.constEnd()) return i.value();
 
-    QString s = genreName.toString();
-    for (auto &i : replacements) {
-        s.replace(i.first, i.second, Qt::CaseInsensitive);
-    }
-
-    if (genreName != s) qDebug() << genreName << s;
-    return s.simplified();
+    const QStringList names = parser.parse(tag);
+    if (memo.size() >= 4096) memo.clear();
+    memo.insert(tag, names);
+    return names;
 }
 
 Genre::Genre(QObject *parent)
-    : Item(parent), trackCount(0), pixmapArtist(nullptr), parent(nullptr), row(-1) {}
+    : Item(parent), trackCount(0), totalTrackCount(0), pixmapArtist(nullptr), artworkOffset(0),
+      parent(nullptr), row(-1) {}
 
 QVector<Track *> Genre::getTracks() {
     QSqlDatabase db = Database::instance().getConnection();
@@ -189,28 +198,21 @@ QVector<Track *> Genre::getTracks() {
     return tracks;
 }
 
-int Genre::getTotalTrackCount() const {
-    int count = trackCount;
-    for (Genre *g : qAsConst(children))
-        count += g->getTrackCount();
-    return count;
-}
-
 QPixmap Genre::getThumb(int width, int height, qreal pixelRatio) {
-    if (!pixmapArtist) pixmapArtist = randomArtist();
+    if (!pixmapArtist) pixmapArtist = pickArtist();
     if (!pixmapArtist) return pixmap;
     if (pixmap.isNull() || pixmap.devicePixelRatio() != pixelRatio ||
         pixmap.width() != width * pixelRatio) {
-        pixmap = pixmapArtist->getPhoto();
-        if (pixmap.isNull()) return pixmap;
-
         const int pixelWidth = width * pixelRatio;
         const int pixelHeight = height * pixelRatio;
+        pixmap = pixmapArtist->getPhoto(qMax(pixelWidth, pixelHeight));
+        if (pixmap.isNull()) return pixmap;
+
         const int wDiff = pixmap.width() - pixelWidth;
         const int hDiff = pixmap.height() - pixelHeight;
         if (wDiff || hDiff) {
-            pixmap = pixmap.scaled(pixelWidth, pixelHeight, Qt::KeepAspectRatio,
-                                   Qt::SmoothTransformation);
+            pixmap = QPixmap::fromImage(
+                    ImageUtils::scaled(pixmap.toImage(), QSize(pixelWidth, pixelHeight)));
         }
         /*
         QImage img = pixmap.toImage();
@@ -222,22 +224,21 @@ QPixmap Genre::getThumb(int width, int height, qreal pixelRatio) {
     return pixmap;
 }
 
-Artist *Genre::randomArtist() {
-    Artist *artist = nullptr;
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select a.id from genreTracks g, tracks t, artists a "
-                  "where g.track=t.id and t.artist=a.id and g.genre=? "
-                  "order by random() limit 10");
+void Genre::setArtworkArtists(const QVector<int> &artistIds) {
+    artworkArtists = artistIds;
+    // show a different one each time the view is rebuilt
+    artworkOffset = artistIds.isEmpty() ? 0 : qrand() % artistIds.size();
+    pixmapArtist = nullptr;
+    pixmap = QPixmap();
+}
 
-    query.bindValue(0, id);
-    bool success = query.exec();
-    if (!success) qDebug() << query.lastError().text();
-    while (query.next()) {
-        artist = Artist::forId(query.value(0).toInt());
-        if (artist->hasPhoto()) break;
+Artist *Genre::pickArtist() {
+    const int size = artworkArtists.size();
+    for (int i = 0; i < size; ++i) {
+        Artist *artist = Artist::forId(artworkArtists.at((artworkOffset + i) % size));
+        if (artist && artist->hasPhoto()) return artist;
     }
-    return artist;
+    return nullptr;
 }
 
 int Genre::getRow() const {
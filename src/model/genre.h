@@ -15,10 +15,13 @@ class Genre : public Item {
 public:
     static void clearCache();
     static Genre *forId(int id);
+    // For queries that already fetched the genre columns
+    static Genre *forId(int id, const QString &hash, const QString &name, int trackCount);
     static Genre *maybeCreateByName(const QString &name);
     static Genre *forHash(const QString &hash);
     static int idForHash(const QString &hash);
-    static QString cleanGenreName(QStringRef &genreName);
+    // Splits a genre tag into clean genre names
+    static QStringList namesFromTag(const QString &tag);
 
     Genre(QObject *parent = nullptr);
 
@@ -31,10 +34,14 @@ public:
     void setName(const QString &value) { name = value; }
 
     int getTrackCount() const { return trackCount; }
-    void setTrackCount(int value) { trackCount = value; }
-    int getTotalTrackCount() const;
+    Q_INVOKABLE void setTrackCount(int value) { trackCount = value; }
+    // Including the children, from the genre tree
+    int getTotalTrackCount() const { return totalTrackCount; }
+    void setTotalTrackCount(int value) { totalTrackCount = value; }
 
     QPixmap getThumb(int width, int height, qreal pixelRatio);
+    // Representative artists for the thumb, most relevant first
+    void setArtworkArtists(const QVector<int> &artistIds);
 
     bool hasChildren() const { return !children.isEmpty(); }
     const QVector<Genre *> &getChildren() const { return children; }
@@ -43,6 +50,7 @@ public:
         child->setRow(children.size());
         children << child;
     }
+    void clearChildren() { children.clear(); }
 
     void setParent(Genre *value) { parent = value; }
     Genre *getParent() const { return parent; }
@@ -52,14 +60,17 @@ public:
     void setRow(int value);
 
 private:
-    Artist *randomArtist();
+    Artist *pickArtist();
 
     QString hash;
     QString name;
     int trackCount;
+    int totalTrackCount;
 
     QPixmap pixmap;
     Artist *pixmapArtist;
+    QVector<int> artworkArtists;
+    int artworkOffset;
 
     QVector<Genre *> children;
     Genre *parent;
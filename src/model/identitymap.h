@@ -0,0 +1,243 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef IDENTITYMAP_H
+#define IDENTITYMAP_H
+
+#include <QtCore>
+
+/**
+ * Concurrent identity map used by the Track, Album, Artist and Genre caches.
+ *
+ * Keys are spread over a fixed number of shards. Each shard is an open addressing table
+ * whose slots are published with release semantics, so lookups never take a lock.
+ * Writers serialize on a per-shard mutex. Outgrown tables, and the tables and nodes emptied
+ * by clear(), are retired rather than freed because readers may still be probing them.
+ * They are freed with the map: clear() only runs when the collection is rebuilt from
+ * scratch, so that is a bounded amount of memory.
+ *
+ * A null value can be stored to remember that a key does not exist in the database.
+ *
+ * Thread affinity rules:
+ * - Entities handed out by the map live in the thread of the application object (the GUI
+ *   thread) so that signals like gotPhoto() and removed() reach the views. Entities created
+ *   by another thread, e.g. the collection scanner, are moved there on insertion.
+ * - Other threads must not call setters on a shared entity directly. They should go
+ *   through QMetaObject::invokeMethod(), like ImageDownloader does.
+ * - Entities must be released with dispose(), which defers the deletion to the owning
+ *   thread when needed.
+ */
+template <typename Key, typename T> class IdentityMap {
+public:
+    IdentityMap() {
+        for (Shard &shard : shards)
+            shard.table.storeRelease(new Table(InitialCapacity));
+    }
+
+    ~IdentityMap() {
+        for (Shard &shard : shards) {
+            Table *table = shard.table.loadAcquire();
+            for (int i = 0; i <= table->mask; ++i)
+                delete table->slots[i].loadAcquire();
+            delete table;
+            qDeleteAll(shard.retiredTables);
+            qDeleteAll(shard.retiredNodes);
+        }
+    }
+
+    /**
+     * Lock-free lookup. Returns true and sets value if key is in the map,
+     * value may be null for negatively cached keys.
+     */
+    bool find(const Key &key, T **value) const {
+        const uint h = qHash(key);
+        const Node *node = findNode(shardFor(h).table.loadAcquire(), key, h);
+        if (!node || !node->present.loadAcquire()) return false;
+        *value = node->value.loadAcquire();
+        return true;
+    }
+
+    T *value(const Key &key) const {
+        T *value = nullptr;
+        find(key, &value);
+        return value;
+    }
+
+    bool contains(const Key &key) const {
+        T *value;
+        return find(key, &value);
+    }
+
+    /**
+     * Inserts value for key unless another thread got there first.
+     * Returns the value that is actually stored in the map: when it is not the one passed
+     * in, the caller still owns its value and should dispose() it.
+     */
+    T *insert(const Key &key, T *value) {
+        const uint h = qHash(key);
+        Shard &shard = shardFor(h);
+        QMutexLocker locker(&shard.mutex);
+
+        Table *table = shard.table.loadAcquire();
+        Node *node = findNode(table, key, h);
+        if (node && node->present.loadAcquire()) return node->value.loadAcquire();
+
+        adopt(value);
+        if (node) {
+            // key was taken before, revive its node
+            node->value.storeRelease(value);
+            node->present.storeRelease(1);
+        } else {
+            if ((shard.nodeCount + 1) * 2 > table->mask + 1) table = grow(shard, table);
+            node = new Node(key, h);
+            node->value.storeRelease(value);
+            node->present.storeRelease(1);
+            publish(table, node);
+            shard.nodeCount++;
+        }
+        return value;
+    }
+
+    /**
+     * Removes key from the map and returns its value, the caller becomes its owner.
+     */
+    T *take(const Key &key) {
+        const uint h = qHash(key);
+        Shard &shard = shardFor(h);
+        QMutexLocker locker(&shard.mutex);
+        Node *node = findNode(shard.table.loadAcquire(), key, h);
+        if (!node || !node->present.loadAcquire()) return nullptr;
+        node->present.storeRelease(0);
+        return node->value.loadAcquire();
+    }
+
+    /**
+     * Snapshot of the non-null values currently in the map.
+     */
+    QVector<T *> values() const {
+        QVector<T *> values;
+        for (const Shard &shard : shards) {
+            const Table *table = shard.table.loadAcquire();
+            for (int i = 0; i <= table->mask; ++i) {
+                const Node *node = table->slots[i].loadAcquire();
+                if (!node || !node->present.loadAcquire()) continue;
+                if (T *value = node->value.loadAcquire()) values << value;
+            }
+        }
+        return values;
+    }
+
+    /**
+     * Empties the map without deleting the values. Safe while other threads are reading:
+     * they see either the old or the new contents.
+     */
+    void clear() {
+        for (Shard &shard : shards) {
+            QMutexLocker locker(&shard.mutex);
+            Table *table = shard.table.loadAcquire();
+            shard.table.storeRelease(new Table(InitialCapacity));
+            for (int i = 0; i <= table->mask; ++i) {
+                if (Node *node = table->slots[i].loadAcquire()) shard.retiredNodes << node;
+            }
+            shard.retiredTables << table;
+            shard.nodeCount = 0;
+        }
+    }
+
+    static void dispose(T *value) {
+        if (!value) return;
+        if (value->thread() == QThread::currentThread())
+            delete value;
+        else
+            value->deleteLater();
+    }
+
+private:
+    enum { ShardBits = 4, ShardCount = 1 << ShardBits, InitialCapacity = 64 };
+
+    struct Node {
+        Node(const Key &key, uint hash) : key(key), hash(hash) {}
+        const Key key;
+        const uint hash;
+        QAtomicPointer<T> value;
+        QAtomicInt present;
+    };
+
+    struct Table {
+        explicit Table(int capacity)
+            : mask(capacity - 1), slots(new QAtomicPointer<Node>[capacity]) {}
+        ~Table() { delete[] slots; }
+        const int mask;
+        QAtomicPointer<Node> *const slots;
+    };
+
+    // Shards are cache line aligned so that writers on different shards do not contend
+    struct alignas(64) Shard {
+        QMutex mutex;
+        QAtomicPointer<Table> table;
+        // Readers may still be probing these, they are freed with the map.
+        // Tables share their nodes, only the nodes of cleared tables are listed here.
+        QVector<Table *> retiredTables;
+        QVector<Node *> retiredNodes;
+        int nodeCount = 0;
+    };
+
+    Shard &shardFor(uint h) { return shards[h & (ShardCount - 1)]; }
+    const Shard &shardFor(uint h) const { return shards[h & (ShardCount - 1)]; }
+
+    static Node *findNode(const Table *table, const Key &key, uint h) {
+        // the load factor is kept under 1/2, so there's always an empty slot to stop at
+        for (int i = (h >> ShardBits) & table->mask;; i = (i + 1) & table->mask) {
+            Node *node = table->slots[i].loadAcquire();
+            if (!node) return nullptr;
+            if (node->hash == h && node->key == key) return node;
+        }
+    }
+
+    static void publish(Table *table, Node *node) {
+        int i = (node->hash >> ShardBits) & table->mask;
+        while (table->slots[i].loadAcquire())
+            i = (i + 1) & table->mask;
+        table->slots[i].storeRelease(node);
+    }
+
+    static Table *grow(Shard &shard, Table *table) {
+        Table *bigger = new Table((table->mask + 1) * 2);
+        for (int i = 0; i <= table->mask; ++i) {
+            if (Node *node = table->slots[i].loadAcquire()) publish(bigger, node);
+        }
+        shard.table.storeRelease(bigger);
+        shard.retiredTables << table;
+        return bigger;
+    }
+
+    static void adopt(T *value) {
+        if (!value) return;
+        QCoreApplication *app = QCoreApplication::instance();
+        if (!app) return;
+        QThread *owner = app->thread();
+        if (value->thread() != owner && value->thread() == QThread::currentThread())
+            value->moveToThread(owner);
+    }
+
+    Shard shards[ShardCount];
+};
+
+#endif // IDENTITYMAP_H
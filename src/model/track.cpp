@@ -30,24 +30,20 @@ $END_LICENSE */
 #include "../httputils.h"
 #include "http.h"
 
-#include <id3v2tag.h>
-#include <mpegfile.h>
-#include <unsynchronizedlyricsframe.h>
+#include "tagutils.h"
 
 Track::Track()
     : number(0), diskNumber(1), diskCount(1), year(0), length(0), album(nullptr), artist(nullptr),
       played(false), startTime(0) {}
 
-QHash<int, Track *> Track::cache;
-QHash<QString, Track *> Track::pathCache;
+IdentityMap<int, Track> Track::cache;
+IdentityMap<QString, Track> Track::pathCache;
 
 Track *Track::forId(int trackId) {
-    auto i = cache.constFind(trackId);
-    if (i != cache.constEnd()) return i.value();
+    Track *cached;
+    if (cache.find(trackId, &cached)) return cached;
 
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare(
+    QSqlQuery query = Database::instance().cachedQuery(
             "select path,title,duration,track,disk,diskCount,artist,album from tracks where id=?");
     query.bindValue(0, trackId);
     bool success = query.exec();
@@ -61,31 +57,34 @@ Track *Track::forId(int trackId) {
         track->setNumber(query.value(3).toInt());
         track->setDiskNumber(query.value(4).toInt());
         track->setDiskCount(query.value(5).toInt());
+        const int artistId = query.value(6).toInt();
+        const int albumId = query.value(7).toInt();
+        query.finish();
 
         // relations
         // TODO this could be made lazy
-        int artistId = query.value(6).toInt();
         track->setArtist(Artist::forId(artistId));
-        int albumId = query.value(7).toInt();
         track->setAlbum(Album::forId(albumId));
 
-        // put into cache
-        cache.insert(trackId, track);
+        // put into cache, another thread may have been faster
+        cached = cache.insert(trackId, track);
+        if (cached != track) {
+            cache.dispose(track);
+            return cached;
+        }
         pathCache.insert(track->getPath(), track);
 
         return track;
     }
 
     // id not found
-    cache.insert(trackId, nullptr);
-    return nullptr;
+    return cache.insert(trackId, nullptr);
 }
 
 Track *Track::forPath(const QString &path) {
     // qDebug() << "Track::forPath" << path;
-    auto i = pathCache.constFind(path);
-    if (i != pathCache.constEnd()) return i.value();
     Track *track = nullptr;
+    if (pathCache.find(path, &track)) return track;
     int id = Track::idForPath(path);
     if (id != -1) track = Track::forId(id);
     return track;
@@ -93,30 +92,27 @@ Track *Track::forPath(const QString &path) {
 
 int Track::idForPath(const QString &path) {
     int id = -1;
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select id from tracks where path=?");
+    QSqlQuery query = Database::instance().cachedQuery("select id from tracks where path=?");
     query.bindValue(0, path);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
     if (query.next()) {
         id = query.value(0).toInt();
     }
+    query.finish();
     return id;
 }
 
 bool Track::exists(const QString &path) {
     // qDebug() << "Track::exists";
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("select count(*) from tracks where path=?");
+    QSqlQuery query = Database::instance().cachedQuery("select count(*) from tracks where path=?");
     query.bindValue(0, path);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
-    if (query.next()) {
-        return query.value(0).toBool();
-    }
-    return false;
+    bool exists = false;
+    if (query.next()) exists = query.value(0).toBool();
+    query.finish();
+    return exists;
 }
 
 bool Track::isModified(const QString &path, uint lastModified) {
@@ -134,11 +130,12 @@ bool Track::isModified(const QString &path, uint lastModified) {
 
 void Track::insert() {
     // qDebug() << "Track::insert";
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-    query.prepare("insert into tracks "
-                  "(path,title,track,disk,diskCount,year,album,artist,albumArtist,tstamp,duration) "
-                  "values (?,?,?,?,?,?,?,?,?,?,?)");
+    Database &database = Database::instance();
+    QSqlQuery query = database.cachedQuery(
+            "insert into tracks "
+            "(path,title,track,disk,diskCount,year,album,artist,albumArtist,tstamp,duration,"
+            "device,inode,size,mtime,ctime) "
+            "values (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)");
     query.bindValue(0, path);
     query.bindValue(1, title);
     query.bindValue(2, number);
@@ -153,14 +150,19 @@ void Track::insert() {
     query.bindValue(8, artistId);
     query.bindValue(9, QDateTime::currentDateTimeUtc().toTime_t());
     query.bindValue(10, length);
+    query.bindValue(11, qint64(fileDevice));
+    query.bindValue(12, qint64(fileInode));
+    query.bindValue(13, fileSize);
+    query.bindValue(14, fileLastModified);
+    query.bindValue(15, fileLastChanged);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
     id = query.lastInsertId().toInt();
 
     // increment artist's track count
     if (artist && artist->getId()) {
-        QSqlQuery query(db);
-        query.prepare("update artists set trackCount=trackCount+1 where id=?");
+        QSqlQuery query =
+                database.cachedQuery("update artists set trackCount=trackCount+1 where id=?");
         query.bindValue(0, artist->getId());
         bool success = query.exec();
         if (!success) qDebug() << query.lastError().text();
@@ -168,8 +170,8 @@ void Track::insert() {
 
     // increment album's track count
     if (album && album->getId()) {
-        QSqlQuery query(db);
-        query.prepare("update albums set trackCount=trackCount+1 where id=?");
+        QSqlQuery query =
+                database.cachedQuery("update albums set trackCount=trackCount+1 where id=?");
         query.bindValue(0, album->getId());
         bool success = query.exec();
         if (!success) qDebug() << query.lastError().text();
@@ -178,8 +180,8 @@ void Track::insert() {
     // increment genres' track count
     for (Genre *genre : qAsConst(genres)) {
         {
-            QSqlQuery query(db);
-            query.prepare("insert into genreTracks (genre,track) values(?,?)");
+            QSqlQuery query =
+                    database.cachedQuery("insert into genreTracks (genre,track) values(?,?)");
             query.bindValue(0, genre->getId());
             query.bindValue(1, id);
             bool success = query.exec();
@@ -188,8 +190,8 @@ void Track::insert() {
                          << id;
         }
 
-        QSqlQuery query(db);
-        query.prepare("update genres set trackCount=trackCount+1 where id=?");
+        QSqlQuery query =
+                database.cachedQuery("update genres set trackCount=trackCount+1 where id=?");
         query.bindValue(0, genre->getId());
         bool success = query.exec();
         if (!success) qDebug() << query.lastError().text();
@@ -197,26 +199,26 @@ void Track::insert() {
 }
 
 void Track::update() {
-    QSqlDatabase db = Database::instance().getConnection();
-    QSqlQuery query(db);
-
-    query.prepare("select album, artist from tracks where path=?");
+    Database &database = Database::instance();
+    QSqlQuery query = database.cachedQuery("select album, artist from tracks where path=?");
     query.bindValue(0, path);
     bool success = query.exec();
     if (!success) qDebug() << query.lastError().text();
     if (query.next()) {
         int albumId = query.value(0).toInt();
         int artistId = query.value(1).toInt();
+        query.finish();
 
         if (!album || album->getId() != albumId) {
             // decrement previous album track count
-            query.prepare("update albums set trackCount=trackCount-1 where id=?");
+            query = database.cachedQuery("update albums set trackCount=trackCount-1 where id=?");
             query.bindValue(0, albumId);
             success = query.exec();
             if (!success) qDebug() << query.lastError().text();
             // and increment the new album track count
             if (album) {
-                query.prepare("update albums set trackCount=trackCount+1 where id=?");
+                query = database.cachedQuery(
+                        "update albums set trackCount=trackCount+1 where id=?");
                 query.bindValue(0, album->getId());
                 bool success = query.exec();
                 if (!success) qDebug() << query.lastError().text();
@@ -224,23 +226,28 @@ void Track::update() {
         }
 
         if (!artist || artist->getId() != artistId) {
-            query.prepare("update artists set trackCount=trackCount-1 where id=?");
+            query = database.cachedQuery("update artists set trackCount=trackCount-1 where id=?");
             query.bindValue(0, artistId);
             success = query.exec();
             if (!success) qDebug() << query.lastError().text();
             if (artist) {
-                query.prepare("update artists set trackCount=trackCount+1 where id=?");
+                query = database.cachedQuery(
+                        "update artists set trackCount=trackCount+1 where id=?");
                 query.bindValue(0, artist->getId());
                 bool success = query.exec();
                 if (!success) qDebug() << query.lastError().text();
             }
         }
-    }
+    } else
+        query.finish();
 
     // qDebug() << "Track::update";
 
-    query.prepare("update tracks set title=?, track=?, disk=?, year=?, album=?, artist=?, "
-                  "albumArtist=?, tstamp=?, duration=? where path=?");
+    query = database.cachedQuery("update tracks set title=?, track=?, disk=?, year=?, album=?, "
+                                 "artist=?, albumArtist=?, tstamp=?, duration=?, "
+                                 "device=?, inode=?, size=?, mtime=?, ctime=?, "
+                                 "contentHash=null, hashed=null, contentChanged=null "
+                                 "where path=?");
 
     query.bindValue(0, title);
     query.bindValue(1, number);
@@ -252,63 +259,80 @@ void Track::update() {
     query.bindValue(5, artistId);
     artistId = album && album->getArtist() ? album->getArtist()->getId() : 0;
     query.bindValue(6, artistId);
-    query.bindValue(7, QDateTime().toTime_t());
+    query.bindValue(7, QDateTime::currentDateTimeUtc().toTime_t());
     query.bindValue(8, length);
-    query.bindValue(9, path);
+    query.bindValue(9, qint64(fileDevice));
+    query.bindValue(10, qint64(fileInode));
+    query.bindValue(11, fileSize);
+    query.bindValue(12, fileLastModified);
+    query.bindValue(13, fileLastChanged);
+    query.bindValue(14, path);
     success = query.exec();
     if (!success) qDebug() << query.lastError().text();
 }
 
 void Track::remove(const QString &path) {
-    // qDebug() << "Track::remove";
+    remove(QStringList(path));
+}
+
+void Track::remove(const QStringList &paths) {
+    if (paths.isEmpty()) return;
 
     QSqlDatabase db = Database::instance().getConnection();
     QSqlQuery query(db);
-
-    // first update trackCount on artist and album
-
-    query.prepare("select album, artist, genre from tracks where path=?");
-    query.bindValue(0, path);
-    bool success = query.exec();
-    if (!success) qDebug() << query.lastError().text();
-    if (query.next()) {
-        int albumId = query.value(0).toInt();
-        int artistId = query.value(1).toInt();
-        int genreId = query.value(2).toInt();
-
-        query.prepare("update albums set trackCount=trackCount-1 where id=?");
-        query.bindValue(0, albumId);
-        success = query.exec();
-        if (!success) qDebug() << query.lastError().text();
-
-        query.prepare("update artists set trackCount=trackCount-1 where id=?");
-        query.bindValue(0, artistId);
-        success = query.exec();
-        if (!success) qDebug() << query.lastError().text();
-
-        query.prepare("update genres set trackCount=trackCount-1 where id=?");
-        query.bindValue(0, genreId);
-        success = query.exec();
-        if (!success) qDebug() << query.lastError().text();
+    auto exec = [&query](const char *sql) {
+        if (!query.exec(QLatin1String(sql))) qWarning() << sql << query.lastError().text();
+    };
+
+    // collect the ids and relations once, then each aggregate is patched by a single statement
+    // a failed exec earlier on this connection may have left the table behind
+    exec("create temp table if not exists removedTracks "
+         "(id integer primary key, album integer, artist integer)");
+    exec("delete from removedTracks");
+    QSqlQuery insert(db);
+    insert.prepare("insert or ignore into removedTracks (id, album, artist) "
+                   "select id, album, artist from tracks where path=?");
+    for (const QString &path : paths) {
+        insert.bindValue(0, path);
+        if (!insert.exec()) qWarning() << insert.lastQuery() << insert.lastError().text();
     }
 
-    // update cache and notify everybody using this track
-    // that it is gone forever
-    int trackId = Track::idForPath(path);
-    if (trackId != -1) {
-        if (cache.contains(trackId)) {
-            Track *track = cache.value(trackId);
+    // albums this removal leaves without tracks no longer count for their artist.
+    // Before trackCount is patched, so albums that were already empty are left alone.
+    exec("update artists set albumCount=albumCount-"
+         "(select count(*) from albums b where b.artist=artists.id "
+         "and b.id in (select album from removedTracks) and b.trackCount>0 "
+         "and b.trackCount<=(select count(*) from removedTracks r where r.album=b.id)) "
+         "where id in (select b.artist from albums b "
+         "where b.id in (select album from removedTracks) and b.trackCount>0 "
+         "and b.trackCount<=(select count(*) from removedTracks r where r.album=b.id))");
+    exec("update albums set trackCount=trackCount-"
+         "(select count(*) from removedTracks r where r.album=albums.id) "
+         "where id in (select album from removedTracks)");
+    exec("update artists set trackCount=trackCount-"
+         "(select count(*) from removedTracks r where r.artist=artists.id) "
+         "where id in (select artist from removedTracks)");
+    exec("update genres set trackCount=trackCount-"
+         "(select count(*) from genreTracks g where g.genre=genres.id "
+         "and g.track in (select id from removedTracks)) "
+         "where id in (select genre from genreTracks "
+         "where track in (select id from removedTracks))");
+    exec("delete from genreTracks where track in (select id from removedTracks)");
+    exec("delete from pendingDurations where track in (select id from removedTracks)");
+    exec("delete from tracks where id in (select id from removedTracks)");
+
+    // update cache and notify everybody using these tracks
+    // that they are gone forever
+    exec("select id from removedTracks");
+    while (query.next()) {
+        Track *track = cache.take(query.value(0).toInt());
+        if (track) {
+            pathCache.take(track->getPath());
             track->emitRemovedSignal();
-            cache.remove(trackId);
             track->deleteLater();
         }
     }
-
-    // and then actually delete the track
-    query.prepare("delete from tracks where path=?");
-    query.bindValue(0, path);
-    success = query.exec();
-    if (!success) qDebug() << query.lastError().text();
+    exec("delete from removedTracks");
 }
 
 void Track::emitRemovedSignal() {
@@ -340,6 +364,54 @@ void Track::fetchInfo() {
     emit gotInfo();
 }
 
+void Track::updateCachedLength(int trackId, int length) {
+    Track *track = cache.value(trackId);
+    if (!track) return;
+    if (track->thread() == QThread::currentThread())
+        track->setLength(length);
+    else
+        QMetaObject::invokeMethod(track, "setLength", Q_ARG(int, length));
+}
+
+QStringList Track::pathsForFile(quint64 inode, qint64 size, qint64 lastModified) {
+    // not the device: network mounts can get a different one after a remount
+    QSqlQuery query = Database::instance().cachedQuery(
+            "select path from tracks where inode=? and size=? and mtime=?");
+    query.bindValue(0, qint64(inode));
+    query.bindValue(1, size);
+    query.bindValue(2, lastModified);
+    if (!query.exec()) qWarning() << query.lastQuery() << query.lastError().text();
+    QStringList paths;
+    while (query.next())
+        paths << query.value(0).toString();
+    return paths;
+}
+
+bool Track::updatePath(const QString &oldPath, const QString &newPath, quint64 device,
+                       qint64 lastChanged) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            "update tracks set path=?, device=?, ctime=? where path=?");
+    query.bindValue(0, newPath);
+    query.bindValue(1, qint64(device));
+    query.bindValue(2, lastChanged);
+    query.bindValue(3, oldPath);
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    if (query.numRowsAffected() < 1) return false;
+
+    Track *track = pathCache.take(oldPath);
+    if (track) {
+        pathCache.insert(newPath, track);
+        if (track->thread() == QThread::currentThread())
+            track->setPath(newPath);
+        else
+            QMetaObject::invokeMethod(track, "setPath", Q_ARG(QString, newPath));
+    }
+    return true;
+}
+
 QString Track::getAbsolutePath() {
     QString collectionRoot = Database::instance().collectionRoot();
     QString absolutePath = collectionRoot + "/" + path;
@@ -466,26 +538,11 @@ void Track::scrapeLyrics(const QByteArray &bytes) {
 }
 
 void Track::readLyricsFromTags() {
-    const QString absolutePath = getAbsolutePath();
-
-    const QString suffix = QFileInfo(absolutePath).suffix().toLower();
-    if (suffix != "mp3") return;
-
-    TagLib::MPEG::File f((TagLib::FileName)absolutePath.toUtf8());
-    if (!f.isValid()) return;
-
-    TagLib::ID3v2::Tag *tag = f.ID3v2Tag();
-    if (!tag) return;
-
-    TagLib::ID3v2::FrameList list = tag->frameList("USLT");
-    if (list.isEmpty()) return;
-
-    TagLib::ID3v2::UnsynchronizedLyricsFrame *frame =
-            static_cast<TagLib::ID3v2::UnsynchronizedLyricsFrame *>(list.front());
-    if (!frame) return;
-
-    QString lyrics = QString::fromUtf8(frame->text().toCString(true));
-    emit gotLyrics(lyrics);
+    Tags *tags = TagUtils::load(getAbsolutePath(), TagUtils::LyricsField);
+    if (!tags) return;
+    const QString lyrics = tags->getLyrics();
+    delete tags;
+    if (!lyrics.isEmpty()) emit gotLyrics(lyrics);
 }
 
 int Track::getTotalLength(const QVector<Track *> &tracks) {
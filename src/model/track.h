@@ -21,6 +21,7 @@ $END_LICENSE */
 #ifndef TRACK_H
 #define TRACK_H
 
+#include "identitymap.h"
 #include "item.h"
 #include <QtCore>
 
@@ -47,7 +48,7 @@ public:
     const QString &getTitle() { return title; }
     void setTitle(const QString &title) { this->title = title; }
     const QString &getPath() { return path; }
-    void setPath(const QString &path) { this->path = path; }
+    Q_INVOKABLE void setPath(const QString &path) { this->path = path; }
     int getNumber() { return number; }
     void setNumber(int number) { this->number = number; }
     int getDiskNumber() { return diskNumber; }
@@ -55,7 +56,7 @@ public:
     int getDiskCount() { return diskCount; }
     void setDiskCount(int value) { diskCount = value; }
     int getLength() { return length; }
-    void setLength(int length) { this->length = length; }
+    Q_INVOKABLE void setLength(int length) { this->length = length; }
     int getYear() { return year; }
     void setYear(int year) { this->year = year; }
     QString getHash();
@@ -64,6 +65,15 @@ public:
     void setPlayed(bool played) { this->played = played; }
     uint getStartTime() { return startTime; }
     void setStartTime(uint startTime) { this->startTime = startTime; }
+    // Stored by insert() and update(), times in msecs
+    void setFileIdentity(quint64 device, quint64 inode, qint64 size, qint64 lastModified,
+                         qint64 lastChanged) {
+        fileDevice = device;
+        fileInode = inode;
+        fileSize = size;
+        fileLastModified = lastModified;
+        fileLastChanged = lastChanged;
+    }
 
     // relations
     Album *getAlbum() const { return album; }
@@ -75,13 +85,13 @@ public:
 
     // cache
     static void clearCache() {
-        for (Track *track : qAsConst(cache))
-            track->emitRemovedSignal();
-        qDeleteAll(cache);
+        const QVector<Track *> tracks = cache.values();
         cache.clear();
-        cache.squeeze();
         pathCache.clear();
-        pathCache.squeeze();
+        for (Track *track : tracks) {
+            track->emitRemovedSignal();
+            cache.dispose(track);
+        }
     }
     void emitRemovedSignal();
 
@@ -92,6 +102,16 @@ public:
     static bool exists(const QString &path);
     static bool isModified(const QString &path, uint lastModified);
     static void remove(const QString &path);
+    // In one go, on the caller's transaction: counts and genre mappings are kept in sync
+    static void remove(const QStringList &paths);
+    // Patches the cached track, if any. Can be called from any thread.
+    static void updateCachedLength(int trackId, int length);
+    // Paths of the tracks whose file had this identity
+    static QStringList pathsForFile(quint64 inode, qint64 size, qint64 lastModified);
+    // A moved file: same row and id, new path
+    // the rename moved the ctime
+    static bool updatePath(const QString &oldPath, const QString &newPath, quint64 device,
+                           qint64 lastChanged);
     void insert();
     void update();
 
@@ -116,8 +136,8 @@ private:
     QString getLyricsLocation();
     static QString getHash(const QString &);
 
-    static QHash<int, Track *> cache;
-    static QHash<QString, Track *> pathCache;
+    static IdentityMap<int, Track> cache;
+    static IdentityMap<QString, Track> pathCache;
 
     void reset();
 
@@ -130,6 +150,12 @@ private:
     int year;
     int length;
 
+    quint64 fileDevice = 0;
+    quint64 fileInode = 0;
+    qint64 fileSize = 0;
+    qint64 fileLastModified = 0;
+    qint64 fileLastChanged = 0;
+
     /*
     // CUE support
     int start;
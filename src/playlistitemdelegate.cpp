@@ -21,6 +21,7 @@ $END_LICENSE */
 #include "playlistitemdelegate.h"
 #include "datautils.h"
 #include "iconutils.h"
+#include "imageutils.h"
 #include "model/album.h"
 #include "model/artist.h"
 #include "model/track.h"
@@ -182,18 +183,20 @@ void PlaylistItemDelegate::paintAlbumHeader(QPainter *painter,
     const qreal pixelRatio = painter->device()->devicePixelRatioF();
 
     if (album) {
-        QPixmap p = album->getPhoto();
+        const int ph = h * pixelRatio;
+        QPixmap p = album->getPhoto(ph);
         if (!p.isNull()) {
-            const int ph = h * pixelRatio;
-            p = p.scaled(ph, ph, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            p = QPixmap::fromImage(
+                    ImageUtils::scaled(p.toImage(), QSize(ph, ph), Qt::IgnoreAspectRatio));
             p.setDevicePixelRatio(pixelRatio);
             painter->drawPixmap(0, 0, p);
         }
     } else if (artist) {
-        QPixmap p = artist->getPhoto();
+        const int ph = h * pixelRatio;
+        QPixmap p = artist->getPhoto(ph);
         if (!p.isNull()) {
-            const int ph = h * pixelRatio;
-            p = p.scaled(ph, ph, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            p = QPixmap::fromImage(
+                    ImageUtils::scaled(p.toImage(), QSize(ph, ph), Qt::IgnoreAspectRatio));
             p.setDevicePixelRatio(pixelRatio);
             painter->drawPixmap(0, 0, p);
         }
@@ -0,0 +1,154 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "scantelemetry.h"
+
+namespace {
+
+const char *phaseNames[] = {"fingerprint",   "walk",       "tags",      "localCover",
+                            "embeddedCover", "artistInfo", "albumInfo", "trackInsert"};
+
+const char *queueNames[] = {"files", "artists", "albums"};
+
+double toMillis(qint64 usecs) {
+    return usecs / 1000.;
+}
+
+} // namespace
+
+void ScanTelemetry::Histogram::clear() {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    total = 0;
+    max = 0;
+}
+
+int ScanTelemetry::Histogram::bucketFor(qint64 usecs) {
+    if (usecs < SubBuckets) return int(qMax<qint64>(0, usecs));
+    const int exponent = 63 - int(qCountLeadingZeroBits(quint64(usecs)));
+    const int subBucket = int(usecs >> (exponent - 3)) & (SubBuckets - 1);
+    return qMin(int(BucketCount) - 1, SubBuckets + (exponent - 3) * SubBuckets + subBucket);
+}
+
+qint64 ScanTelemetry::Histogram::bucketValue(int bucket) {
+    if (bucket < SubBuckets) return bucket;
+    const int exponent = (bucket - SubBuckets) / SubBuckets + 3;
+    const int subBucket = (bucket - SubBuckets) % SubBuckets;
+    const qint64 width = qint64(1) << (exponent - 3);
+    // middle of the bucket
+    return (SubBuckets + subBucket) * width + width / 2;
+}
+
+void ScanTelemetry::Histogram::add(qint64 usecs) {
+    buckets[bucketFor(usecs)]++;
+    count++;
+    total += usecs;
+    if (usecs > max) max = usecs;
+}
+
+qint64 ScanTelemetry::Histogram::percentile(double p) const {
+    if (count == 0) return 0;
+    const qint64 rank = qMax<qint64>(1, qint64(qCeil(p * count)));
+    qint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return qMin(bucketValue(i), max);
+    }
+    return max;
+}
+
+void ScanTelemetry::start(bool incremental) {
+    this->incremental = incremental;
+    for (Histogram &histogram : phases)
+        histogram.clear();
+    for (QueueStats &queue : queues)
+        queue = QueueStats();
+    files = 0;
+    bytes = 0;
+    clock.start();
+}
+
+void ScanTelemetry::record(Phase phase, qint64 nsecs) {
+    phases[phase].add(nsecs / 1000);
+}
+
+void ScanTelemetry::sampleQueue(Queue queue, int depth) {
+    QueueStats &stats = queues[queue];
+    stats.current = depth;
+    if (depth > stats.max) stats.max = depth;
+    stats.total += depth;
+    stats.samples++;
+}
+
+void ScanTelemetry::addFile(qint64 bytes) {
+    files++;
+    this->bytes += bytes;
+}
+
+QVariantMap ScanTelemetry::toVariantMap() const {
+    QVariantMap map;
+    const qint64 elapsed = clock.isValid() ? clock.elapsed() : 0;
+    map.insert("incremental", incremental);
+    map.insert("elapsedMs", elapsed);
+    map.insert("files", files);
+    map.insert("bytes", bytes);
+    if (elapsed > 0) {
+        map.insert("filesPerSecond", files * 1000. / elapsed);
+        map.insert("bytesPerSecond", bytes * 1000. / elapsed);
+    }
+
+    QVariantMap phaseMap;
+    for (int i = 0; i < PhaseCount; ++i) {
+        const Histogram &histogram = phases[i];
+        if (histogram.getCount() == 0) continue;
+        QVariantMap stats;
+        stats.insert("count", histogram.getCount());
+        stats.insert("totalMs", toMillis(histogram.getTotal()));
+        stats.insert("p50Ms", toMillis(histogram.percentile(.5)));
+        stats.insert("p90Ms", toMillis(histogram.percentile(.9)));
+        stats.insert("p99Ms", toMillis(histogram.percentile(.99)));
+        stats.insert("maxMs", toMillis(histogram.getMax()));
+        phaseMap.insert(phaseNames[i], stats);
+    }
+    map.insert("phases", phaseMap);
+
+    QVariantMap queueMap;
+    for (int i = 0; i < QueueCount; ++i) {
+        const QueueStats &queue = queues[i];
+        QVariantMap stats;
+        stats.insert("current", queue.current);
+        stats.insert("max", queue.max);
+        stats.insert("mean", queue.samples > 0 ? double(queue.total) / queue.samples : 0.);
+        queueMap.insert(queueNames[i], stats);
+    }
+    map.insert("queues", queueMap);
+
+    return map;
+}
+
+bool ScanTelemetry::save(const QVariantMap &telemetry, const QString &filename) {
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write" << filename << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument::fromVariant(telemetry).toJson());
+    return file.commit();
+}
@@ -0,0 +1,112 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef SCANTELEMETRY_H
+#define SCANTELEMETRY_H
+
+#include <QtCore>
+
+/**
+ * Timings and counters of a collection scan.
+ *
+ * Each phase keeps a log-linear histogram of its durations, so percentiles are cheap to
+ * record and have a bounded error (about 6%) regardless of the collection size.
+ * Not thread-safe, it belongs to the scanner thread.
+ */
+class ScanTelemetry {
+public:
+    enum Phase {
+        Fingerprint,
+        Walk,
+        Tags,
+        LocalCover,
+        EmbeddedCover,
+        ArtistInfo,
+        AlbumInfo,
+        TrackInsert,
+        PhaseCount
+    };
+
+    enum Queue { FileQueue, ArtistQueue, AlbumQueue, QueueCount };
+
+    // Records the lifetime of the object as one sample of a phase
+    class Timer {
+    public:
+        Timer(ScanTelemetry &telemetry, Phase phase)
+            : telemetry(telemetry), phase(phase), start(telemetry.now()) {}
+        ~Timer() { telemetry.record(phase, telemetry.now() - start); }
+
+    private:
+        ScanTelemetry &telemetry;
+        const Phase phase;
+        const qint64 start;
+    };
+
+    void start(bool incremental);
+    qint64 now() const { return clock.nsecsElapsed(); }
+
+    void record(Phase phase, qint64 nsecs);
+    void sampleQueue(Queue queue, int depth);
+    // A file handed to TagLib
+    void addFile(qint64 bytes);
+
+    QVariantMap toVariantMap() const;
+    // JSON dump for offline comparison between runs
+    static bool save(const QVariantMap &telemetry, const QString &filename);
+
+private:
+    class Histogram {
+    public:
+        Histogram() { clear(); }
+        void clear();
+        void add(qint64 usecs);
+        qint64 percentile(double p) const;
+        qint64 getCount() const { return count; }
+        qint64 getTotal() const { return total; }
+        qint64 getMax() const { return max; }
+
+    private:
+        // 8 exact buckets, then 8 sub-buckets per power of two up to 2^40 usecs
+        enum { SubBuckets = 8, BucketCount = SubBuckets + 38 * SubBuckets };
+        static int bucketFor(qint64 usecs);
+        static qint64 bucketValue(int bucket);
+
+        quint32 buckets[BucketCount];
+        qint64 count = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+    };
+
+    struct QueueStats {
+        int current = 0;
+        int max = 0;
+        qint64 total = 0;
+        qint64 samples = 0;
+    };
+
+    QElapsedTimer clock;
+    bool incremental = false;
+    Histogram phases[PhaseCount];
+    QueueStats queues[QueueCount];
+    int files = 0;
+    qint64 bytes = 0;
+};
+
+#endif // SCANTELEMETRY_H
@@ -0,0 +1,77 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "stringmatcher.h"
+
+StringMatcher::StringMatcher() : states(1) {}
+
+void StringMatcher::addPattern(const QString &pattern, int value) {
+    if (pattern.isEmpty()) return;
+    int state = 0;
+    for (const QChar c : pattern) {
+        const ushort key = fold(c);
+        int target = states.at(state).transitions.value(key, -1);
+        if (target < 0) {
+            target = states.size();
+            states.append(State());
+            states[state].transitions.insert(key, target);
+        }
+        state = target;
+    }
+    // first one wins on duplicates
+    if (states.at(state).output >= 0) return;
+    states[state].output = patterns.size();
+    patterns.append({pattern.length(), value});
+}
+
+void StringMatcher::build() {
+    // Breadth first, so failure links always point to states already done
+    QQueue<int> queue;
+    for (int child : qAsConst(states.at(0).transitions))
+        queue.enqueue(child);
+
+    while (!queue.isEmpty()) {
+        const int state = queue.dequeue();
+        const auto &transitions = states.at(state).transitions;
+        for (auto i = transitions.constBegin(); i != transitions.constEnd(); ++i) {
+            const int child = i.value();
+            int failure = states.at(state).failure;
+            while (failure > 0 && !states.at(failure).transitions.contains(i.key()))
+                failure = states.at(failure).failure;
+            failure = states.at(failure).transitions.value(i.key(), 0);
+            if (failure == child) failure = 0;
+
+            State &s = states[child];
+            s.failure = failure;
+            s.outputLink = states.at(failure).output >= 0 ? failure : states.at(failure).outputLink;
+            queue.enqueue(child);
+        }
+    }
+}
+
+int StringMatcher::next(int state, ushort c) const {
+    while (true) {
+        const State &s = states.at(state);
+        auto i = s.transitions.constFind(c);
+        if (i != s.transitions.constEnd()) return i.value();
+        if (state == 0) return 0;
+        state = s.failure;
+    }
+}
@@ -0,0 +1,82 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef STRINGMATCHER_H
+#define STRINGMATCHER_H
+
+#include <QtCore>
+
+/**
+ * Case-insensitive multi-pattern substring matcher (Aho-Corasick).
+ * Finds all the occurrences of all the patterns in a single pass over the text.
+ * Once built it is immutable and can be shared between threads.
+ */
+class StringMatcher {
+public:
+    StringMatcher();
+
+    // Every pattern carries a value that is handed back with its matches
+    void addPattern(const QString &pattern, int value);
+    void build();
+    bool isEmpty() const { return patterns.isEmpty(); }
+
+    /**
+     * Calls onMatch(int start, int length, int value) for every occurrence,
+     * ordered by end position and, for the same end, from the longest.
+     */
+    template <typename F> void match(const QStringRef &text, F onMatch) const {
+        int state = 0;
+        for (int i = 0; i < text.length(); ++i) {
+            state = next(state, fold(text.at(i)));
+            for (int s = states.at(state).output >= 0 ? state : states.at(state).outputLink;
+                 s > 0; s = states.at(s).outputLink) {
+                const Pattern &pattern = patterns.at(states.at(s).output);
+                onMatch(i - pattern.length + 1, pattern.length, pattern.value);
+            }
+        }
+    }
+
+    template <typename F> void match(const QString &text, F onMatch) const {
+        match(QStringRef(&text), onMatch);
+    }
+
+private:
+    struct Pattern {
+        int length;
+        int value;
+    };
+
+    struct State {
+        QHash<ushort, int> transitions;
+        int failure = 0;
+        // pattern ending here, or -1
+        int output = -1;
+        // closest state down the failure chain with an output
+        int outputLink = 0;
+    };
+
+    static ushort fold(QChar c) { return c.toCaseFolded().unicode(); }
+    int next(int state, ushort c) const;
+
+    QVector<State> states;
+    QVector<Pattern> patterns;
+};
+
+#endif // STRINGMATCHER_H
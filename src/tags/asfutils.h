@@ -19,49 +19,56 @@ QString string(const TagLib::ASF::AttributeListMap &map, const TagLib::String &k
     return QString();
 }
 
-void load(TagLib::ASF::Tag *tag, Tags *tags) {
+// Only the attributes asked for are decoded
+void load(TagLib::ASF::Tag *tag, int fields, Tags *tags) {
     const TagLib::ASF::AttributeListMap &map = tag->attributeListMap();
 
-    if (map.contains("WM/TrackNumber")) {
-        const TagLib::ASF::AttributeList &al = map["WM/TrackNumber"];
-        if (!al.isEmpty()) {
-            const TagLib::ASF::Attribute &a = al.front();
-            if (a.type() == TagLib::ASF::Attribute::UnicodeType) {
-                QString track = TagUtils::qString(a.toString());
-                TagUtils::parseTrackString(track, tags);
+    if (fields & TagUtils::NumberFields) {
+        if (map.contains("WM/TrackNumber")) {
+            const TagLib::ASF::AttributeList &al = map["WM/TrackNumber"];
+            if (!al.isEmpty()) {
+                const TagLib::ASF::Attribute &a = al.front();
+                if (a.type() == TagLib::ASF::Attribute::UnicodeType)
+                    TagUtils::parseTrackString(a.toString(), tags);
             }
         }
-    }
 
-    if (map.contains("WM/PartOfSet")) {
-        const TagLib::ASF::AttributeList &al = map["WM/PartOfSet"];
-        if (!al.isEmpty()) {
-            const TagLib::ASF::Attribute &a = al.front();
-            if (a.type() == TagLib::ASF::Attribute::UnicodeType) {
-                QString disk = TagUtils::qString(a.toString());
-                TagUtils::parseDiskString(disk, tags);
-            } else {
-                int diskNumber = a.toUInt();
-                if (diskNumber > 0) tags->setDiskNumber(diskNumber);
+        if (map.contains("WM/PartOfSet")) {
+            const TagLib::ASF::AttributeList &al = map["WM/PartOfSet"];
+            if (!al.isEmpty()) {
+                const TagLib::ASF::Attribute &a = al.front();
+                if (a.type() == TagLib::ASF::Attribute::UnicodeType) {
+                    TagUtils::parseDiskString(a.toString(), tags);
+                } else {
+                    int diskNumber = a.toUInt();
+                    if (diskNumber > 0) tags->setDiskNumber(diskNumber);
+                }
             }
         }
     }
 
-    tags->setComposer(string(map, "WM/Composer"));
-    tags->setComposerSort(string(map, "WM/ComposerSortOrder"));
+    if (fields & TagUtils::ComposerFields) {
+        tags->setComposer(string(map, "WM/Composer"));
+        tags->setComposerSort(string(map, "WM/ComposerSortOrder"));
+    }
 
-    tags->setAlbumArtist(string(map, "WM/AlbumArtist"));
-    tags->setAlbumArtistSort(string(map, "WM/AlbumArtistSortOrder"));
+    if (fields & TagUtils::AlbumArtistField)
+        tags->setAlbumArtist(string(map, "WM/AlbumArtist"));
 
-    tags->setArtistSort(string(map, "WM/ArtistSortOrder"));
+    if (fields & TagUtils::SortFields) {
+        tags->setAlbumArtistSort(string(map, "WM/AlbumArtistSortOrder"));
+        tags->setArtistSort(string(map, "WM/ArtistSortOrder"));
+    }
 
-    tags->setLyrics(string(map, "WM/Lyrics"));
+    if (fields & TagUtils::LyricsField) tags->setLyrics(string(map, "WM/Lyrics"));
 
-    if (map.contains("WM/IsCompilation")) {
-        const TagLib::ASF::AttributeList &al = map["WM/IsCompilation"];
-        if (!al.isEmpty()) {
-            bool v = al.front().toBool();
-            tags->setCompilation(v);
+    if (fields & TagUtils::CompilationField) {
+        if (map.contains("WM/IsCompilation")) {
+            const TagLib::ASF::AttributeList &al = map["WM/IsCompilation"];
+            if (!al.isEmpty()) {
+                bool v = al.front().toBool();
+                tags->setCompilation(v);
+            }
         }
     }
 
@@ -48,45 +48,71 @@ QHash<const char*, QString> initId3v2FrameMap() {
     return map;
 }
 
-void load(TagLib::ID3v2::Tag *tag, Tags *tags) {
+// Only the frames asked for are decoded
+void load(TagLib::ID3v2::Tag *tag, int fields, Tags *tags) {
     const TagLib::ID3v2::FrameListMap& map = tag->frameListMap();
 
-    if (!map["TRCK"].isEmpty()) {
-        const QString track = TagUtils::qString(map["TRCK"].front()->toString()).trimmed();
-        TagUtils::parseTrackString(track, tags);
-    }
-
-    if (!map["TPOS"].isEmpty()) {
-        const QString disk = TagUtils::qString(map["TPOS"].front()->toString()).trimmed();
-        TagUtils::parseDiskString(disk, tags);
+    if (fields & TagUtils::NumberFields) {
+        if (!map["TRCK"].isEmpty())
+            TagUtils::parseTrackString(map["TRCK"].front()->toString(), tags);
+        if (!map["TPOS"].isEmpty())
+            TagUtils::parseDiskString(map["TPOS"].front()->toString(), tags);
     }
 
     // TODO if (!map["TBPM"].isEmpty())
 
-    if (!map["TCOM"].isEmpty())
-        tags->setComposer(TagUtils::qString(map["TCOM"].front()->toString()));
-    if (!map["TSOC"].isEmpty())
-        tags->setComposerSort(TagUtils::qString(map["TSOC"].front()->toString()));
+    if (fields & TagUtils::ComposerFields) {
+        if (!map["TCOM"].isEmpty())
+            tags->setComposer(TagUtils::qString(map["TCOM"].front()->toString()));
+        if (!map["TSOC"].isEmpty())
+            tags->setComposerSort(TagUtils::qString(map["TSOC"].front()->toString()));
+    }
 
-    if (!map["TSOP"].isEmpty())
-        tags->setArtistSort(TagUtils::qString(map["TSOP"].front()->toString()));
+    if (fields & TagUtils::SortFields) {
+        if (!map["TSOP"].isEmpty())
+            tags->setArtistSort(TagUtils::qString(map["TSOP"].front()->toString()));
+        if (!map["TSO2"].isEmpty())
+            tags->setAlbumArtistSort(TagUtils::qString(map["TSO2"].front()->toString()));
+    }
 
-    if (!map["TPE2"].isEmpty())
-        tags->setAlbumArtist(TagUtils::qString(map["TPE2"].front()->toString()));
-    if (!map["TSO2"].isEmpty())
-        tags->setAlbumArtistSort(TagUtils::qString(map["TSO2"].front()->toString()));
+    if (fields & TagUtils::AlbumArtistField) {
+        if (!map["TPE2"].isEmpty())
+            tags->setAlbumArtist(TagUtils::qString(map["TPE2"].front()->toString()));
+    }
 
     // if (!map["TIT1"].isEmpty())  // content group
 
-    if (!map["TCMP"].isEmpty())
-        tags->setCompilation(TagUtils::qString(map["TCMP"].front()->toString()).toInt());
+    if (fields & TagUtils::CompilationField) {
+        if (!map["TCMP"].isEmpty())
+            tags->setCompilation(map["TCMP"].front()->toString().toInt());
+    }
+
+    if (fields & TagUtils::LyricsField) {
+        TagLib::ID3v2::UnsynchronizedLyricsFrame* frame =
+                TagLib::ID3v2::UnsynchronizedLyricsFrame::findByDescription(tag, "LYRICS");
+        // Most taggers leave the description empty
+        if (!frame && !map["USLT"].isEmpty())
+            frame = static_cast<TagLib::ID3v2::UnsynchronizedLyricsFrame*>(map["USLT"].front());
+        if (frame) {
+            TagLib::String lyrics = frame->text();
+            if (!lyrics.isEmpty()) tags->setLyrics(TagUtils::qString(lyrics));
+        }
+    }
+}
 
-    TagLib::ID3v2::UnsynchronizedLyricsFrame* frame =
-            TagLib::ID3v2::UnsynchronizedLyricsFrame::findByDescription(tag, "LYRICS");
-    if (frame) {
-        TagLib::String lyrics = frame->text();
-        if (!lyrics.isEmpty()) tags->setLyrics(TagUtils::qString(lyrics));
+// The front cover if any, otherwise the first picture
+QByteArray cover(TagLib::ID3v2::Tag *tag) {
+    const TagLib::ID3v2::FrameList &list = tag->frameListMap()["APIC"];
+    TagLib::ID3v2::AttachedPictureFrame *picture = nullptr;
+    for (TagLib::ID3v2::Frame *frame : list) {
+        auto *f = static_cast<TagLib::ID3v2::AttachedPictureFrame*>(frame);
+        if (!picture || f->type() == TagLib::ID3v2::AttachedPictureFrame::FrontCover)
+            picture = f;
+        if (f->type() == TagLib::ID3v2::AttachedPictureFrame::FrontCover) break;
     }
+    if (!picture) return QByteArray();
+    const TagLib::ByteVector &data = picture->picture();
+    return QByteArray(data.data(), data.size());
 }
 
 }
@@ -8,56 +8,69 @@
 
 namespace Mp4Utils {
 
-void load(TagLib::MP4::Tag *tag, Tags *tags) {
+// Only the items asked for are decoded
+void load(TagLib::MP4::Tag *tag, int fields, Tags *tags) {
     const TagLib::MP4::ItemListMap &map = tag->itemListMap();
 
-    if (map.contains("trkn")) {
-        TagLib::MP4::Item::IntPair intPair = map["trkn"].toIntPair();
-        tags->setTrackNumber(intPair.first);
-        tags->setTrackCount(intPair.second);
-    }
-    if (map.contains("disk")) {
-        TagLib::MP4::Item::IntPair intPair = map["disk"].toIntPair();
-        tags->setDiskNumber(intPair.first);
-        tags->setDiskCount(intPair.second);
+    if (fields & TagUtils::NumberFields) {
+        if (map.contains("trkn")) {
+            TagLib::MP4::Item::IntPair intPair = map["trkn"].toIntPair();
+            tags->setTrackNumber(intPair.first);
+            tags->setTrackCount(intPair.second);
+        }
+        if (map.contains("disk")) {
+            TagLib::MP4::Item::IntPair intPair = map["disk"].toIntPair();
+            tags->setDiskNumber(intPair.first);
+            tags->setDiskCount(intPair.second);
+        }
     }
 
-    if (map.contains("\251wrt")) {
-        QString v = TagUtils::qString(map["\251wrt"].toStringList().toString(", "));
-        tags->setComposer(v);
-    }
-    if (map.contains("soco")) {
-        QString v = TagUtils::qString(map["soco"].toStringList().toString(", "));
-        tags->setComposerSort(v);
+    if (fields & TagUtils::ComposerFields) {
+        if (map.contains("\251wrt")) {
+            QString v = TagUtils::qString(map["\251wrt"].toStringList().toString(", "));
+            tags->setComposer(v);
+        }
+        if (map.contains("soco")) {
+            QString v = TagUtils::qString(map["soco"].toStringList().toString(", "));
+            tags->setComposerSort(v);
+        }
     }
 
-    TagLib::MP4::ItemListMap::ConstIterator it = map.find("aART");
-    if (it != map.end()) {
-        TagLib::StringList sl = it->second.toStringList();
-        if (!sl.isEmpty())
-            tags->setAlbumArtist(TagUtils::qString(sl.front()));
-    }
-    if (map.contains("soaa")) {
-        TagLib::StringList sl = map["soaa"].toStringList();
-        if (!sl.isEmpty())
-            tags->setAlbumArtistSort(TagUtils::qString(sl.front()));
+    if (fields & TagUtils::AlbumArtistField) {
+        TagLib::MP4::ItemListMap::ConstIterator it = map.find("aART");
+        if (it != map.end()) {
+            TagLib::StringList sl = it->second.toStringList();
+            if (!sl.isEmpty())
+                tags->setAlbumArtist(TagUtils::qString(sl.front()));
+        }
     }
 
-    if (map.contains("soar")) {
-        TagLib::StringList sl = map["soar"].toStringList();
-        if (!sl.isEmpty())
-            tags->setArtistSort(TagUtils::qString(sl.front()));
+    if (fields & TagUtils::SortFields) {
+        if (map.contains("soaa")) {
+            TagLib::StringList sl = map["soaa"].toStringList();
+            if (!sl.isEmpty())
+                tags->setAlbumArtistSort(TagUtils::qString(sl.front()));
+        }
+        if (map.contains("soar")) {
+            TagLib::StringList sl = map["soar"].toStringList();
+            if (!sl.isEmpty())
+                tags->setArtistSort(TagUtils::qString(sl.front()));
+        }
     }
 
-    if (map.contains("©lyr")) {
-        TagLib::StringList sl = map["©lyr"].toStringList();
-        if (!sl.isEmpty())
-            tags->setLyrics(TagUtils::qString(sl.front()));
+    if (fields & TagUtils::LyricsField) {
+        if (map.contains("\251lyr")) {
+            TagLib::StringList sl = map["\251lyr"].toStringList();
+            if (!sl.isEmpty())
+                tags->setLyrics(TagUtils::qString(sl.front()));
+        }
     }
 
-    if (map.contains("cpil")) {
-        bool v = map["cpil"].toBool();
-        tags->setCompilation(v);
+    if (fields & TagUtils::CompilationField) {
+        if (map.contains("cpil")) {
+            bool v = map["cpil"].toBool();
+            tags->setCompilation(v);
+        }
     }
 
     /*
@@ -68,6 +81,15 @@ void load(TagLib::MP4::Tag *tag, Tags *tags) {
     */
 }
 
+QByteArray cover(TagLib::MP4::Tag *tag) {
+    const TagLib::MP4::ItemListMap &map = tag->itemListMap();
+    if (!map.contains("covr")) return QByteArray();
+    const TagLib::MP4::CoverArtList covers = map["covr"].toCoverArtList();
+    if (covers.isEmpty()) return QByteArray();
+    const TagLib::ByteVector data = covers.front().data();
+    return QByteArray(data.data(), data.size());
+}
+
 }
 
 #endif // MP4UTILS
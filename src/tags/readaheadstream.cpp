@@ -0,0 +1,137 @@
+#include "readaheadstream.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// ID3v2, Vorbis comments, FLAC pictures and small covers are at the start
+const qint64 headSize = 256 * 1024;
+// ID3v1, APE footers and the MP4 moov atom of files written by some encoders
+const qint64 tailSize = 64 * 1024;
+// Reads anywhere else, like the MPEG frame scan or a big cover
+const qint64 windowSize = 128 * 1024;
+
+} // namespace
+
+QAtomicInteger<qint64> ReadAheadStream::blockReadCount;
+QAtomicInteger<qint64> ReadAheadStream::fileReadCount;
+
+ReadAheadStream::ReadAheadStream(const QString &filename)
+    : encodedName(QFile::encodeName(filename)), fd(-1), size(0), position(0) {
+    fd = open(encodedName.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+    size = st.st_size;
+
+#ifdef POSIX_FADV_RANDOM
+    // Kernel read-ahead would fetch audio data we never look at, we do our own.
+    // The tail is prefetched while the head is being parsed.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    if (size > headSize)
+        posix_fadvise(fd, qMax(headSize, size - tailSize), tailSize, POSIX_FADV_WILLNEED);
+#endif
+
+    fill(head, 0, qMin(size, headSize));
+}
+
+ReadAheadStream::~ReadAheadStream() {
+    if (fd >= 0) close(fd);
+}
+
+TagLib::FileName ReadAheadStream::name() const {
+    return encodedName.constData();
+}
+
+qint64 ReadAheadStream::readAt(char *data, qint64 offset, qint64 length) {
+    qint64 done = 0;
+    while (done < length) {
+        const ssize_t n = pread(fd, data + done, length - done, offset + done);
+        fileReadCount.fetchAndAddRelaxed(1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    return done;
+}
+
+bool ReadAheadStream::fill(Buffer &buffer, qint64 offset, qint64 length) {
+    buffer.offset = offset;
+    buffer.data.resize(int(length));
+    const qint64 read = readAt(buffer.data.data(), offset, length);
+    buffer.data.resize(int(read));
+    return read == length;
+}
+
+TagLib::ByteVector ReadAheadStream::readBlock(Length length) {
+    if (fd < 0 || length == 0 || position >= size) return TagLib::ByteVector();
+    blockReadCount.fetchAndAddRelaxed(1);
+
+    const qint64 wanted = qMin(qint64(length), size - position);
+    const Buffer *buffer = nullptr;
+    if (head.contains(position, wanted)) {
+        buffer = &head;
+    } else if (window.contains(position, wanted)) {
+        buffer = &window;
+    } else if (position >= size - tailSize) {
+        // the tail is read once, as a whole
+        if (tail.data.isEmpty()) fill(tail, qMax(qint64(0), size - tailSize), qMin(size, tailSize));
+        if (tail.contains(position, wanted)) buffer = &tail;
+    }
+
+    if (!buffer && wanted < windowSize) {
+        fill(window, position, qMin(windowSize, size - position));
+        if (window.contains(position, wanted)) buffer = &window;
+    }
+
+    TagLib::ByteVector data;
+    if (buffer) {
+        data = TagLib::ByteVector(buffer->data.constData() + (position - buffer->offset),
+                                  uint(wanted));
+    } else {
+        // bigger than a window, e.g. a cover: straight into the result
+        data.resize(uint(wanted));
+        data.resize(uint(readAt(data.data(), position, wanted)));
+    }
+    position += data.size();
+    return data;
+}
+
+void ReadAheadStream::writeBlock(const TagLib::ByteVector &) {
+    qWarning() << "ReadAheadStream is read-only" << encodedName;
+}
+
+void ReadAheadStream::insert(const TagLib::ByteVector &, Offset, Length) {
+    qWarning() << "ReadAheadStream is read-only" << encodedName;
+}
+
+void ReadAheadStream::removeBlock(Offset, Length) {
+    qWarning() << "ReadAheadStream is read-only" << encodedName;
+}
+
+void ReadAheadStream::seek(Offset offset, Position p) {
+    switch (p) {
+    case Beginning:
+        position = offset;
+        break;
+    case Current:
+        position += offset;
+        break;
+    case End:
+        position = size + offset;
+        break;
+    }
+    if (position < 0) position = 0;
+}
+
+void ReadAheadStream::truncate(Offset) {
+    qWarning() << "ReadAheadStream is read-only" << encodedName;
+}
@@ -0,0 +1,68 @@
+#ifndef READAHEADSTREAM_H
+#define READAHEADSTREAM_H
+
+#include <QtCore>
+
+#include <taglib.h>
+#include <tiostream.h>
+
+/**
+ * Read-only TagLib stream for POSIX systems. TagLib probes headers and frames with many
+ * small seeks and reads: here they are served from a few large reads of the head and the
+ * tail of the file, where tags live, and from a read-ahead window elsewhere.
+ * Each read is a single pread, there are no seek syscalls.
+ */
+class ReadAheadStream : public TagLib::IOStream {
+public:
+#if TAGLIB_MAJOR_VERSION >= 2
+    typedef TagLib::offset_t Offset;
+    typedef size_t Length;
+#else
+    typedef long Offset;
+    typedef unsigned long Length;
+#endif
+
+    ReadAheadStream(const QString &filename);
+    ~ReadAheadStream();
+
+    TagLib::FileName name() const override;
+    TagLib::ByteVector readBlock(Length length) override;
+    void writeBlock(const TagLib::ByteVector &data) override;
+    void insert(const TagLib::ByteVector &data, Offset start = 0, Length replace = 0) override;
+    void removeBlock(Offset start = 0, Length length = 0) override;
+    bool readOnly() const override { return true; }
+    bool isOpen() const override { return fd >= 0; }
+    void seek(Offset offset, Position p = Beginning) override;
+    Offset tell() const override { return position; }
+    Offset length() override { return size; }
+    void truncate(Offset length) override;
+
+    // Process-wide counters: the reads TagLib asked for and the preads they took
+    static qint64 blockReads() { return blockReadCount.loadAcquire(); }
+    static qint64 fileReads() { return fileReadCount.loadAcquire(); }
+
+private:
+    struct Buffer {
+        qint64 offset = 0;
+        QByteArray data;
+        bool contains(qint64 from, qint64 length) const {
+            return from >= offset && from + length <= offset + data.size();
+        }
+    };
+
+    bool fill(Buffer &buffer, qint64 offset, qint64 length);
+    qint64 readAt(char *data, qint64 offset, qint64 length);
+
+    const QByteArray encodedName;
+    int fd;
+    qint64 size;
+    qint64 position;
+    Buffer head;
+    Buffer tail;
+    Buffer window;
+
+    static QAtomicInteger<qint64> blockReadCount;
+    static QAtomicInteger<qint64> fileReadCount;
+};
+
+#endif // READAHEADSTREAM_H
@@ -10,12 +10,14 @@ class Tags : public QObject {
 public:
     Tags() :
         duration(0),
+        durationUncertain(false),
         compilation(false),
         trackNumber(0),
         trackCount(0),
         diskNumber(1),
         diskCount(1),
-        year(0)
+        year(0),
+        coverLoaded(false)
       // bpm(0)
     { }
 
@@ -24,6 +26,9 @@ public:
 
     int getDuration() const { return duration; }
     void setDuration(int value) { duration = value; }
+    // an estimate that can be way off, e.g. a VBR MP3 without a Xing header
+    bool isDurationUncertain() const { return durationUncertain; }
+    void setDurationUncertain(bool value) { durationUncertain = value; }
 
     const QString &getTitle() const { return title; }
     void setTitle(const QString &value) { title = value; }
@@ -76,9 +81,16 @@ public:
     QString getComment() const { return comment; }
     void setComment (const QString &value) { comment = value; }
 
+    // Embedded picture bytes, only when asked to TagUtils::load()
+    bool isCoverLoaded() const { return coverLoaded; }
+    const QByteArray &getCoverData() const { return coverData; }
+    void setCoverData(const QByteArray &value) { coverData = value; coverLoaded = true; }
+    void releaseCoverData() { coverData.clear(); }
+
 private:
     QString filename;
     int duration;
+    bool durationUncertain;
     QString title;
     QString albumString;
     QString artistString;
@@ -96,6 +108,8 @@ private:
     int year;
     QString lyrics;
     QString comment;
+    bool coverLoaded;
+    QByteArray coverData;
     // TODO int bpm;
 
 };
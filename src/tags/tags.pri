@@ -16,3 +16,9 @@ HEADERS += \
 SOURCES += \
     $$PWD/tagutils.cpp
 
+
+# Windows keeps TagLib::FileStream
+unix {
+    HEADERS += $$PWD/readaheadstream.h
+    SOURCES += $$PWD/readaheadstream.cpp
+}
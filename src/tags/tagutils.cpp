@@ -1,5 +1,7 @@
 #include "tagutils.h"
 
+#include <cstring>
+
 #include <tstring.h>
 #include <fileref.h>
 #include <tag.h>
@@ -13,7 +15,15 @@
 #include <mpcfile.h>
 #include <wavpackfile.h>
 #include <trueaudiofile.h>
+#include <mpegheader.h>
 #include <asffile.h>
+#include <vorbisfile.h>
+#include <oggflacfile.h>
+#include <id3v2framefactory.h>
+
+#ifndef Q_OS_WIN
+#include "readaheadstream.h"
+#endif
 
 #include "id3utils.h"
 #include "vorbisutils.h"
@@ -21,99 +31,392 @@
 #include "apeutils.h"
 #include "asfutils.h"
 
-Tags *TagUtils::load(const QString &filename) {
-#ifdef Q_OS_WIN
-    const wchar_t * encodedName = reinterpret_cast<const wchar_t*>(filename.utf16());
-    TagLib::FileStream readOnlyStream(encodedName, true);
-#else
-    TagLib::FileStream readOnlyStream((TagLib::FileName)filename.toUtf8(), true);
-#endif
+namespace {
 
-    TagLib::FileRef fileref(&readOnlyStream);
-    if (fileref.isNull()) {
-        qDebug() << "Taglib cannot parse" << filename;
-        return nullptr;
+enum Format {
+    UnknownFormat,
+    MpegFormat,
+    FlacFormat,
+    OggVorbisFormat,
+    OggFlacFormat,
+    Mp4Format,
+    ApeFormat,
+    MpcFormat,
+    WavPackFormat,
+    TrueAudioFormat,
+    AsfFormat
+};
+
+QString suffixOf(const QString &filename) {
+    const int dot = filename.lastIndexOf('.');
+    if (dot < 0) return QString();
+    return filename.mid(dot + 1).toLower();
+}
+
+Format formatFor(const QString &suffix) {
+    static const QHash<QString, Format> formats = [] {
+        QHash<QString, Format> map;
+        map.insert("mp3", MpegFormat);
+        map.insert("mp2", MpegFormat);
+        map.insert("flac", FlacFormat);
+        map.insert("ogg", OggVorbisFormat);
+        map.insert("oga", OggFlacFormat);
+        map.insert("m4a", Mp4Format);
+        map.insert("m4b", Mp4Format);
+        map.insert("m4p", Mp4Format);
+        map.insert("mp4", Mp4Format);
+        map.insert("ape", ApeFormat);
+        map.insert("mpc", MpcFormat);
+        map.insert("wv", WavPackFormat);
+        map.insert("tta", TrueAudioFormat);
+        map.insert("wma", AsfFormat);
+        map.insert("asf", AsfFormat);
+        return map;
+    }();
+    return formats.value(suffix, UnknownFormat);
+}
+
+// The other extensions TagLib::FileRef resolves, read by loadAnyFormat()
+bool isFileRefSuffix(const QString &suffix) {
+    static const QSet<QString> suffixes = {"spx", "opus", "m4r", "m4v", "3g2", "wav",
+                                           "aif", "aiff", "afc", "aifc", "mod", "module",
+                                           "nst", "wow", "s3m", "it",   "xm"};
+    return suffixes.contains(suffix);
+}
+
+bool startsWith(const TagLib::ByteVector &data, uint offset, const char *magic, uint length) {
+    return data.size() >= offset + length && memcmp(data.data() + offset, magic, length) == 0;
+}
+
+// A single MPEG audio frame header, with no reserved or free format values
+bool isMpegFrameHeader(const TagLib::ByteVector &data) {
+    if (data.size() < 4) return false;
+    const uchar *h = reinterpret_cast<const uchar *>(data.data());
+    if (h[0] != 0xff || (h[1] & 0xe0) != 0xe0) return false;
+    const int version = (h[1] >> 3) & 0x3;
+    const int layer = (h[1] >> 1) & 0x3;
+    const int bitrate = h[2] >> 4;
+    const int sampleRate = (h[2] >> 2) & 0x3;
+    return version != 1 && layer != 0 && bitrate != 0 && bitrate != 0xf && sampleRate != 3;
+}
+
+// Tracker modules keep their signature after the song name and sample table
+const uint sniffSize = 1084;
+
+bool isModule(const TagLib::ByteVector &head) {
+    static const char *const modSignatures[] = {"M.K.", "M!K!", "M&K!", "N.T.", "FLT4",
+                                                "FLT8", "4CHN", "6CHN", "8CHN", "CD81",
+                                                "OKTA", "OCTA"};
+    if (startsWith(head, 0, "Extended Module:", 16) || startsWith(head, 0, "IMPM", 4) ||
+        startsWith(head, 44, "SCRM", 4))
+        return true;
+    for (const char *signature : modSignatures) {
+        if (startsWith(head, 1080, signature, 4)) return true;
     }
+    return false;
+}
 
-    Tags *tags = new Tags();
-    tags->setFilename(filename);
+/**
+ * Content sniffing of the first bytes of a file: true for the containers TagLib reads.
+ * Cheap enough to reject sidecar files, scans and other binaries before any parsing.
+ */
+bool looksLikeAudio(const TagLib::ByteVector &head) {
+    static const char asfGuid[] = "\x30\x26\xb2\x75\x8e\x66\xcf\x11"
+                                  "\xa6\xd9\x00\xaa\x00\x62\xce\x6c";
+    // ID3v2 is in front of MPEG streams and sometimes of other formats
+    return startsWith(head, 0, "ID3", 3) || startsWith(head, 0, "fLaC", 4) ||
+           startsWith(head, 0, "OggS", 4) || startsWith(head, 4, "ftyp", 4) ||
+           startsWith(head, 0, "MAC ", 4) || startsWith(head, 0, "wvpk", 4) ||
+           startsWith(head, 0, "TTA1", 4) || startsWith(head, 0, "MPCK", 4) ||
+           startsWith(head, 0, "MP+", 3) || startsWith(head, 0, asfGuid, 16) ||
+           (startsWith(head, 0, "RIFF", 4) && startsWith(head, 8, "WAVE", 4)) ||
+           (startsWith(head, 0, "FORM", 4) &&
+            (startsWith(head, 8, "AIFF", 4) || startsWith(head, 8, "AIFC", 4))) ||
+           isMpegFrameHeader(head) || isModule(head);
+}
 
-    TagLib::Tag *tag = fileref.tag();
+// The fields every format has
+void loadCommon(TagLib::File *file, int fields, Tags *tags) {
+    TagLib::Tag *tag = file->tag();
     if (tag) {
-        tags->setTitle(TagUtils::qString(tag->title()));
-        tags->setArtistString(TagUtils::qString(tag->artist()));
-        tags->setAlbumString(TagUtils::qString(tag->album()));
-        tags->setGenre(TagUtils::qString(tag->genre()));
-        tags->setTrackNumber(tag->track());
-        tags->setYear(tag->year());
-        tags->setComment(TagUtils::qString(tag->comment()));
-        TagLib::AudioProperties *audioProperties = fileref.audioProperties();
-        if (audioProperties)
-            tags->setDuration(audioProperties->length());
-    }
-
-    /*
-    TagLib::PropertyMap map = tag->properties();
-    for (TagLib::PropertyMap::ConstIterator i = map.begin(); i != map.end(); ++i) {
-        for (TagLib::StringList::ConstIterator j = i->second.begin(); j != i->second.end(); ++j) {
-            const QString tagName = TagLibUtils::toQString(i->first);
-            qDebug() << "PropertyMap" << tagName << TagLibUtils::toQString(*j);
-            if (tagName == QLatin1String("ALBUMARTIST"))
-                tags->setAlbumArtist(TagLibUtils::toQString(*j));
-            else if (tagName == QLatin1String("DISCNUMBER"))
-                tags->setDiskNumber(TagLibUtils::toQString(*j).toInt());
-            // else if (tagName == QLatin1String("COMPOSER"))
-            // tags->setComposer(toQString(*j));
-            else if (tagName == QLatin1String("LYRICS"))
-                tags->setLyrics(TagLibUtils::toQString(*j));
-            //else if (tagName == QLatin1String("BPM"))
-            //    tags->bpm = toQString(*j).toInt();
-            // else qDebug() << "Unused tag" << tagName << toQString(*j);
+        if (fields & TagUtils::TitleField) tags->setTitle(TagUtils::qString(tag->title()));
+        if (fields & TagUtils::ArtistField)
+            tags->setArtistString(TagUtils::qString(tag->artist()));
+        if (fields & TagUtils::AlbumField) tags->setAlbumString(TagUtils::qString(tag->album()));
+        if (fields & TagUtils::GenreField) tags->setGenre(TagUtils::qString(tag->genre()));
+        if (fields & TagUtils::NumberFields) {
+            tags->setTrackNumber(tag->track());
+            tags->setYear(tag->year());
         }
+        if (fields & TagUtils::CommentField)
+            tags->setComment(TagUtils::qString(tag->comment()));
+    }
+    if (fields & TagUtils::DurationField) {
+        TagLib::AudioProperties *audioProperties = file->audioProperties();
+        if (audioProperties) tags->setDuration(audioProperties->length());
     }
-    */
+}
 
-    // Handle file types where TagLibf:::File::tag() returns a "TagUnion"
-    TagLib::File *file = fileref.file();
+TagLib::AudioProperties::ReadStyle readStyle(int fields) {
+    if (fields & TagUtils::FastDuration) return TagLib::AudioProperties::Fast;
+    if (fields & TagUtils::AccurateDuration) return TagLib::AudioProperties::Accurate;
+    return TagLib::AudioProperties::Average;
+}
+
+// Sums the samples of every frame, reads a header per frame.
+// -1 when the thread is asked to stop, a long file on a network mount takes a while.
+int mpegDuration(TagLib::MPEG::File &file) {
+    const long long end = file.lastFrameOffset();
+    long long offset = file.firstFrameOffset();
+    qint64 samples = 0;
+    int sampleRate = 0;
+    int frames = 0;
+    while (offset >= 0 && offset <= end) {
+        if (++frames % 256 == 0 && QThread::currentThread()->isInterruptionRequested())
+            return -1;
+        const TagLib::MPEG::Header header(&file, offset, false);
+        if (!header.isValid() || header.frameLength() <= 0) {
+            offset = file.nextFrameOffset(offset + 1);
+            continue;
+        }
+        samples += header.samplesPerFrame();
+        sampleRate = header.sampleRate();
+        offset += header.frameLength();
+    }
+    if (sampleRate <= 0) return 0;
+    return int((samples + sampleRate / 2) / sampleRate);
+}
+
+/**
+ * Without a VBR header TagLib divides the stream length by the bitrate of the first frame.
+ * That is exact for CBR streams: a few frames across the file must have the same bitrate,
+ * and the span from the first to the last frame must give the same length.
+ */
+bool isMpegEstimateExact(TagLib::MPEG::File &file, const TagLib::AudioProperties *properties) {
+    const long long first = file.firstFrameOffset();
+    const long long last = file.lastFrameOffset();
+    if (first < 0 || last < first) return false;
+    const TagLib::MPEG::Header firstHeader(&file, first, false);
+    if (!firstHeader.isValid() || firstHeader.bitrate() <= 0) return false;
+
+    const long long span = last - first;
+    for (long long position : {first + span / 4, first + span / 2, first + span * 3 / 4, last}) {
+        const long long offset = position == last ? last : file.nextFrameOffset(position);
+        if (offset < 0) return false;
+        const TagLib::MPEG::Header header(&file, offset, false);
+        if (!header.isValid() || header.bitrate() != firstHeader.bitrate() ||
+            header.sampleRate() != firstHeader.sampleRate())
+            return false;
+    }
+
+    const TagLib::MPEG::Header lastHeader(&file, last, false);
+    const qint64 frameSpan = span + lastHeader.frameLength();
+    const qint64 spanMsecs = frameSpan * 8 / firstHeader.bitrate();
+    return qAbs(spanMsecs - properties->lengthInMilliseconds()) < 1000;
+}
+
+QByteArray flacCover(TagLib::FLAC::File &file) {
+    const TagLib::List<TagLib::FLAC::Picture *> pictures = file.pictureList();
+    TagLib::FLAC::Picture *picture = nullptr;
+    for (TagLib::FLAC::Picture *p : pictures) {
+        if (!picture || p->type() == TagLib::FLAC::Picture::FrontCover) picture = p;
+        if (p->type() == TagLib::FLAC::Picture::FrontCover) break;
+    }
+    if (picture) return QByteArray(picture->data().data(), picture->data().size());
+    if (TagLib::ID3v2::Tag *t = file.ID3v2Tag()) return Id3Utils::cover(t);
+    return QByteArray();
+}
+
+// Dispatches on the file extension, so there is a single open and no probing
+bool loadFormat(Format format, TagLib::IOStream *stream, int fields, Tags *tags) {
+    // Audio properties can take extra reads, MPEG may even scan for frames
+    const bool properties = fields & TagUtils::DurationField;
+    const bool withCover = fields & TagUtils::CoverField;
+    const TagLib::AudioProperties::ReadStyle style = readStyle(fields);
+    switch (format) {
+    case MpegFormat: {
+        TagLib::MPEG::File f(stream, TagLib::ID3v2::FrameFactory::instance(), properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::ID3v2::Tag *t = f.ID3v2Tag()) {
+            Id3Utils::load(t, fields, tags);
+            if (withCover) tags->setCoverData(Id3Utils::cover(t));
+        }
+        if (properties && f.audioProperties() && !f.audioProperties()->xingHeader() &&
+            !isMpegEstimateExact(f, f.audioProperties())) {
+            // guessed from the bitrate of the first frame, way off for VBR streams
+            const int duration = fields & TagUtils::AccurateDuration ? mpegDuration(f) : -1;
+            if (duration >= 0)
+                tags->setDuration(duration);
+            else
+                tags->setDurationUncertain(true);
+        }
+        return true;
+    }
+
+    case FlacFormat: {
+        TagLib::FLAC::File f(stream, TagLib::ID3v2::FrameFactory::instance(), properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::Ogg::XiphComment *t = f.xiphComment()) {
+            VorbisUtils::load(t, fields, tags);
+        } else if (TagLib::ID3v2::Tag *t = f.ID3v2Tag())
+            Id3Utils::load(t, fields, tags);
+        if (withCover) {
+            QByteArray cover = flacCover(f);
+            if (cover.isEmpty() && f.xiphComment()) cover = VorbisUtils::cover(f.xiphComment());
+            tags->setCoverData(cover);
+        }
+        return true;
+    }
+
+    case OggVorbisFormat: {
+        TagLib::Ogg::Vorbis::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::Ogg::XiphComment *t = f.tag()) {
+            VorbisUtils::load(t, fields, tags);
+            if (withCover) tags->setCoverData(VorbisUtils::cover(t));
+        }
+        return true;
+    }
+
+    case OggFlacFormat: {
+        TagLib::Ogg::FLAC::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::Ogg::XiphComment *t = f.tag()) {
+            VorbisUtils::load(t, fields, tags);
+            if (withCover) tags->setCoverData(VorbisUtils::cover(t));
+        }
+        return true;
+    }
+
+    case Mp4Format: {
+        TagLib::MP4::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::MP4::Tag *t = f.tag()) {
+            Mp4Utils::load(t, fields, tags);
+            if (withCover) tags->setCoverData(Mp4Utils::cover(t));
+        }
+        return true;
+    }
+
+    case ApeFormat: {
+        TagLib::APE::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::APE::Tag *t = f.APETag()) ApeUtils::load(t, fields, tags);
+        return true;
+    }
+
+    case MpcFormat: {
+        TagLib::MPC::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::APE::Tag *t = f.APETag()) ApeUtils::load(t, fields, tags);
+        return true;
+    }
+
+    case WavPackFormat: {
+        TagLib::WavPack::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::APE::Tag *t = f.APETag()) ApeUtils::load(t, fields, tags);
+        return true;
+    }
+
+    case TrueAudioFormat: {
+        TagLib::TrueAudio::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::ID3v2::Tag *t = f.ID3v2Tag()) Id3Utils::load(t, fields, tags);
+        return true;
+    }
+
+    case AsfFormat: {
+        TagLib::ASF::File f(stream, properties, style);
+        if (!f.isValid()) return false;
+        loadCommon(&f, fields, tags);
+        if (TagLib::ASF::Tag *t = f.tag()) AsfUtils::load(t, fields, tags);
+        return true;
+    }
+
+    case UnknownFormat:
+        break;
+    }
+    return false;
+}
 
-    if (TagLib::MPEG::File *f = dynamic_cast<TagLib::MPEG::File*>(file)) {
-        if (TagLib::ID3v2::Tag *t = f->ID3v2Tag()) Id3Utils::load(t, tags);
+// Content detection for unknown or mislabeled files
+bool loadAnyFormat(TagLib::IOStream *stream, int fields, Tags *tags) {
+    stream->seek(0);
+    TagLib::FileRef fileref(stream, fields & TagUtils::DurationField, readStyle(fields));
+    if (fileref.isNull()) return false;
 
-    } else if (TagLib::TrueAudio::File *f = dynamic_cast<TagLib::TrueAudio::File*>(file)) {
-        if (TagLib::ID3v2::Tag *t = f->ID3v2Tag()) Id3Utils::load(t, tags);
+    TagLib::File *file = fileref.file();
+    loadCommon(file, fields, tags);
 
-    } else if (TagLib::FLAC::File *f = dynamic_cast<TagLib::FLAC::File*>(file)) {
-        if (TagLib::Ogg::XiphComment *t = f->xiphComment()) VorbisUtils::load(t, tags);
-        else if (TagLib::ID3v2::Tag *t = f->ID3v2Tag()) Id3Utils::load(t, tags);
+    TagLib::Tag *tag = file->tag();
 
-    } else if (TagLib::APE::File *f = dynamic_cast<TagLib::APE::File*>(file)) {
-        if (TagLib::APE::Tag *t = f->APETag()) ApeUtils::load(t, tags);
+    if (TagLib::ID3v2::Tag *t = dynamic_cast<TagLib::ID3v2::Tag*>(tag))
+        Id3Utils::load(t, fields, tags);
 
-    } else if (TagLib::MPC::File *f = dynamic_cast<TagLib::MPC::File*>(file)) {
-        if (TagLib::APE::Tag *t = f->APETag()) ApeUtils::load(t, tags);
+    else if (TagLib::Ogg::XiphComment *t = dynamic_cast<TagLib::Ogg::XiphComment*>(tag))
+        VorbisUtils::load(t, fields, tags);
 
-    } else if (TagLib::WavPack::File *f = dynamic_cast<TagLib::WavPack::File*>(file)) {
-        if (TagLib::APE::Tag *t = f->APETag()) ApeUtils::load(t, tags);
+    else if (TagLib::APE::Tag *t = dynamic_cast<TagLib::APE::Tag*>(tag))
+        ApeUtils::load(t, fields, tags);
 
-    } else {
+    else if (TagLib::MP4::Tag *t = dynamic_cast<TagLib::MP4::Tag*>(tag))
+        Mp4Utils::load(t, fields, tags);
 
-        // Fallback to casting tag() for any other file type
-        TagLib::Tag *tag = file->tag();
+    else if (TagLib::ASF::Tag *t = dynamic_cast<TagLib::ASF::Tag*>(tag))
+        AsfUtils::load(t, fields, tags);
 
-        if (TagLib::ID3v2::Tag *t = dynamic_cast<TagLib::ID3v2::Tag*>(tag))
-            Id3Utils::load(t, tags);
+    return true;
+}
 
-        else if (TagLib::Ogg::XiphComment *t = dynamic_cast<TagLib::Ogg::XiphComment*>(tag))
-            VorbisUtils::load(t, tags);
+} // namespace
 
-        else if (TagLib::APE::Tag *t = dynamic_cast<TagLib::APE::Tag*>(tag))
-            ApeUtils::load(t, tags);
+Tags *TagUtils::load(const QString &filename, int fields) {
+#ifdef Q_OS_WIN
+    const wchar_t * encodedName = reinterpret_cast<const wchar_t*>(filename.utf16());
+    TagLib::FileStream readOnlyStream(encodedName, true);
+#else
+    // a few large reads instead of a seek and a read per header or frame probe
+    ReadAheadStream readOnlyStream(filename);
+#endif
+    if (!readOnlyStream.isOpen()) {
+        qDebug() << "Cannot open" << filename;
+        return nullptr;
+    }
 
-        else if (TagLib::MP4::Tag *t = dynamic_cast<TagLib::MP4::Tag*>(tag))
-            Mp4Utils::load(t, tags);
+    const QString suffix = suffixOf(filename);
+    const Format format = formatFor(suffix);
+    // an audio extension is enough, e.g. MPEG streams may start with junk before the first frame
+    if ((fields & SkipNonAudio) && format == UnknownFormat && !isFileRefSuffix(suffix)) {
+        if (!looksLikeAudio(readOnlyStream.readBlock(sniffSize))) {
+            qDebug() << "Not an audio file" << filename;
+            return nullptr;
+        }
+        readOnlyStream.seek(0);
+    }
 
-        else if (TagLib::ASF::Tag *t = dynamic_cast<TagLib::ASF::Tag*>(tag))
-            AsfUtils::load(t, tags);
+    Tags *tags = new Tags();
+    tags->setFilename(filename);
+
+    if (!loadFormat(format, &readOnlyStream, fields, tags)) {
+        // start over, a failed parse can leave partial values
+        delete tags;
+        tags = new Tags();
+        tags->setFilename(filename);
+        if (!loadAnyFormat(&readOnlyStream, fields, tags)) {
+            qDebug() << "Taglib cannot parse" << filename;
+            delete tags;
+            return nullptr;
+        }
     }
 
     return tags;
@@ -121,8 +424,18 @@ Tags *TagUtils::load(const QString &filename) {
 
 QString TagUtils::qString(const TagLib::String &tstring) {
     if (tstring.isEmpty()) return QString();
-    return QString::fromWCharArray(tstring.toCWString(), tstring.size());;
-    // return QString::fromUtf8(tstring.toCString(true));
+    // TagLib keeps wide chars: copy them as they are, unless there are surrogates to make
+    const wchar_t *chars = tstring.toCWString();
+    const int size = tstring.size();
+    if (sizeof(wchar_t) == sizeof(QChar))
+        return QString(reinterpret_cast<const QChar *>(chars), size);
+    QString s(size, Qt::Uninitialized);
+    ushort *d = reinterpret_cast<ushort *>(s.data());
+    for (int i = 0; i < size; ++i) {
+        if (uint(chars[i]) > 0xffff) return QString::fromWCharArray(chars, size);
+        d[i] = ushort(chars[i]);
+    }
+    return s;
 }
 
 TagLib::String TagUtils::tlString(const QString &s) {
@@ -130,30 +443,39 @@ TagLib::String TagUtils::tlString(const QString &s) {
     return TagLib::String(s.toUtf8().data(), TagLib::String::UTF8);
 }
 
-void TagUtils::parseDiskString(const QString &disk, Tags *tags) {
-    const int i = disk.indexOf('/');
-    int diskNumber = 1;
-    int diskCount = 1;
-    if (i != -1) {
-        diskNumber = disk.left(i).toInt();
-        diskCount = disk.mid(i+1).toInt();
-    } else {
-        diskNumber = disk.toInt();
+namespace {
+
+// "3/12" or "3". Each part is 0 when it is not a number, like QString::toInt().
+void parseNumberPair(const TagLib::String &s, int *first, int *second) {
+    int values[] = {0, 0};
+    bool valid[] = {true, true};
+    int part = 0;
+    for (wchar_t c : s) {
+        if (c == L'/' && part == 0)
+            part = 1;
+        else if (c >= L'0' && c <= L'9' && values[part] < 100000)
+            values[part] = values[part] * 10 + (c - L'0');
+        else if (c != L' ')
+            valid[part] = false;
     }
+    *first = valid[0] ? values[0] : 0;
+    *second = valid[1] ? values[1] : 0;
+}
+
+}
+
+void TagUtils::parseDiskString(const TagLib::String &disk, Tags *tags) {
+    int diskNumber;
+    int diskCount;
+    parseNumberPair(disk, &diskNumber, &diskCount);
     if (diskNumber) tags->setDiskNumber(diskNumber);
     if (diskCount) tags->setDiskCount(diskCount);
 }
 
-void TagUtils::parseTrackString(const QString &track, Tags *tags) {
-    const int i = track.indexOf('/');
-    int trackNumber = 0;
-    int trackCount = 0;
-    if (i != -1) {
-        trackNumber = track.left(i).toInt();
-        trackCount = track.mid(i+1).toInt();
-    } else {
-        trackNumber = track.toInt();
-    }
+void TagUtils::parseTrackString(const TagLib::String &track, Tags *tags) {
+    int trackNumber;
+    int trackCount;
+    parseNumberPair(track, &trackNumber, &trackCount);
     if (trackNumber) tags->setTrackNumber(trackNumber);
     if (trackCount) tags->setTrackCount(trackCount);
 }
@@ -7,11 +7,45 @@
 
 namespace TagUtils {
 
-Tags* load(const QString &filename);
+// The fields load() decodes, everything else is skipped
+enum Field {
+    TitleField = 0x1,
+    ArtistField = 0x2,
+    AlbumField = 0x4,
+    AlbumArtistField = 0x8,
+    GenreField = 0x10,
+    // track, disk and year
+    NumberFields = 0x20,
+    // also reads the audio properties
+    DurationField = 0x40,
+    SortFields = 0x80,
+    ComposerFields = 0x100,
+    CommentField = 0x200,
+    LyricsField = 0x400,
+    CompilationField = 0x800,
+    // the embedded picture bytes, they can be big
+    CoverField = 0x1000,
+
+    // With DurationField: TagLib's fast read style, estimates are flagged as uncertain
+    FastDuration = 0x2000,
+    // With DurationField: MPEG streams without a VBR header are measured frame by frame
+    AccurateDuration = 0x4000,
+    // Files that are audio neither by extension nor by their first bytes are rejected
+    // before TagLib parses them, for walks that meet sidecar files and scans
+    SkipNonAudio = 0x8000,
+
+    // what the collection scanner stores
+    ScanFields = TitleField | ArtistField | AlbumField | AlbumArtistField | GenreField |
+                 NumberFields | DurationField,
+    AllFields = CoverField - 1
+};
+
+// Opens the file once, then decodes only the requested fields
+Tags* load(const QString &filename, int fields = AllFields);
 QString qString(const TagLib::String &tstring);
 TagLib::String tlString(const QString &s);
-void parseDiskString(const QString &disk, Tags *tags);
-void parseTrackString(const QString &track, Tags *tags);
+void parseDiskString(const TagLib::String &disk, Tags *tags);
+void parseTrackString(const TagLib::String &track, Tags *tags);
 
 }
 
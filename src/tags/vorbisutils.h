@@ -9,65 +9,83 @@
 
 namespace VorbisUtils {
 
-QHash<QString, const char*> initReadVorbisMap() {
-    QHash<QString, const char*> map;
-
-    // map.insert("CONTENT GROUP", "grouping");
-    map.insert("ALBUMARTIST", "albumArtist");
-    map.insert("ALBUM ARTIST", "albumArtist");
-    map.insert("ARTISTSORT", "artistSort");
-    map.insert("ALBUMARTISTSORT", "albumArtistSort");
-    map.insert("COMPOSERSORT", "composerSort");
-
-    return map;
+// The first value of a field, or a null string
+QString field(const TagLib::Ogg::FieldListMap &map, const char *name) {
+    TagLib::Ogg::FieldListMap::ConstIterator i = map.find(name);
+    if (i == map.end() || i->second.isEmpty()) return QString();
+    return TagUtils::qString(i->second.front());
 }
 
-void load(TagLib::Ogg::XiphComment *tag, Tags *tags) {
+// Only the fields asked for are decoded
+void load(TagLib::Ogg::XiphComment *tag, int fields, Tags *tags) {
     const TagLib::Ogg::FieldListMap &map = tag->fieldListMap();
 
-    if (!map["TRACKNUMBER"].isEmpty()) {
-        const QString track = TagUtils::qString(map["TRACKNUMBER"].front()).trimmed();
-        TagUtils::parseTrackString(track, tags);
+    if (fields & TagUtils::NumberFields) {
+        if (!map["TRACKNUMBER"].isEmpty())
+            TagUtils::parseTrackString(map["TRACKNUMBER"].front(), tags);
+
+        if (!map["TRACKTOTAL"].isEmpty()) {
+            int total = map["TRACKTOTAL"].front().toInt();
+            tags->setTrackCount(total);
+        }
+
+        if (!map["DISCNUMBER"].isEmpty())
+            TagUtils::parseDiskString(map["DISCNUMBER"].front(), tags);
+
+        if (!map["DISCTOTAL"].isEmpty()) {
+            int total = map["DISCTOTAL"].front().toInt();
+            tags->setDiskCount(total);
+        }
     }
 
-    if (!map["TRACKTOTAL"].isEmpty()) {
-        int total = TagUtils::qString(map["TRACKTOTAL"].front()).trimmed().toInt();
-        tags->setTrackCount(total);
+    // map.insert("CONTENT GROUP", "grouping");
+
+    if (fields & TagUtils::AlbumArtistField) {
+        QString albumArtist = field(map, "ALBUMARTIST");
+        if (albumArtist.isNull()) albumArtist = field(map, "ALBUM ARTIST");
+        if (!albumArtist.isNull()) tags->setAlbumArtist(albumArtist);
     }
 
-    if (!map["DISCNUMBER"].isEmpty()) {
-        const QString disk = TagUtils::qString(map["DISCNUMBER"].front()).trimmed();
-        TagUtils::parseDiskString(disk, tags);
+    if (fields & TagUtils::SortFields) {
+        tags->setArtistSort(field(map, "ARTISTSORT"));
+        tags->setAlbumArtistSort(field(map, "ALBUMARTISTSORT"));
     }
 
-    if (!map["DISCTOTAL"].isEmpty()) {
-        int total = TagUtils::qString(map["DISCTOTAL"].front()).trimmed().toInt();
-        tags->setDiskCount(total);
+    if (fields & TagUtils::ComposerFields) {
+        tags->setComposer(field(map, "COMPOSER"));
+        tags->setComposerSort(field(map, "COMPOSERSORT"));
     }
 
-    static const QHash<QString, const char*> oggFieldMap = initReadVorbisMap();
-    const QMetaObject *metaObject = tags->metaObject();
-
-    for (TagLib::PropertyMap::ConstIterator i = map.begin(); i != map.end(); ++i) {
-        for (TagLib::StringList::ConstIterator j = i->second.begin(); j != i->second.end(); ++j) {
-            const QString fieldName = TagUtils::qString(i->first);
-            const QString fieldValue = TagUtils::qString(*j);
-            const char* propertyName = oggFieldMap.value(fieldName);
-            QByteArray byteArray;
-            if (!propertyName) {
-                byteArray = fieldName.toLower().toUtf8();
-                propertyName = byteArray.constData();
-            }
-            // qDebug() << "OGG" << propertyName << fieldValue;
-            // tagMap.insert(propertyName, QVariant(fieldValue));
-            if (metaObject->indexOfProperty(propertyName) >= 0) {
-                // qDebug() << "Setting property" << fieldName << propertyName << fieldValue;
-                tags->setProperty(propertyName, fieldValue);
-            } else {
-                // qDebug() << "Discarding OGG field" << fieldName << propertyName << fieldValue;
-            }
+    if (fields & TagUtils::LyricsField) {
+        QString lyrics = field(map, "LYRICS");
+        if (lyrics.isNull()) lyrics = field(map, "UNSYNCEDLYRICS");
+        tags->setLyrics(lyrics);
+    }
+
+    if (fields & TagUtils::CompilationField) {
+        if (!map["COMPILATION"].isEmpty())
+            tags->setCompilation(map["COMPILATION"].front().toInt());
+    }
+}
+
+// Base64 picture blocks, the old COVERART field as a fallback
+QByteArray cover(TagLib::Ogg::XiphComment *tag) {
+    const TagLib::Ogg::FieldListMap &map = tag->fieldListMap();
+
+    const TagLib::StringList &blocks = map["METADATA_BLOCK_PICTURE"];
+    if (!blocks.isEmpty()) {
+        const QByteArray block = QByteArray::fromBase64(blocks.front().toCString());
+        TagLib::FLAC::Picture picture;
+        if (picture.parse(TagLib::ByteVector(block.constData(), block.size()))) {
+            const TagLib::ByteVector &data = picture.data();
+            return QByteArray(data.data(), data.size());
         }
     }
+
+    const TagLib::StringList &coverArt = map["COVERART"];
+    if (!coverArt.isEmpty()) return QByteArray::fromBase64(coverArt.front().toCString());
+
+    return QByteArray();
 }
 
 }
@@ -0,0 +1,148 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#include "tileartwork.h"
+
+#include <QtSql>
+
+#include "database.h"
+
+#include "model/album.h"
+#include "model/artist.h"
+
+namespace {
+
+// Most represented first, capped so that checking for photos stays cheap
+const int maxRanked = TileArtwork::MaxCandidates * 4;
+
+typedef QHash<int, QVector<int>> Ranking;
+
+// The query must return owner, item, ordered by owner and then by relevance
+bool rank(QSqlQuery &query, Ranking &ranking) {
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        QVector<int> &items = ranking[query.value(0).toInt()];
+        if (items.size() < maxRanked) items << query.value(1).toInt();
+    }
+    return true;
+}
+
+// Photos are downloaded after the scan: prefer the items that already have one
+template <typename F> QVector<int> choose(const QVector<int> &ranked, F hasPhoto) {
+    QVector<int> withPhoto;
+    QVector<int> withoutPhoto;
+    for (int id : ranked) {
+        if (withPhoto.size() == TileArtwork::MaxCandidates) break;
+        if (withPhoto.contains(id) || withoutPhoto.contains(id)) continue;
+        if (hasPhoto(id))
+            withPhoto << id;
+        else
+            withoutPhoto << id;
+    }
+    QVector<int> chosen = withPhoto + withoutPhoto;
+    chosen.resize(qMin(chosen.size(), int(TileArtwork::MaxCandidates)));
+    return chosen;
+}
+
+bool save(const QString &table, const QString &owner, const QString &item, int ownerId,
+          const QVector<int> &items) {
+    QSqlQuery query = Database::instance().cachedQuery(
+            QString("insert into %1 (%2,%3,position) values (?,?,?)").arg(table, owner, item));
+    for (int i = 0; i < items.size(); ++i) {
+        query.bindValue(0, ownerId);
+        query.bindValue(1, items.at(i));
+        query.bindValue(2, i);
+        if (!query.exec()) {
+            qWarning() << query.lastQuery() << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool rebuildGenres() {
+    QSqlDatabase db = Database::instance().getConnection();
+    QSqlQuery query(db);
+    if (!query.exec("delete from genreArtists")) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+
+    Ranking ranking;
+    query.prepare("select g.genre,t.artist,count(*) c from genreTree gt "
+                  "join genreTracks g on g.genre=gt.genre join tracks t on t.id=g.track "
+                  "where t.artist>0 group by g.genre,t.artist order by g.genre,c desc");
+    if (!rank(query, ranking)) return false;
+
+    // Children first, so meta-genres without tracks of their own borrow from them
+    query.prepare("select genre,parent from genreTree order by depth desc");
+    if (!query.exec()) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+    auto hasPhoto = [](int id) {
+        Artist *artist = Artist::forId(id);
+        return artist && artist->hasPhoto();
+    };
+    while (query.next()) {
+        const int genre = query.value(0).toInt();
+        const int parent = query.value(1).toInt();
+        const QVector<int> artists = choose(ranking.value(genre), hasPhoto);
+        if (!save("genreArtists", "genre", "artist", genre, artists)) return false;
+        if (parent > 0) {
+            QVector<int> &parentRanking = ranking[parent];
+            if (parentRanking.size() < maxRanked) parentRanking += artists;
+        }
+    }
+    return true;
+}
+
+bool rebuildDecades() {
+    QSqlDatabase db = Database::instance().getConnection();
+    QSqlQuery query(db);
+    if (!query.exec("delete from decadeAlbums")) {
+        qWarning() << query.lastQuery() << query.lastError().text();
+        return false;
+    }
+
+    Ranking ranking;
+    query.prepare("select (year/10)*10 d,album,count(*) c from tracks "
+                  "where year>=1900 and album>0 group by d,album order by d,c desc");
+    if (!rank(query, ranking)) return false;
+
+    auto hasPhoto = [](int id) {
+        Album *album = Album::forId(id);
+        return album && album->hasPhoto();
+    };
+    for (auto i = ranking.constBegin(); i != ranking.constEnd(); ++i) {
+        if (!save("decadeAlbums", "decade", "album", i.key(), choose(i.value(), hasPhoto)))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool TileArtwork::rebuild() {
+    return rebuildGenres() && rebuildDecades();
+}
@@ -0,0 +1,38 @@
+/* $BEGIN_LICENSE
+
+This file is part of Musique.
+Copyright 2013, Flavio Tordini <flavio.tordini@gmail.com>
+
+Musique is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Musique is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Musique.  If not, see <http://www.gnu.org/licenses/>.
+
+$END_LICENSE */
+
+#ifndef TILEARTWORK_H
+#define TILEARTWORK_H
+
+#include <QtCore>
+
+/**
+ * Picks a few representative artists for each genre of the genre tree and a few albums
+ * for each decade. The Genres view rotates through them instead of querying at random.
+ */
+class TileArtwork {
+public:
+    enum { MaxCandidates = 8 };
+
+    // Runs at the end of a scan, after GenreTree::rebuild()
+    static bool rebuild();
+};
+
+#endif // TILEARTWORK_H